@@ -0,0 +1,24 @@
+/* Host run of the hot-path micro-benchmarks (src/bench.h).
+**
+**   bench_hot > result.json
+**   python ../python/bench_compare.py result.json --baseline bench/baseline_host.json
+**
+** Counts are time-stamp counter ticks, so they only compare against a
+** baseline taken on the same machine. The simulated LEDC and GPIO record
+** every change they see (shim/src/io_sim.c), so l298n_set_motor includes
+** that bookkeeping here; on the rover it is register writes.
+*/
+
+#include <stdio.h>
+#include "bench.h"
+#include "pca9685.h"
+
+int main(void) {
+    static l298n_t boards[L298N_NUM_BOARDS];
+
+    // No NVS calibration on the host, so every channel uses the defaults.
+    pca9685_cal_load();
+    init_motor_controllers(boards);
+    bench_run(&boards[0], stdout);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/* Host benchmark: servo update cost as channels grow across PCA9685 boards.
+**
+** Eight simulated boards (0x40 - 0x47) are attached with realtime bus
+** timing. For 16 to 128 channels every angle changes on every update, and
+** each pca9685_set_servos_dd() is timed twice: the caller's cost (what the
+** control task pays) and the time until the bus engine has put it all on
+** the wire. The first only grows by the table lookups, since each board
+** costs one queued burst and nobody waits for the bus; the second grows
+** with the bytes to send.
+**
+** Usage: bench_pca9685_boards [updates]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pca9685.h"
+#include "i2c_bus.h"
+#include "host_sim.h"
+
+#define NUM_BOARDS 8
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+typedef struct {
+    double caller_us;
+    double done_us;
+    double transactions;
+} result_t;
+
+static void run(int channels, long updates, result_t *out) {
+    static uint16_t angle_dd[PCA9685_MAX_CHANNELS];
+    uint64_t caller = 0, done = 0;
+    i2c_sim_stats_t before, after;
+
+    i2c_sim_get_stats(&before);
+    for (long u = 0; u < updates; u++) {
+        // A new angle on every channel, so nothing is elided by the shadow registers.
+        for (int c = 0; c < channels; c++) {
+            angle_dd[c] = (uint16_t)((u * 37 + c * 11) % (PCA9685_ANGLE_MAX_DD + 1));
+        }
+        uint64_t t0 = now_ns();
+        pca9685_set_servos_dd(angle_dd, channels);
+        uint64_t t1 = now_ns();
+        i2c_bus_sync();
+        uint64_t t2 = now_ns();
+        caller += t1 - t0;
+        done += t2 - t0;
+    }
+    i2c_sim_get_stats(&after);
+
+    out->caller_us = caller / 1e3 / updates;
+    out->done_us = done / 1e3 / updates;
+    out->transactions = (double)(after.transactions - before.transactions) / updates;
+}
+
+int main(int argc, char **argv) {
+    long updates = argc > 1 ? atol(argv[1]) : 200;
+
+    for (int b = 0; b < NUM_BOARDS; b++) {
+        i2c_sim_add_pca9685(PCA9685_ADDR_FIRST + b);
+    }
+    i2c_master_init();
+    pca9685_init();
+    if (pca9685_num_channels() < NUM_BOARDS * PCA9685_NUM_CHANNELS) {
+        fprintf(stderr, "only %d channels found\n", pca9685_num_channels());
+        return 1;
+    }
+
+    printf("%8s  %8s  %8s  %6s\n", "channels", "call us", "done us", "txns");
+    for (int channels = 16; channels <= NUM_BOARDS * PCA9685_NUM_CHANNELS; channels *= 2) {
+        result_t r;
+        run(channels, updates, &r);
+        printf("%8d  %8.1f  %8.1f  %6.1f\n", channels, r.caller_us, r.done_us, r.transactions);
+    }
+    return 0;
+}
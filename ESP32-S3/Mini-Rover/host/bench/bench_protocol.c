@@ -0,0 +1,120 @@
+/* Host benchmark: per-packet parse cost of the legacy sscanf path used by
+** udp_server_task versus the protocol module's text and binary decoders.
+**
+** Usage: bench_protocol [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "protocol.h"
+
+#define NUM_PACKETS 64
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Prevents the compiler from discarding parse results.
+static volatile int sink;
+
+// The parsing done by udp_server_task before the protocol module existed.
+static int legacy_parse(char *rx_buffer, int len) {
+    rx_buffer[len] = 0;
+    if (rx_buffer[0] == 'S') {
+        int angles[ROVER_NUM_SERVOS];
+        if (sscanf(rx_buffer, "S,%d,%d,%d,%d,%d,%d",
+                &angles[0], &angles[1], &angles[2],
+                &angles[3], &angles[4], &angles[5]) == ROVER_NUM_SERVOS) {
+            return angles[0] + angles[5];
+        }
+    } else if (rx_buffer[0] == 'M') {
+        int speedVal;
+        if (sscanf(rx_buffer, "M,%d", &speedVal) == 1) {
+            return speedVal;
+        }
+    }
+    return -1;
+}
+
+typedef struct {
+    char text[64];
+    int text_len;
+    uint8_t bin[ROVER_PROTO_MAX_FRAME];
+    int bin_len;
+} packet_t;
+
+static void make_packets(packet_t *pkts) {
+    srand(1);
+    for (int i = 0; i < NUM_PACKETS; i++) {
+        rover_cmd_t cmd = {0};
+        if (i % 2 == 0) {
+            cmd.type = ROVER_MSG_SERVO;
+            int n = snprintf(pkts[i].text, sizeof(pkts[i].text), "S");
+            for (int s = 0; s < ROVER_NUM_SERVOS; s++) {
+                int a = 45 + rand() % 91;
+                cmd.servo.angle_dd[s] = a * ROVER_ANGLE_SCALE;
+                n += snprintf(pkts[i].text + n, sizeof(pkts[i].text) - n, ",%d", a);
+            }
+            pkts[i].text_len = n;
+        } else {
+            int speed = rand() % 511 - 255;
+            cmd.type = ROVER_MSG_MOTOR;
+            for (int m = 0; m < ROVER_NUM_MOTORS; m++) {
+                cmd.motor.speed[m] = speed;
+            }
+            pkts[i].text_len = snprintf(pkts[i].text, sizeof(pkts[i].text), "M,%d", speed);
+        }
+        pkts[i].bin_len = rover_encode(&cmd, pkts[i].bin, sizeof(pkts[i].bin));
+    }
+}
+
+int main(int argc, char **argv) {
+    long iters = argc > 1 ? atol(argv[1]) : 200000;
+    static packet_t pkts[NUM_PACKETS];
+    make_packets(pkts);
+
+    char scratch[128];
+    rover_cmd_t cmd;
+    uint64_t t0, t1;
+    long total = iters * NUM_PACKETS;
+
+    t0 = now_ns();
+    for (long it = 0; it < iters; it++) {
+        for (int i = 0; i < NUM_PACKETS; i++) {
+            memcpy(scratch, pkts[i].text, pkts[i].text_len);
+            sink = legacy_parse(scratch, pkts[i].text_len);
+        }
+    }
+    t1 = now_ns();
+    double legacy = (double)(t1 - t0) / total;
+
+    t0 = now_ns();
+    for (long it = 0; it < iters; it++) {
+        for (int i = 0; i < NUM_PACKETS; i++) {
+            memcpy(scratch, pkts[i].text, pkts[i].text_len);
+            sink = rover_decode((const uint8_t *)scratch, pkts[i].text_len, &cmd);
+        }
+    }
+    t1 = now_ns();
+    double text = (double)(t1 - t0) / total;
+
+    t0 = now_ns();
+    for (long it = 0; it < iters; it++) {
+        for (int i = 0; i < NUM_PACKETS; i++) {
+            memcpy(scratch, pkts[i].bin, pkts[i].bin_len);
+            sink = rover_decode((const uint8_t *)scratch, pkts[i].bin_len, &cmd);
+        }
+    }
+    t1 = now_ns();
+    double binary = (double)(t1 - t0) / total;
+
+    printf("packets per run : %ld\n", total);
+    printf("legacy sscanf   : %8.1f ns/packet\n", legacy);
+    printf("text decoder    : %8.1f ns/packet (%.1fx)\n", text, legacy / text);
+    printf("binary decoder  : %8.1f ns/packet (%.1fx)\n", binary, legacy / binary);
+    return 0;
+}
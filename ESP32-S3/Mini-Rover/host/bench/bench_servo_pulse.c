@@ -0,0 +1,92 @@
+/* Host benchmark: cost of converting a servo angle to a PCA9685 OFF count,
+** comparing the old float formula with the integer fixed-point conversion,
+** and the worst-case error of each against the exact (unrounded) pulse.
+**
+** The old formula divides by the double 180.0, which is software emulated on
+** the ESP32-S3 (its FPU is single precision). A desktop CPU does that divide
+** in hardware and vectorises the loop, so on the host the float path can come
+** out ahead; the number to compare on target is an integer divide against a
+** soft-float double divide, and the error column holds everywhere.
+**
+** Usage: bench_servo_pulse [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "pca9685.h"
+
+#define NUM_ANGLES 1024
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Prevents the compiler from discarding conversion results.
+static volatile uint32_t sink;
+
+// The conversion done by pca9685_set_servo_angle() before it moved to integers.
+static uint16_t legacy_angle_to_pulse(float angle) {
+    uint16_t pulseMin = SERVO_MIN;
+    uint16_t pulseMax = SERVO_MAX;
+    return pulseMin + (angle / 180.0) * (pulseMax - pulseMin);
+}
+
+int main(int argc, char **argv) {
+    long iters = argc > 1 ? atol(argv[1]) : 20000;
+
+    // No NVS calibration on the host, so every channel uses the defaults.
+    pca9685_cal_load();
+
+    static float angles[NUM_ANGLES];
+    static uint16_t angles_dd[NUM_ANGLES];
+    srand(1);
+    for (int i = 0; i < NUM_ANGLES; i++) {
+        angles_dd[i] = rand() % (PCA9685_ANGLE_MAX_DD + 1);
+        angles[i] = angles_dd[i] / (float)PCA9685_ANGLE_SCALE;
+    }
+
+    uint64_t t0, t1;
+    long total = iters * NUM_ANGLES;
+    uint32_t acc;
+
+    t0 = now_ns();
+    acc = 0;
+    for (long it = 0; it < iters; it++) {
+        for (int i = 0; i < NUM_ANGLES; i++) {
+            acc += legacy_angle_to_pulse(angles[i]);
+        }
+        sink = acc;
+    }
+    t1 = now_ns();
+    double legacy = (double)(t1 - t0) / total;
+
+    t0 = now_ns();
+    acc = 0;
+    for (long it = 0; it < iters; it++) {
+        for (int i = 0; i < NUM_ANGLES; i++) {
+            acc += pca9685_angle_to_pulse(i % NUM_SERVOS, angles_dd[i]);
+        }
+        sink = acc;
+    }
+    t1 = now_ns();
+    double fixed = (double)(t1 - t0) / total;
+
+    // Error against the exact pulse, rounded to the nearest count, over every tenth of a degree.
+    double legacy_err = 0, fixed_err = 0;
+    for (int dd = 0; dd <= PCA9685_ANGLE_MAX_DD; dd++) {
+        double exact = SERVO_MIN + (SERVO_MAX - SERVO_MIN) * dd / (double)PCA9685_ANGLE_MAX_DD;
+        double e_legacy = fabs(legacy_angle_to_pulse(dd / (float)PCA9685_ANGLE_SCALE) - exact);
+        double e_fixed = fabs(pca9685_angle_to_pulse(0, dd) - exact);
+        legacy_err = e_legacy > legacy_err ? e_legacy : legacy_err;
+        fixed_err = e_fixed > fixed_err ? e_fixed : fixed_err;
+    }
+
+    printf("conversions per run : %ld\n", total);
+    printf("legacy float        : %8.2f ns/angle  max error %.2f counts\n", legacy, legacy_err);
+    printf("fixed point         : %8.2f ns/angle  max error %.2f counts (%.1fx)\n", fixed, fixed_err, legacy / fixed);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/* Host benchmark: command receive path, BSD socket against raw lwIP.
+**
+** Each mode runs in a child process of its own, on its own port, with the
+** real receive handler (src/udp_rx.c) behind it. A sender socket in the
+** same process then measures
+**
+**   - latency: one DRIVE datagram at a time, from sendto() until the control
+**     task's view of the setpoint (setpoint_read()) has the new generation;
+**   - throughput: a run of datagrams with up to WINDOW in flight, datagrams
+**     handled per second and how many never made it.
+**
+** On the host both paths sit on kernel sockets, and the raw path's "tcpip
+** thread" is the shim's (host/shim/src/lwip_host.c), so this compares the
+** shape of the two paths (one thread against a hand-off to a second one)
+** rather than lwIP itself. On the rover, compare the STATS parse and queue
+** stages with python/stats_query.py under each mode.
+**
+** Usage: bench_udp_rx [latency samples] [throughput datagrams]
+** (ROVER_HOST_LOG_LEVEL=1 keeps the firmware log out of the table)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "protocol.h"
+#include "setpoint.h"
+#include "stats.h"
+#include "boot.h"
+#include "udp_rx.h"
+#include "esp_timer.h"
+
+#define BASE_PORT 18080
+#define WINDOW 32
+
+static l298n_t boards[L298N_NUM_BOARDS];
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static size_t drive_frame(uint16_t seq, uint8_t *buf, size_t cap) {
+    rover_cmd_t cmd = {
+        .type = ROVER_MSG_DRIVE,
+        .drive = {.seq = seq, .t_us = (uint32_t)esp_timer_get_time(), .steer = 0, .speed = (int16_t)(seq % 255)},
+    };
+    return rover_encode(&cmd, buf, cap);
+}
+
+static void run(udp_rx_mode_t mode, uint16_t port, int samples, int burst) {
+    setpoint_t sp;
+    uint8_t frame[64];
+    uint16_t seq = 1;
+
+    udp_rx_start(mode, port, boards);
+    while (boot_get(BOOT_UDP) < 0) {
+        usleep(1000);
+    }
+
+    int tx = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in dst = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+
+    // Latency, one datagram in flight at a time.
+    int64_t *lat = malloc(sizeof(int64_t) * samples);
+    setpoint_read(&sp);
+    uint32_t gen = sp.motor_gen;
+    for (int i = 0; i < samples; i++) {
+        size_t n = drive_frame(seq++, frame, sizeof(frame));
+        int64_t t0 = esp_timer_get_time();
+        sendto(tx, frame, n, 0, (struct sockaddr *)&dst, sizeof(dst));
+        do {
+            setpoint_read(&sp);
+        } while (sp.motor_gen == gen && esp_timer_get_time() - t0 < 100000);
+        lat[i] = esp_timer_get_time() - t0;
+        gen = sp.motor_gen;
+    }
+    qsort(lat, samples, sizeof(int64_t), cmp_i64);
+
+    // Throughput: keep up to WINDOW datagrams in flight, so the rate is what the path sustains, not what the socket buffer absorbs.
+    uint32_t before = stats_get(STATS_RX_PACKETS);
+    int64_t start = esp_timer_get_time();
+    int sent = 0;
+    uint32_t handled = 0;
+    int64_t last = start;
+    while (sent < burst || esp_timer_get_time() - last < 50000) {
+        uint32_t now = stats_get(STATS_RX_PACKETS) - before;
+        if (now != handled) {
+            handled = now;
+            last = esp_timer_get_time();
+        }
+        if (sent < burst && sent - (int)handled < WINDOW) {
+            size_t n = drive_frame(seq++, frame, sizeof(frame));
+            sendto(tx, frame, n, 0, (struct sockaddr *)&dst, sizeof(dst));
+            sent++;
+            last = esp_timer_get_time();
+        }
+    }
+    double pps = handled / ((last - start) / 1e6);
+
+    printf("%-8s  %7.1f  %7.1f  %7.1f  %9.0f  %6.2f%%\n", mode == UDP_RX_SOCKET ? "socket" : "raw",
+           lat[samples / 2] / 1.0, lat[samples * 99 / 100] / 1.0, lat[samples - 1] / 1.0,
+           pps, 100.0 * (burst - handled) / burst);
+    fflush(stdout);
+    free(lat);
+}
+
+int main(int argc, char **argv) {
+    int samples = argc > 1 ? atoi(argv[1]) : 5000;
+    int burst = argc > 2 ? atoi(argv[2]) : 20000;
+
+    printf("%-8s  %7s  %7s  %7s  %9s  %7s\n", "path", "p50 us", "p99 us", "max us", "pkt/s", "lost");
+    fflush(stdout);
+    const udp_rx_mode_t modes[] = {UDP_RX_SOCKET, UDP_RX_LWIP_RAW};
+    for (int m = 0; m < 2; m++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            run(modes[m], BASE_PORT + m, samples, burst);
+            _exit(0);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "mode %d failed\n", m);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+/* Entry point for running the full firmware on Linux.
+**
+**   rover_host [--run-seconds N] [--waveform out.csv] [--no-realtime-i2c]
+**
+** app_main() runs unchanged; the shims in shim/ stand in for the ESP-IDF
+** drivers. Commands are accepted on UDP SERVER_PORT exactly as on the rover,
+** so python/controller-to-esp32-wifi.py can drive it with ESP32_IP set to
+** the host address.
+*/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host_sim.h"
+
+void app_main(void);
+
+static const char *waveform_path = NULL;
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    stop = 1;
+}
+
+static void report(void) {
+    i2c_sim_stats_t st;
+    i2c_sim_get_stats(&st);
+    fprintf(stderr, "i2c: %u transactions, %u nacks, %llu bytes, %llu us bus time\n",
+            st.transactions, st.nacks, (unsigned long long)st.bytes, (unsigned long long)st.busy_us);
+    fprintf(stderr, "waveform: %zu events\n", waveform_count());
+    if (waveform_path) {
+        if (waveform_dump_csv(waveform_path) == 0) {
+            fprintf(stderr, "waveform written to %s\n", waveform_path);
+        } else {
+            perror(waveform_path);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    double run_seconds = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--run-seconds") == 0 && i + 1 < argc) {
+            run_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--waveform") == 0 && i + 1 < argc) {
+            waveform_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-realtime-i2c") == 0) {
+            i2c_sim_set_realtime(false);
+        } else {
+            fprintf(stderr, "usage: %s [--run-seconds N] [--waveform out.csv] [--no-realtime-i2c]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    host_sim_init();
+    app_main();
+
+    // app_main() returns once its tasks are running, as on target.
+    useconds_t slept = 0;
+    while (!stop && (run_seconds <= 0 || slept < run_seconds * 1e6)) {
+        usleep(10000);
+        slept += 10000;
+    }
+
+    report();
+    return 0;
+}
@@ -0,0 +1,335 @@
+/* Offline replay of a flight recorder log through the firmware logic.
+**
+**   rover_log_replay [--list] [--boot N] [--offset BYTES] [--csv out.csv]
+**                    [--tol-motor DUTY] [--tol-servo DD] [-v] image.bin
+**
+** image.bin is the recorder partition as saved by python/log_download.py,
+** or a host flash file (ROVER_HOST_FLASH) with --offset 0x210000. The log is
+** split into boots at REC_BOOT records; one boot (default: the last) is
+** replayed.
+**
+** Every recorded command datagram goes through rover_decode(), the sequence
+** filter and the setpoint mailbox, and a simulated control loop steps the
+** same shaper as the control task (control_shaper_step) at CONTROL_RATE_HZ
+** on the recorded clock. Each recorded output (REC_SERVO / REC_MOTOR) is
+** compared with what the replay had written at that moment. The exit status
+** is 1 if any output differs by more than the tolerance, so a log from the
+** field doubles as a regression test for changes to the control path.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "protocol.h"
+#include "seqfilter.h"
+#include "setpoint.h"
+#include "control.h"
+#include "ackermann.h"
+#include "recorder.h"
+
+typedef struct {
+    int64_t t_us;           // unwrapped recorder clock
+    uint8_t type;
+    uint8_t len;
+    const uint8_t *data;
+} rec_t;
+
+typedef struct {
+    size_t first, count;    // slice of the record array
+} boot_t;
+
+static rec_t *recs;
+static size_t num_recs, cap_recs;
+static boot_t boots[256];
+static size_t num_boots;
+
+static void add_rec(int64_t t_us, uint8_t type, uint8_t len, const uint8_t *data) {
+    if (num_recs == cap_recs) {
+        cap_recs = cap_recs ? 2 * cap_recs : 4096;
+        recs = realloc(recs, cap_recs * sizeof(rec_t));
+        if (recs == NULL) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    recs[num_recs++] = (rec_t){t_us, type, len, data};
+}
+
+typedef struct {
+    uint32_t index, seq;
+} sector_ref_t;
+
+static int by_age(const void *a, const void *b) {
+    // Sorted oldest first; the sequence numbers are compared with wrap-around.
+    int32_t d = (int32_t)(((const sector_ref_t *)a)->seq - ((const sector_ref_t *)b)->seq);
+    return (d > 0) - (d < 0);
+}
+
+// Walk the sectors oldest first and collect records, cutting a new boot at every REC_BOOT.
+static void parse_image(const uint8_t *img, size_t size) {
+    size_t num_sectors = size / RECORDER_SECTOR_SIZE;
+    sector_ref_t *order = calloc(num_sectors, sizeof(sector_ref_t));
+    size_t used = 0;
+    for (size_t i = 0; i < num_sectors; i++) {
+        const uint8_t *s = img + i * RECORDER_SECTOR_SIZE;
+        if (get_u32le(s) == RECORDER_MAGIC) {
+            order[used++] = (sector_ref_t){(uint32_t)i, get_u32le(s + 4)};
+        }
+    }
+    qsort(order, used, sizeof(sector_ref_t), by_age);
+
+    int64_t epoch = 0;
+    uint32_t last_ts = 0;
+    for (size_t k = 0; k < used; k++) {
+        const uint8_t *s = img + (size_t)order[k].index * RECORDER_SECTOR_SIZE;
+        if (k > 0 && order[k].seq != order[k - 1].seq + 1) {
+            fprintf(stderr, "note: sectors %u..%u missing (overwritten or never flushed)\n", order[k - 1].seq + 1, order[k].seq - 1);
+        }
+        size_t off = RECORDER_SECTOR_HEADER_LEN;
+        while (off + RECORDER_REC_HEADER_LEN <= RECORDER_SECTOR_SIZE) {
+            const uint8_t *r = s + off;
+            uint8_t type = r[4], len = r[5];
+            if (type == 0xFF || off + RECORDER_REC_HEADER_LEN + len > RECORDER_SECTOR_SIZE) {
+                break;
+            }
+            uint32_t ts = get_u32le(r);
+            if (type == REC_BOOT) {
+                if (num_boots == sizeof(boots) / sizeof(boots[0])) {
+                    break;
+                }
+                boots[num_boots++] = (boot_t){num_recs, 0};
+                epoch = 0;
+            } else if (ts < last_ts && last_ts - ts > 0x80000000u) {
+                // esp_timer wrapped. Small steps back are records from two tasks racing for the lock.
+                epoch += 1LL << 32;
+            }
+            last_ts = ts;
+            if (num_boots > 0) {
+                add_rec(epoch + ts, type, len, r + RECORDER_REC_HEADER_LEN);
+                boots[num_boots - 1].count++;
+            }
+            off += RECORDER_REC_HEADER_LEN + len;
+        }
+    }
+    free(order);
+}
+
+static void list_boots(void) {
+    for (size_t b = 0; b < num_boots; b++) {
+        size_t cmds = 0, outs = 0;
+        for (size_t i = 0; i < boots[b].count; i++) {
+            uint8_t t = recs[boots[b].first + i].type;
+            cmds += t == REC_CMD;
+            outs += t == REC_SERVO || t == REC_MOTOR;
+        }
+        const rec_t *last = &recs[boots[b].first + boots[b].count - 1];
+        printf("boot %zu: %zu records, %zu commands, %zu outputs, %.1f s\n",
+               b, boots[b].count, cmds, outs, (last->t_us - recs[boots[b].first].t_us) / 1e6);
+    }
+}
+
+typedef struct {
+    const char *name;
+    int channels;
+    int tol;
+    uint32_t records;
+    uint32_t over;
+    int max_err;
+} out_check_t;
+
+static void compare(out_check_t *c, FILE *csv, int64_t t_us, const int32_t *recorded, const int32_t *replayed) {
+    int worst = 0;
+    for (int i = 0; i < c->channels; i++) {
+        int err = abs(recorded[i] - replayed[i]);
+        worst = err > worst ? err : worst;
+        if (csv) {
+            fprintf(csv, "%lld,%s,%d,%d,%d\n", (long long)t_us, c->name, i, recorded[i], replayed[i]);
+        }
+    }
+    c->records++;
+    c->max_err = worst > c->max_err ? worst : c->max_err;
+    c->over += worst > c->tol;
+}
+
+static void print_check(const out_check_t *c) {
+    printf("%s outputs: %u recorded, max error %d, %u over tolerance %d\n", c->name, c->records, c->max_err, c->over, c->tol);
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL, *csv_path = NULL;
+    long boot_arg = -1;
+    long offset = 0;
+    int list = 0, verbose = 0;
+    out_check_t motor = {"motor", ROVER_NUM_MOTORS, 4, 0, 0, 0};
+    out_check_t servo = {"servo", ROVER_NUM_SERVOS, 20, 0, 0, 0};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--list") == 0) {
+            list = 1;
+        } else if (strcmp(argv[i], "--boot") == 0 && i + 1 < argc) {
+            boot_arg = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc) {
+            offset = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--tol-motor") == 0 && i + 1 < argc) {
+            motor.tol = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tol-servo") == 0 && i + 1 < argc) {
+            servo.tol = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s [--list] [--boot N] [--offset BYTES] [--csv out.csv] [--tol-motor DUTY] [--tol-servo DD] [-v] image.bin\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 2;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f) - offset;
+    if (size < RECORDER_SECTOR_SIZE) {
+        fprintf(stderr, "%s: smaller than one sector after offset\n", path);
+        return 2;
+    }
+    uint8_t *img = malloc(size);
+    fseek(f, offset, SEEK_SET);
+    if (img == NULL || fread(img, 1, size, f) != (size_t)size) {
+        perror(path);
+        return 2;
+    }
+    fclose(f);
+
+    parse_image(img, size);
+    if (num_boots == 0) {
+        fprintf(stderr, "%s: no recorder log found\n", path);
+        return 2;
+    }
+    if (list) {
+        list_boots();
+        return 0;
+    }
+    size_t b = boot_arg < 0 ? num_boots + boot_arg : (size_t)boot_arg;
+    if (b >= num_boots) {
+        fprintf(stderr, "boot %ld out of range (%zu boots)\n", boot_arg, num_boots);
+        return 2;
+    }
+    const rec_t *r = &recs[boots[b].first];
+    size_t n = boots[b].count;
+
+    FILE *csv = NULL;
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (csv == NULL) {
+            perror(csv_path);
+            return 2;
+        }
+        fprintf(csv, "t_us,kind,channel,recorded,replayed\n");
+    }
+
+    /* Simulated control ticks run every period on the recorded clock. An
+    ** output record is written by a real tick just before its timestamp, so
+    ** the tick nearest to it is moved onto the record: the replay follows the
+    ** real loop's phase and jitter instead of drifting against it.
+    */
+    const int64_t period_us = 1000000 / CONTROL_RATE_HZ;
+    ackermann_init();
+    control_shaper_t sh;
+    control_shaper_init(&sh, r[0].t_us);
+    int64_t next_tick = r[0].t_us + period_us;
+    int32_t speed[ROVER_NUM_MOTORS] = {0}, angle[ROVER_NUM_SERVOS] = {0};
+    uint32_t verdicts[3] = {0}, undecodable = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        bool output = r[i].type == REC_MOTOR || r[i].type == REC_SERVO;
+        // An earlier output record of the same tick already ran it.
+        bool same_tick = output && i > 0 && (r[i - 1].type == REC_MOTOR || r[i - 1].type == REC_SERVO) &&
+                         r[i].t_us - r[i - 1].t_us < period_us / 2;
+        int64_t due = output && !same_tick ? r[i].t_us + period_us / 2 : r[i].t_us;
+        while (next_tick <= due) {
+            int64_t now = next_tick;
+            if (output && !same_tick && next_tick + period_us > due) {
+                now = r[i].t_us;
+            }
+            setpoint_t sp;
+            control_out_t out;
+            setpoint_read(&sp);
+            control_shaper_step(&sh, &sp, now, &out);
+            if (out.motor_write) {
+                for (int k = 0; k < ROVER_NUM_MOTORS; k++) {
+                    speed[k] = out.speed[k];
+                }
+            }
+            if (out.servo_write) {
+                for (int k = 0; k < ROVER_NUM_SERVOS; k++) {
+                    angle[k] = out.angle_dd[k];
+                }
+            }
+            next_tick = now + period_us;
+        }
+
+        int32_t recorded[ROVER_NUM_MOTORS > ROVER_NUM_SERVOS ? ROVER_NUM_MOTORS : ROVER_NUM_SERVOS] = {0};
+        switch (r[i].type) {
+            case REC_CMD: {
+                if (r[i].len < 6) {
+                    undecodable++;
+                    break;
+                }
+                uint32_t ip;
+                uint16_t port;
+                memcpy(&ip, r[i].data, 4);
+                memcpy(&port, r[i].data + 4, 2);
+                rover_cmd_t cmd;
+                if (rover_decode(r[i].data + 6, r[i].len - 6, &cmd) != ROVER_PROTO_OK) {
+                    undecodable++;
+                    break;
+                }
+                seq_verdict_t v = seq_filter_check(ip, port, &cmd, r[i].t_us);
+                verdicts[v]++;
+                if (verbose) {
+                    printf("%12.6f cmd type %d seq %u %s\n", r[i].t_us / 1e6, cmd.type, cmd.has_seq ? cmd.seq : 0,
+                           v == SEQ_ACCEPT ? "" : v == SEQ_STALE ? "stale" : "duplicate");
+                }
+                if (v == SEQ_ACCEPT) {
+                    setpoint_publish_cmd(&cmd, r[i].t_us, r[i].t_us);
+                }
+                break;
+            }
+            case REC_MOTOR:
+                for (int k = 0; k < ROVER_NUM_MOTORS && 2 * k + 1 < r[i].len; k++) {
+                    recorded[k] = (int16_t)(r[i].data[2 * k] | (r[i].data[2 * k + 1] << 8));
+                }
+                compare(&motor, csv, r[i].t_us, recorded, speed);
+                break;
+            case REC_SERVO:
+                for (int k = 0; k < ROVER_NUM_SERVOS && 2 * k + 1 < r[i].len; k++) {
+                    recorded[k] = r[i].data[2 * k] | (r[i].data[2 * k + 1] << 8);
+                }
+                compare(&servo, csv, r[i].t_us, recorded, angle);
+                break;
+            default:
+                break;
+        }
+    }
+    if (csv) {
+        fclose(csv);
+    }
+
+    printf("boot %zu of %zu: %zu records over %.1f s\n", b, num_boots, n, (r[n - 1].t_us - r[0].t_us) / 1e6);
+    printf("commands: %u accepted, %u stale, %u duplicate, %u undecodable\n",
+           verdicts[SEQ_ACCEPT], verdicts[SEQ_STALE], verdicts[SEQ_DUPLICATE], undecodable);
+    print_check(&motor);
+    print_check(&servo);
+    free(img);
+    return motor.over || servo.over ? 1 : 0;
+}
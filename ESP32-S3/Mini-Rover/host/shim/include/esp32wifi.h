@@ -0,0 +1,11 @@
+/* Host stand-in for the board's Wi-Fi helper. The host build has no radio;
+** the UDP server simply binds on the loopback/any interface.
+*/
+#pragma once
+
+#ifndef SERVER_PORT
+#define SERVER_PORT 8080
+#endif
+
+void wifi_init(void);
+void print_ip_address(void);
@@ -0,0 +1,30 @@
+/* CPU cycle counter. On x86 hosts this is the time-stamp counter, which
+** ticks at a fixed rate rather than with the core clock; elsewhere it counts
+** nanoseconds. Either way it wraps at 32 bits like CCOUNT on the ESP32-S3,
+** so only differences between close readings mean anything.
+*/
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+#define HOST_CYCLE_UNIT "tsc"
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+    return (esp_cpu_cycle_count_t)__rdtsc();
+}
+#else
+#include <time.h>
+
+#define HOST_CYCLE_UNIT "ns"
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (esp_cpu_cycle_count_t)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+#endif
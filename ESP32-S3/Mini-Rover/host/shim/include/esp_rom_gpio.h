@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+static inline void esp_rom_gpio_pad_select_gpio(uint32_t gpio_num) {
+    (void)gpio_num;
+}
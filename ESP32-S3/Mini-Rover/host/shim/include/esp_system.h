@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Heap figures. The host has no fixed heap, so these report what glibc's
+** allocator has handed out, subtracted from HOST_HEAP_SIZE, to give a
+** number that moves with the firmware's allocations.
+*/
+#define HOST_HEAP_SIZE (320 * 1024)
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
@@ -0,0 +1,41 @@
+/* FreeRTOS on pthreads for the host build. Only the subset the firmware uses
+** is provided; tasks are detached threads and "cores" are a per-thread label
+** so per-core data structures behave the same as on target.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define portNUM_PROCESSORS      CONFIG_FREERTOS_NUMBER_OF_CORES
+#define configRUN_TIME_COUNTER_TYPE uint32_t
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+BaseType_t xPortGetCoreID(void);
+
+/* Critical sections. On target a portMUX is a cross-core spinlock that also
+** masks interrupts; a mutex gives the same mutual exclusion between threads.
+*/
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)  pthread_mutex_unlock(&(mux)->mutex)
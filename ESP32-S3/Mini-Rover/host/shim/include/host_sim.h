@@ -0,0 +1,61 @@
+/* Inspection and control hooks for the simulated peripherals of the host
+** build. Nothing in src/ or lib/ includes this; it is for host_main.c, tests
+** and benchmarks.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// ---- I2C bus -------------------------------------------------------------
+
+// Attach a simulated PCA9685 at addr (a 0x40 device is attached by default).
+esp_err_t i2c_sim_add_pca9685(uint8_t addr);
+void i2c_sim_remove_all(void);
+
+// Raw register of a simulated device, or 0 if absent.
+uint8_t i2c_sim_read_reg(uint8_t addr, uint8_t reg);
+
+// 12-bit OFF count currently programmed for a PCA9685 channel.
+uint16_t i2c_sim_pca9685_off(uint8_t addr, int channel);
+
+// When true (the default) each transaction sleeps for its modelled bus time.
+void i2c_sim_set_realtime(bool realtime);
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t nacks;
+    uint64_t bytes;
+    uint64_t busy_us;       // modelled SCL time at the configured clock
+} i2c_sim_stats_t;
+
+void i2c_sim_get_stats(i2c_sim_stats_t *out);
+void i2c_sim_reset_stats(void);
+
+// ---- Output waveform -----------------------------------------------------
+
+typedef enum {
+    WAVE_GPIO,      // id = GPIO number, value = level
+    WAVE_LEDC,      // id = LEDC channel, value = duty
+    WAVE_PWM,       // id = (I2C address << 8) | PCA9685 channel, value = OFF count
+} wave_kind_t;
+
+typedef struct {
+    int64_t t_us;
+    wave_kind_t kind;
+    int id;
+    uint32_t value;
+} wave_event_t;
+
+void waveform_record(wave_kind_t kind, int id, uint32_t value);
+size_t waveform_count(void);
+size_t waveform_copy(wave_event_t *out, size_t max);
+void waveform_clear(void);
+int waveform_dump_csv(const char *path);
+
+// ---- Process -------------------------------------------------------------
+
+// Reads ROVER_HOST_* environment variables. Called once before app_main().
+void host_sim_init(void);
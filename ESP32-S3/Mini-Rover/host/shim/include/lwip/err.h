@@ -0,0 +1,13 @@
+/* lwIP error codes, the subset the firmware uses. */
+#pragma once
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK      0
+#define ERR_MEM     -1
+#define ERR_BUF     -2
+#define ERR_VAL     -6
+#define ERR_USE     -8
+#define ERR_IF      -12
@@ -0,0 +1,34 @@
+/* lwIP dual-stack address type, IPv4 only on the host. Addresses are kept
+** in network byte order, as in lwIP.
+*/
+#pragma once
+
+#include <stdint.h>
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+typedef struct {
+    u32_t addr;
+} ip4_addr_t;
+
+#define IPADDR_TYPE_V4 0U
+#define IPADDR_TYPE_V6 6U
+#define IPADDR_TYPE_ANY 46U
+
+typedef struct {
+    union {
+        ip4_addr_t ip4;
+    } u_addr;
+    u8_t type;
+} ip_addr_t;
+
+extern const ip_addr_t ip_addr_any_type;
+
+#define IP_ANY_TYPE (&ip_addr_any_type)
+#define IP_IS_V4(ipaddr) ((ipaddr)->type == IPADDR_TYPE_V4)
+#define ip_2_ip4(ipaddr) (&((ipaddr)->u_addr.ip4))
+#define ip4_addr_get_u32(src_ipaddr) ((src_ipaddr)->addr)
+#define ip4_addr_set_u32(dest_ipaddr, src_u32) ((dest_ipaddr)->addr = (src_u32))
+#define ip_addr_set_ip4_u32(ipaddr, val) do { ip4_addr_set_u32(ip_2_ip4(ipaddr), val); (ipaddr)->type = IPADDR_TYPE_V4; } while (0)
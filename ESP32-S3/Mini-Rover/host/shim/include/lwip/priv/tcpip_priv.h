@@ -0,0 +1,14 @@
+/* Running a function in the tcpip thread and waiting for it, as lwIP's
+** tcpip_api_call() does. The host tcpip thread starts on first use.
+*/
+#pragma once
+
+#include "lwip/err.h"
+
+struct tcpip_api_call_data {
+    err_t err;
+};
+
+typedef err_t (*tcpip_api_call_fn)(struct tcpip_api_call_data *call);
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call);
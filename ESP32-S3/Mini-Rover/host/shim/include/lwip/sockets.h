@@ -0,0 +1,10 @@
+/* lwIP's BSD socket API maps directly onto POSIX sockets on the host. */
+#pragma once
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
@@ -0,0 +1,13 @@
+/* Host stand-in for the ESP-IDF generated sdkconfig.h. Values mirror
+** sdkconfig.esp32-s3-devkitc-1 where the firmware depends on them.
+*/
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32S3 1
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY 1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_FREERTOS_RUN_TIME_COUNTER_TYPE_U32 1
+#define CONFIG_LWIP_UDP_RECVMBOX_SIZE 6
+#define CONFIG_ESP_WIFI_STATIC_RX_BUFFER_NUM 10
@@ -0,0 +1,10 @@
+/* The subset of the ESP32-S3 GPIO register map the firmware uses. */
+#pragma once
+
+#define DR_REG_GPIO_BASE        0x60004000
+#define GPIO_OUT_REG            (DR_REG_GPIO_BASE + 0x0004)
+#define GPIO_OUT_W1TS_REG       (DR_REG_GPIO_BASE + 0x0008)
+#define GPIO_OUT_W1TC_REG       (DR_REG_GPIO_BASE + 0x000C)
+#define GPIO_OUT1_REG           (DR_REG_GPIO_BASE + 0x0010)
+#define GPIO_OUT1_W1TS_REG      (DR_REG_GPIO_BASE + 0x0014)
+#define GPIO_OUT1_W1TC_REG      (DR_REG_GPIO_BASE + 0x0018)
@@ -0,0 +1,12 @@
+/* Peripheral register access for the host build. Writes are routed to the
+** simulated peripherals instead of memory-mapped hardware.
+*/
+#pragma once
+
+#include <stdint.h>
+
+void host_reg_write(uint32_t addr, uint32_t value);
+uint32_t host_reg_read(uint32_t addr);
+
+#define REG_WRITE(_r, _v)   host_reg_write((uint32_t)(_r), (uint32_t)(_v))
+#define REG_READ(_r)        host_reg_read((uint32_t)(_r))
@@ -0,0 +1,79 @@
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+static struct timespec start_ts;
+static esp_log_level_t log_level = ESP_LOG_INFO;
+
+__attribute__((constructor))
+static void esp_host_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    const char *lvl = getenv("ROVER_HOST_LOG_LEVEL");
+    if (lvl) {
+        log_level = (esp_log_level_t)atoi(lvl);
+    }
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)(ts.tv_sec - start_ts.tv_sec) * 1000000 + (ts.tv_nsec - start_ts.tv_nsec) / 1000;
+}
+
+void host_log(esp_log_level_t level, const char *tag, const char *fmt, ...) {
+    static const char letters[] = "NEWIDV";
+    if (level > log_level) {
+        return;
+    }
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "%c (%lld) %s: %s\n", letters[level], (long long)(esp_timer_get_time() / 1000), tag, line);
+}
+
+static uint32_t min_free_heap = HOST_HEAP_SIZE;
+
+uint32_t esp_get_free_heap_size(void) {
+    struct mallinfo2 mi = mallinfo2();
+    uint32_t free_bytes = mi.uordblks < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - (uint32_t)mi.uordblks : 0;
+    if (free_bytes < min_free_heap) {
+        min_free_heap = free_bytes;
+    }
+    return free_bytes;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    esp_get_free_heap_size();
+    return min_free_heap;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                    return "ESP_OK";
+        case ESP_FAIL:                  return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:       return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND:     return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_NO_FREE_PAGES: return "ESP_ERR_NVS_NO_FREE_PAGES";
+        case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+        default:                        return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,143 @@
+/* esp_timer on pthreads. A timer owns one thread that sleeps to absolute
+** deadlines, so a periodic timer does not drift with callback run time.
+** Missed periods are skipped rather than replayed, matching
+** skip_unhandled_events on target.
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include "esp_timer.h"
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int64_t next_us;     // next deadline in esp_timer_get_time() units, -1 when stopped
+    int64_t period_us;   // 0 for one-shot
+    int quit;
+};
+
+static void *timer_thread(void *p) {
+    struct esp_timer *t = p;
+    pthread_mutex_lock(&t->lock);
+    while (!t->quit) {
+        if (t->next_us < 0) {
+            pthread_cond_wait(&t->cond, &t->lock);
+            continue;
+        }
+        int64_t wait = t->next_us - esp_timer_get_time();
+        if (wait > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += wait / 1000000;
+            ts.tv_nsec += (wait % 1000000) * 1000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+            continue;
+        }
+
+        if (t->period_us > 0) {
+            int64_t now = esp_timer_get_time();
+            do {
+                t->next_us += t->period_us;
+            } while (t->next_us <= now);
+        } else {
+            t->next_us = -1;
+        }
+        pthread_mutex_unlock(&t->lock);
+        t->args.callback(t->args.arg);
+        pthread_mutex_lock(&t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle) {
+    if (args == NULL || args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    t->args = *args;
+    t->next_us = -1;
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->cond, &ca);
+    pthread_condattr_destroy(&ca);
+    pthread_mutex_init(&t->lock, NULL);
+
+    if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    *out_handle = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t t, uint64_t us, int64_t period) {
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&t->lock);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (t->next_us < 0) {
+        t->next_us = esp_timer_get_time() + (int64_t)us;
+        t->period_us = period;
+        pthread_cond_signal(&t->cond);
+        ret = ESP_OK;
+    }
+    pthread_mutex_unlock(&t->lock);
+    return ret;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return timer_start(timer, period_us, (int64_t)period_us);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&t->lock);
+    esp_err_t ret = (t->next_us < 0) ? ESP_ERR_INVALID_STATE : ESP_OK;
+    t->next_us = -1;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t) {
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&t->lock);
+    t->quit = 1;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    if (pthread_equal(pthread_self(), t->thread)) {
+        // Deleted from its own callback: the thread still needs t on the way out.
+        pthread_detach(t->thread);
+        return ESP_OK;
+    }
+    pthread_join(t->thread, NULL);
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->cond);
+    free(t);
+    return ESP_OK;
+}
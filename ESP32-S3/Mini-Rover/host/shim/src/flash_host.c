@@ -0,0 +1,153 @@
+/* Simulated SPI NOR flash for the partition API.
+**
+** The partition table mirrors partitions.csv for the partitions the firmware
+** opens. Flash semantics are kept: erase sets bytes to 0xFF and a write can
+** only clear bits, so code that forgets to erase fails the same way on the
+** host. Erase and program calls sleep for typical NOR timings (sector erase
+** ~45 ms, page program ~0.7 ms) unless ROVER_HOST_FLASH_REALTIME=0.
+**
+** ROVER_HOST_FLASH=path keeps the contents in a file between runs, so a log
+** written by one run can be downloaded or inspected after the next boot.
+*/
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "esp_partition.h"
+
+#define SECTOR_SIZE     4096
+#define PAGE_SIZE       256
+#define ERASE_US        45000
+#define PROGRAM_US      700
+
+typedef struct {
+    esp_partition_t part;
+    uint8_t *mem;
+} host_partition_t;
+
+static host_partition_t table[] = {
+    {.part = {.type = ESP_PARTITION_TYPE_DATA, .subtype = 0x40, .address = 0x210000, .size = 0x5F0000,
+              .erase_size = SECTOR_SIZE, .label = "recorder"}},
+};
+#define NUM_PARTITIONS (sizeof(table) / sizeof(table[0]))
+
+static pthread_mutex_t flash_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t *flash;          // whole chip image, up to the end of the last partition
+static size_t flash_size;
+static int realtime = 1;
+
+static int flash_open(void) {
+    if (flash) {
+        return 0;
+    }
+    for (size_t i = 0; i < NUM_PARTITIONS; i++) {
+        size_t end = table[i].part.address + table[i].part.size;
+        flash_size = end > flash_size ? end : flash_size;
+    }
+
+    const char *rt = getenv("ROVER_HOST_FLASH_REALTIME");
+    realtime = !(rt && *rt == '0');
+
+    const char *path = getenv("ROVER_HOST_FLASH");
+    if (path && *path) {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        off_t len = fd < 0 ? -1 : lseek(fd, 0, SEEK_END);
+        if (fd < 0 || (len < (off_t)flash_size && ftruncate(fd, flash_size) != 0)) {
+            perror(path);
+            return -1;
+        }
+        flash = mmap(NULL, flash_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (flash == MAP_FAILED) {
+            flash = NULL;
+            return -1;
+        }
+        // A new file reads as zeros; a fresh chip is erased.
+        if (len < (off_t)flash_size) {
+            memset(flash + (len > 0 ? len : 0), 0xFF, flash_size - (len > 0 ? len : 0));
+        }
+    } else {
+        flash = mmap(NULL, flash_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (flash == MAP_FAILED) {
+            flash = NULL;
+            return -1;
+        }
+        memset(flash, 0xFF, flash_size);
+    }
+    for (size_t i = 0; i < NUM_PARTITIONS; i++) {
+        table[i].mem = flash + table[i].part.address;
+    }
+    return 0;
+}
+
+static host_partition_t *lookup(const esp_partition_t *part) {
+    for (size_t i = 0; i < NUM_PARTITIONS; i++) {
+        if (&table[i].part == part) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label) {
+    pthread_mutex_lock(&flash_lock);
+    int ok = flash_open() == 0;
+    pthread_mutex_unlock(&flash_lock);
+    if (!ok) {
+        return NULL;
+    }
+    for (size_t i = 0; i < NUM_PARTITIONS; i++) {
+        const esp_partition_t *p = &table[i].part;
+        if ((type == ESP_PARTITION_TYPE_ANY || p->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (label == NULL || strcmp(p->label, label) == 0)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset, void *dst, size_t size) {
+    host_partition_t *hp = lookup(part);
+    if (hp == NULL || src_offset > part->size || size > part->size - src_offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&flash_lock);
+    memcpy(dst, hp->mem + src_offset, size);
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset, const void *src, size_t size) {
+    host_partition_t *hp = lookup(part);
+    if (hp == NULL || dst_offset > part->size || size > part->size - dst_offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&flash_lock);
+    const uint8_t *s = src;
+    for (size_t i = 0; i < size; i++) {
+        hp->mem[dst_offset + i] &= s[i];
+    }
+    pthread_mutex_unlock(&flash_lock);
+    if (realtime) {
+        usleep(PROGRAM_US * ((size + PAGE_SIZE - 1) / PAGE_SIZE));
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size) {
+    host_partition_t *hp = lookup(part);
+    if (hp == NULL || offset % SECTOR_SIZE || size % SECTOR_SIZE || offset > part->size || size > part->size - offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&flash_lock);
+    memset(hp->mem + offset, 0xFF, size);
+    pthread_mutex_unlock(&flash_lock);
+    if (realtime) {
+        usleep(ERASE_US * (size / SECTOR_SIZE));
+    }
+    return ESP_OK;
+}
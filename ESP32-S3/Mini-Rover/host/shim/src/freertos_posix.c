@@ -0,0 +1,260 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    BaseType_t core;
+    BaseType_t affinity;    // as created: a core or tskNO_AFFINITY
+    UBaseType_t priority;
+    uint32_t stack_depth;
+    UBaseType_t number;
+    char name[16];
+
+    // Direct-to-task notification value, used as a counting semaphore.
+    pthread_mutex_t notify_lock;
+    pthread_cond_t notify_cond;
+    uint32_t notify;
+
+    struct host_task *next;     // in the list of live tasks
+};
+
+static __thread struct host_task *current_task;
+static BaseType_t next_core = 0;
+
+// Live tasks, for uxTaskGetSystemState(). A task leaves the list before its thread ends.
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *tasks;
+static UBaseType_t task_count;
+
+static void unlist(struct host_task *t) {
+    pthread_mutex_lock(&tasks_lock);
+    for (struct host_task **p = &tasks; *p != NULL; p = &(*p)->next) {
+        if (*p == t) {
+            *p = t->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tasks_lock);
+}
+
+static void *task_trampoline(void *p) {
+    current_task = p;
+    current_task->fn(current_task->arg);
+    unlist(current_task);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return pdFAIL;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->affinity = core;
+    t->priority = priority;
+    t->stack_depth = stack_depth;
+    pthread_mutex_init(&t->notify_lock, NULL);
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->notify_cond, &ca);
+    pthread_condattr_destroy(&ca);
+    // Unpinned tasks are spread across the simulated cores.
+    t->core = (core == tskNO_AFFINITY) ? (next_core++ % portNUM_PROCESSORS) : core;
+    strncpy(t->name, name ? name : "task", sizeof(t->name) - 1);
+
+    // Listed before the thread starts, so it can never unlist itself first.
+    pthread_mutex_lock(&tasks_lock);
+    t->number = ++task_count;
+    t->next = tasks;
+    tasks = t;
+    pthread_mutex_unlock(&tasks_lock);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    // FreeRTOS stack depth is in bytes on ESP-IDF; give host threads generous headroom.
+    pthread_attr_setstacksize(&attr, stack_depth < 65536 ? 65536 : stack_depth * 4);
+    int rc = pthread_create(&t->thread, &attr, task_trampoline, t);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        unlist(t);
+        free(t);
+        return pdFAIL;
+    }
+    if (handle) {
+        *handle = t;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) {
+        if (current_task != NULL) {
+            unlist(current_task);
+        }
+        pthread_exit(NULL);
+    }
+    unlist(task);
+    pthread_cancel(task->thread);
+}
+
+static void sleep_us(int64_t us) {
+    if (us <= 0) {
+        return;
+    }
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() * configTICK_RATE_HZ / 1000000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    // Like FreeRTOS, a delay ends on a tick boundary.
+    TickType_t target = xTaskGetTickCount() + ticks;
+    sleep_us((int64_t)target * 1000000 / configTICK_RATE_HZ - esp_timer_get_time());
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *prev_wake, TickType_t increment) {
+    TickType_t target = *prev_wake + increment;
+    TickType_t now = xTaskGetTickCount();
+    *prev_wake = target;
+    if ((int32_t)(target - now) <= 0) {
+        return pdFALSE;
+    }
+    sleep_us((int64_t)target * 1000000 / configTICK_RATE_HZ - esp_timer_get_time());
+    return pdTRUE;
+}
+
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t increment) {
+    xTaskDelayUntil(prev_wake, increment);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->notify_lock);
+    task->notify++;
+    pthread_cond_signal(&task->notify_cond);
+    pthread_mutex_unlock(&task->notify_lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_prio_woken) {
+    xTaskNotifyGive(task);
+    if (higher_prio_woken) {
+        *higher_prio_woken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    struct host_task *t = current_task;
+    if (t == NULL) {
+        return 0;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (ticks_to_wait != portMAX_DELAY) {
+        int64_t us = (int64_t)ticks_to_wait * 1000000 / configTICK_RATE_HZ;
+        deadline.tv_sec += us / 1000000;
+        deadline.tv_nsec += (us % 1000000) * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&t->notify_lock);
+    while (t->notify == 0 && ticks_to_wait != 0) {
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&t->notify_cond, &t->notify_lock);
+        } else if (pthread_cond_timedwait(&t->notify_cond, &t->notify_lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t value = t->notify;
+    if (value) {
+        t->notify = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&t->notify_lock);
+    return value;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return current_task;
+}
+
+const char *pcTaskGetName(TaskHandle_t task) {
+    task = task ? task : current_task;
+    return task ? task->name : "main";
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return current_task ? current_task->core : 0;
+}
+
+static uint32_t cpu_time_us(pthread_t thread) {
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (uint32_t)((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t array_size, configRUN_TIME_COUNTER_TYPE *total_run_time) {
+    UBaseType_t n = 0;
+    pthread_mutex_lock(&tasks_lock);
+    for (struct host_task *t = tasks; t != NULL; t = t->next) {
+        n++;
+    }
+    if (n > array_size) {
+        pthread_mutex_unlock(&tasks_lock);
+        return 0;
+    }
+    n = 0;
+    // The list lock keeps every listed thread alive while its clock is read.
+    for (struct host_task *t = tasks; t != NULL; t = t->next) {
+        status[n++] = (TaskStatus_t){
+            .xHandle = t,
+            .pcTaskName = t->name,
+            .xTaskNumber = t->number,
+            .eCurrentState = t == current_task ? eRunning : eBlocked,
+            .uxCurrentPriority = t->priority,
+            .uxBasePriority = t->priority,
+            .ulRunTimeCounter = cpu_time_us(t->thread),
+            .usStackHighWaterMark = t->stack_depth,
+        };
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    if (total_run_time) {
+        *total_run_time = (configRUN_TIME_COUNTER_TYPE)esp_timer_get_time();
+    }
+    return n;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    task = task ? task : current_task;
+    return task ? task->stack_depth : 0;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core) {
+    return NULL;
+}
+
+BaseType_t xTaskGetCoreID(TaskHandle_t task) {
+    task = task ? task : current_task;
+    return task ? task->affinity : 0;
+}
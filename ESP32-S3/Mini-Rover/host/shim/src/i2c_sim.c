@@ -0,0 +1,300 @@
+/* Simulated I2C bus with PCA9685 register models.
+**
+** Each transaction is charged its SCL time at the device's clock speed:
+** start + 9 bits per byte (address included) + stop. With realtime enabled
+** the calling thread also sleeps for that long, so the firmware sees the same
+** blocking behaviour it would on the real bus. Transfers faster than the bus
+** limit (ROVER_HOST_I2C_MAX_HZ, default 1 MHz, the PCA9685's Fm+ rating) go
+** unacknowledged, as a marginal bus would on hardware.
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "driver/i2c_master.h"
+#include "esp_timer.h"
+#include "host_sim.h"
+
+#define MAX_DEVICES 16
+
+#define PCA9685_REG_MODE1       0x00
+#define PCA9685_REG_LED0        0x06
+#define PCA9685_REG_LED15_END   0x45
+#define PCA9685_REG_ALL_LED     0xFA
+#define PCA9685_REG_PRESCALE    0xFE
+#define MODE1_RESTART           0x80
+#define MODE1_AI                0x20
+#define MODE1_SLEEP             0x10
+
+typedef struct {
+    bool present;
+    uint8_t addr;
+    uint8_t regs[256];
+    uint8_t ptr;
+} sim_pca9685_t;
+
+static sim_pca9685_t devices[MAX_DEVICES];
+struct i2c_master_bus {
+    i2c_port_num_t port;
+};
+
+struct i2c_master_dev {
+    uint16_t addr;
+    uint32_t scl_hz;
+};
+
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct i2c_master_bus bus;
+static bool installed = false;
+static uint32_t max_hz = 1000000;
+static bool realtime = true;
+static i2c_sim_stats_t stats;
+
+static sim_pca9685_t *find_device(uint8_t addr) {
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (devices[i].present && devices[i].addr == addr) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+static void pca9685_reset(sim_pca9685_t *dev) {
+    memset(dev->regs, 0, sizeof(dev->regs));
+    dev->regs[PCA9685_REG_MODE1] = MODE1_SLEEP | 0x01;     // power-on default, ALLCALL set
+    dev->regs[0x01] = 0x04;                                 // MODE2: totem pole
+    dev->regs[PCA9685_REG_PRESCALE] = 0x1E;                 // 200 Hz
+    for (int ch = 0; ch < 16; ch++) {
+        dev->regs[PCA9685_REG_LED0 + 4 * ch + 3] = 0x10;    // full OFF
+    }
+    dev->ptr = 0;
+}
+
+esp_err_t i2c_sim_add_pca9685(uint8_t addr) {
+    pthread_mutex_lock(&bus_lock);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (find_device(addr)) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        for (int i = 0; i < MAX_DEVICES; i++) {
+            if (!devices[i].present) {
+                devices[i].present = true;
+                devices[i].addr = addr;
+                pca9685_reset(&devices[i]);
+                ret = ESP_OK;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&bus_lock);
+    return ret;
+}
+
+void i2c_sim_remove_all(void) {
+    pthread_mutex_lock(&bus_lock);
+    memset(devices, 0, sizeof(devices));
+    pthread_mutex_unlock(&bus_lock);
+}
+
+uint8_t i2c_sim_read_reg(uint8_t addr, uint8_t reg) {
+    pthread_mutex_lock(&bus_lock);
+    sim_pca9685_t *dev = find_device(addr);
+    uint8_t v = dev ? dev->regs[reg] : 0;
+    pthread_mutex_unlock(&bus_lock);
+    return v;
+}
+
+uint16_t i2c_sim_pca9685_off(uint8_t addr, int channel) {
+    uint8_t base = PCA9685_REG_LED0 + 4 * channel;
+    return i2c_sim_read_reg(addr, base + 2) | ((i2c_sim_read_reg(addr, base + 3) & 0x1F) << 8);
+}
+
+void i2c_sim_set_realtime(bool on) {
+    realtime = on;
+}
+
+void i2c_sim_get_stats(i2c_sim_stats_t *out) {
+    pthread_mutex_lock(&bus_lock);
+    *out = stats;
+    pthread_mutex_unlock(&bus_lock);
+}
+
+void i2c_sim_reset_stats(void) {
+    pthread_mutex_lock(&bus_lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&bus_lock);
+}
+
+// Advance the register pointer the way the chip does with MODE1.AI set.
+static void pca9685_advance(sim_pca9685_t *dev) {
+    if (!(dev->regs[PCA9685_REG_MODE1] & MODE1_AI)) {
+        return;
+    }
+    if (dev->ptr == PCA9685_REG_LED15_END) {
+        dev->ptr = 0;
+    } else {
+        dev->ptr++;
+    }
+}
+
+static void pca9685_write_reg(sim_pca9685_t *dev, uint8_t reg, uint8_t value) {
+    if (reg == PCA9685_REG_PRESCALE && !(dev->regs[PCA9685_REG_MODE1] & MODE1_SLEEP)) {
+        return;     // PRESCALE is only writable while asleep
+    }
+    if (reg == PCA9685_REG_MODE1 && (value & MODE1_RESTART)) {
+        value &= ~MODE1_RESTART;    // writing 1 clears RESTART
+    }
+    dev->regs[reg] = value;
+
+    // ALL_LED registers fan out to every channel.
+    if (reg >= PCA9685_REG_ALL_LED && reg < PCA9685_REG_ALL_LED + 4) {
+        for (int ch = 0; ch < 16; ch++) {
+            dev->regs[PCA9685_REG_LED0 + 4 * ch + (reg - PCA9685_REG_ALL_LED)] = value;
+        }
+    }
+}
+
+static void record_outputs(sim_pca9685_t *dev, const uint8_t before[64]) {
+    for (int ch = 0; ch < 16; ch++) {
+        const uint8_t *now = &dev->regs[PCA9685_REG_LED0 + 4 * ch];
+        const uint8_t *old = &before[4 * ch];
+        if (memcmp(now, old, 4) != 0) {
+            waveform_record(WAVE_PWM, (dev->addr << 8) | ch, now[2] | ((now[3] & 0x1F) << 8));
+        }
+    }
+}
+
+static void charge_bus_time(size_t bytes_on_wire, uint32_t clk_hz) {
+    uint64_t us = ((uint64_t)bytes_on_wire * 9 + 2) * 1000000 / clk_hz;
+    stats.transactions++;
+    stats.bytes += bytes_on_wire;
+    stats.busy_us += us;
+    if (realtime) {
+        struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+        nanosleep(&ts, NULL);
+    }
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle) {
+    if (bus_config == NULL || ret_bus_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    installed = true;
+    bus.port = bus_config->i2c_port;
+    *ret_bus_handle = &bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle) {
+    installed = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config, i2c_master_dev_handle_t *ret_handle) {
+    if (bus_handle == NULL || dev_config == NULL || ret_handle == NULL || dev_config->scl_speed_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct i2c_master_dev *dev = calloc(1, sizeof(*dev));
+    if (dev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->addr = dev_config->device_address;
+    dev->scl_hz = dev_config->scl_speed_hz;
+    *ret_handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle) {
+    free(handle);
+    return ESP_OK;
+}
+
+/* Single combined transaction: optional write phase then optional read
+** phase (repeated start). The bus lock is held for the modelled duration
+** so concurrent callers serialise exactly as they would on the wire.
+*/
+static esp_err_t sim_transfer(uint16_t addr, uint32_t clk_hz, const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen) {
+    if (!installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock(&bus_lock);
+    sim_pca9685_t *dev = find_device(addr);
+    size_t wire = 1 + wlen + (rlen ? 1 + rlen : 0);
+    if (dev == NULL || clk_hz > max_hz) {
+        stats.nacks++;
+        charge_bus_time(1, clk_hz);
+        pthread_mutex_unlock(&bus_lock);
+        return ESP_ERR_INVALID_STATE;   // what the IDF driver reports for a NACK
+    }
+
+    if (wlen > 0) {
+        uint8_t before[64];
+        memcpy(before, &dev->regs[PCA9685_REG_LED0], sizeof(before));
+        dev->ptr = wbuf[0];
+        for (size_t i = 1; i < wlen; i++) {
+            pca9685_write_reg(dev, dev->ptr, wbuf[i]);
+            pca9685_advance(dev);
+        }
+        record_outputs(dev, before);
+    }
+    for (size_t i = 0; i < rlen; i++) {
+        rbuf[i] = dev->regs[dev->ptr];
+        pca9685_advance(dev);
+    }
+
+    charge_bus_time(wire, clk_hz);
+    pthread_mutex_unlock(&bus_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size, int xfer_timeout_ms) {
+    return sim_transfer(i2c_dev->addr, i2c_dev->scl_hz, write_buffer, write_size, NULL, 0);
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t i2c_dev, uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms) {
+    return sim_transfer(i2c_dev->addr, i2c_dev->scl_hz, NULL, 0, read_buffer, read_size);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms) {
+    return sim_transfer(i2c_dev->addr, i2c_dev->scl_hz, write_buffer, write_size, read_buffer, read_size);
+}
+
+// Address-only probe, run at standard mode like the IDF driver does.
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus_handle, uint16_t address, int xfer_timeout_ms) {
+    esp_err_t ret = sim_transfer(address, 100000, NULL, 0, NULL, 0);
+    return ret == ESP_ERR_INVALID_STATE ? ESP_ERR_NOT_FOUND : ret;
+}
+
+void host_sim_init(void) {
+    // ROVER_HOST_PCA9685_ADDRS="0x40,0x41" attaches several boards; default is one at 0x40.
+    const char *addrs = getenv("ROVER_HOST_PCA9685_ADDRS");
+    if (addrs == NULL || *addrs == '\0') {
+        addrs = "0x40";
+    }
+    char *end;
+    for (const char *p = addrs; *p; p = end) {
+        long a = strtol(p, &end, 0);
+        if (end == p) {
+            break;
+        }
+        i2c_sim_add_pca9685((uint8_t)a);
+        while (*end == ',' || *end == ' ') {
+            end++;
+        }
+    }
+
+    const char *rt = getenv("ROVER_HOST_I2C_REALTIME");
+    if (rt && *rt == '0') {
+        realtime = false;
+    }
+
+    // ROVER_HOST_I2C_MAX_HZ=400000 models a bus that cannot run Fm+.
+    const char *mhz = getenv("ROVER_HOST_I2C_MAX_HZ");
+    if (mhz && *mhz) {
+        max_hz = (uint32_t)strtoul(mhz, NULL, 0);
+    }
+}
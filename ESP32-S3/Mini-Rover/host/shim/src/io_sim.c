@@ -0,0 +1,374 @@
+/* Simulated GPIO and LEDC outputs. Every level or duty change is appended to
+** a timestamped waveform that can be inspected in-process or dumped as CSV.
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "host_sim.h"
+
+#define WAVE_INITIAL_CAP 4096
+
+static pthread_mutex_t wave_lock = PTHREAD_MUTEX_INITIALIZER;
+static wave_event_t *wave = NULL;
+static size_t wave_len = 0, wave_cap = 0;
+
+void waveform_record(wave_kind_t kind, int id, uint32_t value) {
+    int64_t t = esp_timer_get_time();
+    pthread_mutex_lock(&wave_lock);
+    if (wave_len == wave_cap) {
+        size_t cap = wave_cap ? wave_cap * 2 : WAVE_INITIAL_CAP;
+        wave_event_t *grown = realloc(wave, cap * sizeof(*wave));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&wave_lock);
+            return;
+        }
+        wave = grown;
+        wave_cap = cap;
+    }
+    wave[wave_len++] = (wave_event_t){.t_us = t, .kind = kind, .id = id, .value = value};
+    pthread_mutex_unlock(&wave_lock);
+}
+
+size_t waveform_count(void) {
+    pthread_mutex_lock(&wave_lock);
+    size_t n = wave_len;
+    pthread_mutex_unlock(&wave_lock);
+    return n;
+}
+
+size_t waveform_copy(wave_event_t *out, size_t max) {
+    pthread_mutex_lock(&wave_lock);
+    size_t n = wave_len < max ? wave_len : max;
+    memcpy(out, wave, n * sizeof(*out));
+    pthread_mutex_unlock(&wave_lock);
+    return n;
+}
+
+void waveform_clear(void) {
+    pthread_mutex_lock(&wave_lock);
+    wave_len = 0;
+    pthread_mutex_unlock(&wave_lock);
+}
+
+int waveform_dump_csv(const char *path) {
+    static const char *kinds[] = {"gpio", "ledc", "pwm"};
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return -1;
+    }
+    fprintf(f, "t_us,kind,id,value\n");
+    pthread_mutex_lock(&wave_lock);
+    for (size_t i = 0; i < wave_len; i++) {
+        fprintf(f, "%lld,%s,%d,%u\n", (long long)wave[i].t_us, kinds[wave[i].kind], wave[i].id, wave[i].value);
+    }
+    pthread_mutex_unlock(&wave_lock);
+    fclose(f);
+    return 0;
+}
+
+// ---- GPIO ----------------------------------------------------------------
+
+static gpio_mode_t gpio_modes[GPIO_NUM_MAX];
+static uint8_t gpio_levels[GPIO_NUM_MAX];
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    gpio_modes[gpio_num] = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    level = level ? 1 : 0;
+    if (gpio_levels[gpio_num] != level) {
+        gpio_levels[gpio_num] = level;
+        waveform_record(WAVE_GPIO, gpio_num, level);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return 0;
+    }
+    return gpio_levels[gpio_num];
+}
+
+// Apply one bank's set or clear mask; every pin in it changes at the same instant.
+static void gpio_write_mask(int bank, uint32_t mask, uint32_t level) {
+    for (int bit = 0; bit < 32 && mask; bit++, mask >>= 1) {
+        if (mask & 1) {
+            gpio_set_level((gpio_num_t)(bank * 32 + bit), level);
+        }
+    }
+}
+
+static uint32_t gpio_read_bank(int bank) {
+    uint32_t v = 0;
+    for (int bit = 0; bit < 32 && bank * 32 + bit < GPIO_NUM_MAX; bit++) {
+        v |= (uint32_t)gpio_levels[bank * 32 + bit] << bit;
+    }
+    return v;
+}
+
+void host_reg_write(uint32_t addr, uint32_t value) {
+    switch (addr) {
+        case GPIO_OUT_W1TS_REG:  gpio_write_mask(0, value, 1); break;
+        case GPIO_OUT_W1TC_REG:  gpio_write_mask(0, value, 0); break;
+        case GPIO_OUT1_W1TS_REG: gpio_write_mask(1, value, 1); break;
+        case GPIO_OUT1_W1TC_REG: gpio_write_mask(1, value, 0); break;
+        case GPIO_OUT_REG:
+            gpio_write_mask(0, value, 1);
+            gpio_write_mask(0, ~value, 0);
+            break;
+        case GPIO_OUT1_REG:
+            gpio_write_mask(1, value, 1);
+            gpio_write_mask(1, ~value & 0x3FFFFF, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+uint32_t host_reg_read(uint32_t addr) {
+    switch (addr) {
+        case GPIO_OUT_REG:  return gpio_read_bank(0);
+        case GPIO_OUT1_REG: return gpio_read_bank(1);
+        default:            return 0;
+    }
+}
+
+// ---- LEDC ----------------------------------------------------------------
+
+// Source clock of the low-speed LEDC timers (APB) and the driver's fade step period.
+#define LEDC_SIM_CLK_HZ     80000000
+#define LEDC_SIM_FADE_US    1000
+
+typedef struct {
+    bool configured;
+    int gpio_num;
+    ledc_timer_t timer;
+    uint32_t pending_duty;
+    uint32_t duty;
+
+    // Hardware fade: set up by ledc_set_fade_with_time(), run by ledc_fade_start().
+    bool fade_set, fading;
+    uint32_t fade_from, fade_to;
+    int64_t fade_start_us, fade_len_us;
+    ledc_cb_t fade_cb;
+    void *fade_cb_arg;
+} sim_ledc_channel_t;
+
+static ledc_timer_config_t ledc_timers[LEDC_TIMER_MAX];
+static sim_ledc_channel_t ledc_channels[LEDC_CHANNEL_MAX];
+static pthread_mutex_t ledc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t fade_thread;
+static bool fade_installed = false;
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *conf) {
+    if (conf == NULL || conf->timer_num >= LEDC_TIMER_MAX || conf->duty_resolution >= LEDC_TIMER_BIT_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The counter needs 2^bits source clocks per PWM period.
+    if (conf->freq_hz == 0 || ((uint64_t)conf->freq_hz << conf->duty_resolution) > LEDC_SIM_CLK_HZ) {
+        ESP_LOGE("ledc", "requested frequency %u and duty resolution %d can not be achieved", (unsigned)conf->freq_hz, conf->duty_resolution);
+        return ESP_FAIL;
+    }
+    ledc_timers[conf->timer_num] = *conf;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *conf) {
+    if (conf == NULL || conf->channel >= LEDC_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&ledc_lock);
+    sim_ledc_channel_t *ch = &ledc_channels[conf->channel];
+    ch->configured = true;
+    ch->gpio_num = conf->gpio_num;
+    ch->timer = conf->timer_sel;
+    ch->pending_duty = conf->duty;
+    ch->duty = conf->duty;
+    ch->fading = false;
+    pthread_mutex_unlock(&ledc_lock);
+    waveform_record(WAVE_LEDC, conf->channel, conf->duty);
+    return ESP_OK;
+}
+
+static bool duty_in_range(const sim_ledc_channel_t *ch, uint32_t duty) {
+    return duty <= (1u << ledc_timers[ch->timer].duty_resolution);
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty) {
+    if (channel >= LEDC_CHANNEL_MAX || !ledc_channels[channel].configured) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!duty_in_range(&ledc_channels[channel], duty)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&ledc_lock);
+    ledc_channels[channel].pending_duty = duty;
+    pthread_mutex_unlock(&ledc_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    if (channel >= LEDC_CHANNEL_MAX || !ledc_channels[channel].configured) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&ledc_lock);
+    sim_ledc_channel_t *ch = &ledc_channels[channel];
+    bool changed = ch->duty != ch->pending_duty;
+    uint32_t duty = ch->duty = ch->pending_duty;
+    pthread_mutex_unlock(&ledc_lock);
+    if (changed) {
+        waveform_record(WAVE_LEDC, channel, duty);
+    }
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    if (channel >= LEDC_CHANNEL_MAX) {
+        return 0;
+    }
+    pthread_mutex_lock(&ledc_lock);
+    uint32_t duty = ledc_channels[channel].duty;
+    pthread_mutex_unlock(&ledc_lock);
+    return duty;
+}
+
+/* Stands in for the fade hardware and its ISR: every step period, move each
+** fading channel along its line and raise LEDC_FADE_END_EVT when it arrives.
+*/
+static void *fade_thread_main(void *arg) {
+    while (1) {
+        struct timespec ts = {0, LEDC_SIM_FADE_US * 1000};
+        nanosleep(&ts, NULL);
+
+        int64_t now = esp_timer_get_time();
+        pthread_mutex_lock(&ledc_lock);
+        for (int c = 0; c < LEDC_CHANNEL_MAX; c++) {
+            sim_ledc_channel_t *ch = &ledc_channels[c];
+            if (!ch->fading) {
+                continue;
+            }
+            int64_t t = now - ch->fade_start_us;
+            uint32_t duty = ch->fade_to;
+            if (t < ch->fade_len_us) {
+                duty = ch->fade_from + ((int64_t)ch->fade_to - ch->fade_from) * t / ch->fade_len_us;
+            }
+            if (duty != ch->duty) {
+                ch->duty = ch->pending_duty = duty;
+                waveform_record(WAVE_LEDC, c, duty);
+            }
+            if (t >= ch->fade_len_us) {
+                ch->fading = false;
+                if (ch->fade_cb) {
+                    ledc_cb_param_t param = {.event = LEDC_FADE_END_EVT, .speed_mode = LEDC_LOW_SPEED_MODE, .channel = c, .duty = duty};
+                    ch->fade_cb(&param, ch->fade_cb_arg);
+                }
+            }
+        }
+        pthread_mutex_unlock(&ledc_lock);
+    }
+    return NULL;
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags) {
+    if (fade_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (pthread_create(&fade_thread, NULL, fade_thread_main, NULL) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(fade_thread);
+    fade_installed = true;
+    return ESP_OK;
+}
+
+void ledc_fade_func_uninstall(void) {
+    // The step thread keeps running; with no channel fading it does nothing.
+    fade_installed = false;
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t target_duty, int max_fade_time_ms) {
+    if (channel >= LEDC_CHANNEL_MAX || !ledc_channels[channel].configured || max_fade_time_ms <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!fade_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sim_ledc_channel_t *ch = &ledc_channels[channel];
+    if (!duty_in_range(ch, target_duty)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&ledc_lock);
+    // The real driver blocks here until the running fade ends; report that as misuse instead.
+    esp_err_t err = ESP_OK;
+    if (ch->fading) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        ch->fade_set = true;
+        ch->fade_from = ch->duty;
+        ch->fade_to = target_duty;
+        ch->fade_len_us = (int64_t)max_fade_time_ms * 1000;
+    }
+    pthread_mutex_unlock(&ledc_lock);
+    return err;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_fade_mode_t fade_mode) {
+    if (channel >= LEDC_CHANNEL_MAX || fade_mode >= LEDC_FADE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_ledc_channel_t *ch = &ledc_channels[channel];
+    pthread_mutex_lock(&ledc_lock);
+    if (!ch->fade_set) {
+        pthread_mutex_unlock(&ledc_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    ch->fade_set = false;
+    ch->fade_start_us = esp_timer_get_time();
+    ch->fading = true;
+    pthread_mutex_unlock(&ledc_lock);
+
+    while (fade_mode == LEDC_FADE_WAIT_DONE && ch->fading) {
+        struct timespec ts = {0, LEDC_SIM_FADE_US * 1000};
+        nanosleep(&ts, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_stop(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    if (channel >= LEDC_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The duty stays where the fade had got to; no end event is raised.
+    pthread_mutex_lock(&ledc_lock);
+    ledc_channels[channel].fading = false;
+    ledc_channels[channel].fade_set = false;
+    pthread_mutex_unlock(&ledc_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_cb_register(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_cbs_t *cbs, void *user_arg) {
+    if (channel >= LEDC_CHANNEL_MAX || cbs == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&ledc_lock);
+    ledc_channels[channel].fade_cb = cbs->fade_cb;
+    ledc_channels[channel].fade_cb_arg = user_arg;
+    pthread_mutex_unlock(&ledc_lock);
+    return ESP_OK;
+}
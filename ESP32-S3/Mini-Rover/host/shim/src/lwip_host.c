@@ -0,0 +1,255 @@
+/* Raw lwIP UDP on host sockets, with a tcpip thread of its own.
+**
+** Like lwIP's, the tcpip thread owns every pcb: it waits on the pcb
+** sockets, reads each datagram into a new pbuf and runs the receive
+** callback, which must free it. tcpip_api_call() queues a function for the
+** thread and waits until it has run, so pcbs are only ever touched there.
+** The thread starts on the first call.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "lwip/udp.h"
+#include "lwip/priv/tcpip_priv.h"
+
+#define MAX_PCBS 8
+#define MAX_DATAGRAM 1500
+
+struct udp_pcb {
+    int fd;
+    udp_recv_fn recv;
+    void *recv_arg;
+};
+
+typedef struct api_call {
+    tcpip_api_call_fn fn;
+    struct tcpip_api_call_data *call;
+    bool done;
+    struct api_call *next;
+} api_call_t;
+
+const ip_addr_t ip_addr_any_type = {.type = IPADDR_TYPE_ANY};
+
+static pthread_once_t started = PTHREAD_ONCE_INIT;
+static pthread_t tcpip_thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t call_done = PTHREAD_COND_INITIALIZER;
+static api_call_t *queue_head, *queue_tail;
+static int wake_pipe[2];
+
+// tcpip thread only.
+static struct udp_pcb *pcbs[MAX_PCBS];
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+    struct pbuf *p = malloc(sizeof(*p) + length);
+    if (p == NULL) {
+        return NULL;
+    }
+    *p = (struct pbuf){.payload = p + 1, .tot_len = length, .len = length, .ref = 1};
+    return p;
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+    if (p == NULL || --p->ref > 0) {
+        return 0;
+    }
+    free(p);
+    return 1;
+}
+
+err_t pbuf_take(struct pbuf *buf, const void *dataptr, u16_t len) {
+    if (len > buf->tot_len) {
+        return ERR_MEM;
+    }
+    memcpy(buf->payload, dataptr, len);
+    return ERR_OK;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset) {
+    if (offset >= p->len) {
+        return 0;
+    }
+    u16_t n = len < p->len - offset ? len : p->len - offset;
+    memcpy(dataptr, (const uint8_t *)p->payload + offset, n);
+    return n;
+}
+
+struct udp_pcb *udp_new(void) {
+    for (int i = 0; i < MAX_PCBS; i++) {
+        if (pcbs[i] == NULL) {
+            pcbs[i] = calloc(1, sizeof(struct udp_pcb));
+            if (pcbs[i] != NULL) {
+                pcbs[i]->fd = -1;
+            }
+            return pcbs[i];
+        }
+    }
+    return NULL;
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        return ERR_MEM;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = (ipaddr == NULL || ipaddr->type != IPADDR_TYPE_V4) ? htonl(INADDR_ANY) : ipaddr->u_addr.ip4.addr,
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return ERR_USE;
+    }
+    pcb->fd = fd;
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(dst_port),
+        .sin_addr.s_addr = dst_ip->u_addr.ip4.addr,
+    };
+    if (sendto(pcb->fd, p->payload, p->len, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        return ERR_IF;
+    }
+    return ERR_OK;
+}
+
+void udp_remove(struct udp_pcb *pcb) {
+    for (int i = 0; i < MAX_PCBS; i++) {
+        if (pcbs[i] == pcb) {
+            pcbs[i] = NULL;
+        }
+    }
+    if (pcb->fd >= 0) {
+        close(pcb->fd);
+    }
+    free(pcb);
+}
+
+// Hand every datagram waiting on a ready pcb to its callback, one pbuf each.
+static void input(struct udp_pcb *pcb) {
+    uint8_t buf[MAX_DATAGRAM];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t n;
+    while ((n = recvfrom(pcb->fd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len)) >= 0) {
+        if (pcb->recv == NULL) {
+            continue;
+        }
+        // The copy into the pbuf stands in for the network driver's.
+        struct pbuf *p = pbuf_alloc(PBUF_RAW, (u16_t)n, PBUF_POOL);
+        if (p == NULL) {
+            return;
+        }
+        memcpy(p->payload, buf, n);
+        ip_addr_t addr;
+        ip_addr_set_ip4_u32(&addr, from.sin_addr.s_addr);
+        pcb->recv(pcb->recv_arg, pcb, p, &addr, ntohs(from.sin_port));
+        from_len = sizeof(from);
+    }
+}
+
+static void run_calls(void) {
+    char drain[64];
+    while (read(wake_pipe[0], drain, sizeof(drain)) == sizeof(drain)) {
+    }
+    pthread_mutex_lock(&lock);
+    while (queue_head != NULL) {
+        api_call_t *c = queue_head;
+        queue_head = c->next;
+        if (queue_head == NULL) {
+            queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&lock);
+        c->call->err = c->fn(c->call);
+        pthread_mutex_lock(&lock);
+        c->done = true;
+    }
+    pthread_cond_broadcast(&call_done);
+    pthread_mutex_unlock(&lock);
+}
+
+static void *tcpip_main(void *arg) {
+    struct pollfd fds[1 + MAX_PCBS];
+    struct udp_pcb *ready[1 + MAX_PCBS];
+
+    while (1) {
+        int n = 0;
+        fds[n++] = (struct pollfd){.fd = wake_pipe[0], .events = POLLIN};
+        for (int i = 0; i < MAX_PCBS; i++) {
+            if (pcbs[i] != NULL && pcbs[i]->fd >= 0) {
+                ready[n] = pcbs[i];
+                fds[n++] = (struct pollfd){.fd = pcbs[i]->fd, .events = POLLIN};
+            }
+        }
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            abort();
+        }
+        for (int i = 1; i < n; i++) {
+            if (fds[i].revents & POLLIN) {
+                input(ready[i]);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            run_calls();
+        }
+    }
+    return NULL;
+}
+
+static void start(void) {
+    if (pipe(wake_pipe) < 0) {
+        abort();
+    }
+    // Never block on a full pipe; one pending wake-up is as good as many.
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+    if (pthread_create(&tcpip_thread, NULL, tcpip_main, NULL) != 0) {
+        abort();
+    }
+}
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call) {
+    pthread_once(&started, start);
+    if (pthread_equal(pthread_self(), tcpip_thread)) {
+        return call->err = fn(call);
+    }
+
+    api_call_t c = {.fn = fn, .call = call};
+    pthread_mutex_lock(&lock);
+    if (queue_tail != NULL) {
+        queue_tail->next = &c;
+    } else {
+        queue_head = &c;
+    }
+    queue_tail = &c;
+    pthread_mutex_unlock(&lock);
+
+    char one = 1;
+    (void)!write(wake_pipe[1], &one, 1);
+
+    pthread_mutex_lock(&lock);
+    while (!c.done) {
+        pthread_cond_wait(&call_done, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return call->err;
+}
@@ -0,0 +1,152 @@
+/* In-memory NVS. Namespaces and blob keys behave like the real thing for
+** the lifetime of the process; nothing is persisted between runs, so every
+** host boot starts from the firmware's compiled-in defaults.
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#define NVS_MAX_ENTRIES     32
+#define NVS_MAX_NAMESPACES  8
+#define NVS_KEY_LEN         16
+
+typedef struct {
+    uint32_t ns;
+    char key[NVS_KEY_LEN];
+    void *data;
+    size_t len;
+} nvs_entry_t;
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static nvs_entry_t entries[NVS_MAX_ENTRIES];
+static char namespaces[NVS_MAX_NAMESPACES][NVS_KEY_LEN];
+static int initialized = 0;
+
+esp_err_t nvs_flash_init(void) {
+    initialized = 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        free(entries[i].data);
+        memset(&entries[i], 0, sizeof(entries[i]));
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+// Handles are namespace index + 1 so that 0 is never valid.
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if (!initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (namespace_name == NULL || strlen(namespace_name) >= NVS_KEY_LEN || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t ret = ESP_ERR_NVS_NOT_FOUND;
+    for (int i = 0; i < NVS_MAX_NAMESPACES; i++) {
+        if (strcmp(namespaces[i], namespace_name) == 0) {
+            *out_handle = i + 1;
+            ret = ESP_OK;
+            break;
+        }
+        if (namespaces[i][0] == 0) {
+            // Like the real NVS, a read-only open does not create the namespace.
+            if (open_mode == NVS_READWRITE) {
+                strcpy(namespaces[i], namespace_name);
+                *out_handle = i + 1;
+                ret = ESP_OK;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+static nvs_entry_t *find_entry(nvs_handle_t handle, const char *key) {
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (entries[i].ns == handle && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    if (handle == 0 || handle > NVS_MAX_NAMESPACES) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t ret = ESP_OK;
+    nvs_entry_t *e = find_entry(handle, key);
+    if (e == NULL) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out_value == NULL) {
+        *length = e->len;
+    } else if (*length < e->len) {
+        ret = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, e->data, e->len);
+        *length = e->len;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    if (handle == 0 || handle > NVS_MAX_NAMESPACES) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (key == NULL || strlen(key) >= NVS_KEY_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    void *copy = malloc(length ? length : 1);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t ret = ESP_OK;
+    nvs_entry_t *e = find_entry(handle, key);
+    if (e == NULL) {
+        e = find_entry(0, "");
+    }
+    if (e == NULL) {
+        free(copy);
+        ret = ESP_ERR_NVS_NO_FREE_PAGES;
+    } else {
+        free(e->data);
+        e->ns = handle;
+        strcpy(e->key, key);
+        e->data = copy;
+        e->len = length;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    pthread_mutex_lock(&nvs_lock);
+    nvs_entry_t *e = find_entry(handle, key);
+    if (e != NULL) {
+        free(e->data);
+        memset(e, 0, sizeof(*e));
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return e ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
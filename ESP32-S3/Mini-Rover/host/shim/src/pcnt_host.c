@@ -0,0 +1,59 @@
+/* Pulse counter stand-in: there is nothing to count on the host, so no unit
+** can be created and the rest of the API is never reached.
+*/
+#include "driver/pulse_cnt.h"
+
+esp_err_t pcnt_new_unit(const pcnt_unit_config_t *config, pcnt_unit_handle_t *ret_unit) {
+    *ret_unit = NULL;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t unit, const pcnt_glitch_filter_config_t *config) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_new_channel(pcnt_unit_handle_t unit, const pcnt_chan_config_t *config, pcnt_channel_handle_t *ret_chan) {
+    *ret_chan = NULL;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t chan, pcnt_channel_edge_action_t pos_act, pcnt_channel_edge_action_t neg_act) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_channel_set_level_action(pcnt_channel_handle_t chan, pcnt_channel_level_action_t high_act, pcnt_channel_level_action_t low_act) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unit, int watch_point) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unit) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_unit_start(pcnt_unit_handle_t unit) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int *value) {
+    *value = 0;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unit) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_del_channel(pcnt_channel_handle_t chan) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t pcnt_del_unit(pcnt_unit_handle_t unit) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,183 @@
+/* FreeRTOS queues and semaphores for the host build: a ring buffer guarded
+** by one mutex with condition variables for "not empty" and "not full".
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    if (length == 0) {
+        return NULL;
+    }
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+        return NULL;
+    }
+    q->items = calloc(length, item_size ? item_size : 1);
+    if (q->items == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->not_empty, &ca);
+    pthread_cond_init(&q->not_full, &ca);
+    pthread_condattr_destroy(&ca);
+    pthread_mutex_init(&q->lock, NULL);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    if (q == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->items);
+    free(q);
+}
+
+// Wait on cond until pred holds or the tick timeout passes. Called with q->lock held.
+static int wait_for(struct host_queue *q, pthread_cond_t *cond, int (*pred)(struct host_queue *), TickType_t ticks) {
+    if (pred(q)) {
+        return 1;
+    }
+    if (ticks == 0) {
+        return 0;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (ticks != portMAX_DELAY) {
+        int64_t us = (int64_t)ticks * 1000000 / configTICK_RATE_HZ;
+        deadline.tv_sec += us / 1000000;
+        deadline.tv_nsec += (us % 1000000) * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+    while (!pred(q)) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, &q->lock);
+        } else if (pthread_cond_timedwait(cond, &q->lock, &deadline) == ETIMEDOUT) {
+            return pred(q);
+        }
+    }
+    return 1;
+}
+
+static int has_items(struct host_queue *q) {
+    return q->count > 0;
+}
+
+static int has_space(struct host_queue *q) {
+    return q->count < q->length;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks_to_wait) {
+    pthread_mutex_lock(&q->lock);
+    if (!wait_for(q, &q->not_full, has_space, ticks_to_wait)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    UBaseType_t tail = (q->head + q->count) % q->length;
+    if (q->item_size && item) {
+        memcpy(q->items + (size_t)tail * q->item_size, item, q->item_size);
+    }
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item, TickType_t ticks_to_wait) {
+    return xQueueSend(q, item, ticks_to_wait);
+}
+
+static BaseType_t queue_take(QueueHandle_t q, void *item, TickType_t ticks_to_wait, int remove) {
+    pthread_mutex_lock(&q->lock);
+    if (!wait_for(q, &q->not_empty, has_items, ticks_to_wait)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    if (q->item_size && item) {
+        memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    }
+    if (remove) {
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks_to_wait) {
+    return queue_take(q, item, ticks_to_wait, 1);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks_to_wait) {
+    return queue_take(q, item, ticks_to_wait, 0);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+// Semaphores hold no data; the item count is the semaphore value.
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    QueueHandle_t q = xQueueCreate(max_count, 0);
+    if (q) {
+        q->count = initial_count < max_count ? initial_count : max_count;
+    }
+    return q;
+}
+
+// Not recursive and without priority inheritance, which the host does not need.
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    return xQueueReceive(sem, NULL, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return xQueueSend(sem, NULL, 0);
+}
@@ -0,0 +1,12 @@
+#include "esp_log.h"
+#include "esp32wifi.h"
+
+static const char *TAG = "WIFI";
+
+void wifi_init(void) {
+    ESP_LOGI(TAG, "Host build: no radio, using the host network stack");
+}
+
+void print_ip_address(void) {
+    ESP_LOGI(TAG, "Listening on all host interfaces, UDP port %d", SERVER_PORT);
+}
@@ -0,0 +1,242 @@
+/* Offline step response of the wheel speed loop against the simulated plant.
+**
+**   rover_speed_tune [--kp Q12] [--ki Q12] [--kd Q12] [--csv out.csv]
+**
+** speed_loop_step() and the plant of src/plant.h are stepped together at
+** SPEED_RATE_HZ on a simulated clock, so this is the rover's loop with the
+** rover's arithmetic, minus the scheduling. Each scenario holds a target on
+** every wheel and reports, for the worst wheel, the 10-90 % rise time, the
+** overshoot and the steady-state error over the last 200 ms. An open-loop
+** run (feed-forward only) is shown for comparison.
+**
+** A last run freezes one wheel's counter, as a dead encoder would, and
+** checks that the loop drops that wheel within SPEED_STALL_PERIODS and that
+** the open-loop wheels (the middle ones, and the dead one once dropped) are
+** never driven into saturation.
+**
+** The exit status is 1 if the default gains miss the limits in the
+** scenario table, so a change to the loop or the gains that makes the
+** response worse fails.
+*/
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "speed.h"
+#include "plant.h"
+
+#define PERIOD_US (1000000 / SPEED_RATE_HZ)
+#define HOLD_US 1500000
+#define SETTLED_US 200000
+
+// Closed-loop steady-state limit, for every scenario.
+#define MAX_SS_ERR_PCT 2.0
+
+/* Rise time and overshoot limits are per scenario: steps into full duty are
+** limited by the motor, not the loop, and a slow start has to break the
+** wheel free first, so it overshoots by nature.
+*/
+typedef struct {
+    const char *name;
+    int16_t from, to;       // shaped speeds, -255..255
+    double max_rise_ms;
+    double max_overshoot_pct;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {"start half", 0, 128, 80, 10},
+    {"start full", 0, 255, 150, 5},
+    {"slow", 0, 32, 300, 15},
+    {"half to full", 128, 255, 130, 5},
+    {"reverse", 128, -128, 100, 6},
+};
+
+typedef struct {
+    double rise_ms;         // worst wheel, 10 % to 90 % of the step
+    double overshoot_pct;   // worst wheel, beyond the target, of the step size
+    double ss_err_pct;      // worst wheel, mean error over the last SETTLED_US, of the target
+    uint8_t stalled;        // wheels stall detection dropped, none expected
+} result_t;
+
+static FILE *csv;
+
+static void run(const scenario_t *sc, uint8_t measured, int32_t kp, int32_t ki, int32_t kd, result_t *r) {
+    plant_t plant;
+    speed_loop_t loop;
+    int32_t target[ROVER_NUM_MOTORS];
+    int16_t duty[ROVER_NUM_MOTORS];
+    int64_t t = 0;
+
+    plant_init(&plant, 0);
+    speed_loop_init(&loop, measured);
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        loop.pid[w].kp = kp;
+        loop.pid[w].ki = ki;
+        loop.pid[w].kd = kd;
+    }
+
+    // Settle on the starting speed, then step.
+    for (int phase = 0; phase < 2; phase++) {
+        int16_t speed = phase ? sc->to : sc->from;
+        for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+            target[w] = speed_target_cps(speed);
+        }
+        double start[ROVER_NUM_MOTORS], t10[ROVER_NUM_MOTORS], t90[ROVER_NUM_MOTORS], peak[ROVER_NUM_MOTORS], err[ROVER_NUM_MOTORS];
+        int settled = 0;
+        for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+            start[w] = plant.cps[w];
+            t10[w] = t90[w] = -1;
+            peak[w] = 0;
+            err[w] = 0;
+        }
+        int64_t t0 = t;
+        for (; t - t0 < HOLD_US; t += PERIOD_US) {
+            int32_t counts[ROVER_NUM_MOTORS];
+            plant_advance(&plant, t);
+            memcpy(counts, plant.counts, sizeof(counts));
+            speed_loop_step(&loop, target, counts, t, duty);
+            memcpy(plant.duty, duty, sizeof(duty));
+            if (!phase) {
+                continue;
+            }
+
+            for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+                double step = target[w] - start[w];
+                double done = (plant.cps[w] - start[w]) / step;
+                if (t10[w] < 0 && done >= 0.1) {
+                    t10[w] = (t - t0) / 1000.0;
+                }
+                if (t90[w] < 0 && done >= 0.9) {
+                    t90[w] = (t - t0) / 1000.0;
+                }
+                if (done - 1 > peak[w]) {
+                    peak[w] = done - 1;
+                }
+                if (t - t0 >= HOLD_US - SETTLED_US) {
+                    err[w] += plant.cps[w] - target[w];
+                }
+            }
+            if (t - t0 >= HOLD_US - SETTLED_US) {
+                settled++;
+            }
+            if (csv) {
+                fprintf(csv, "%s,%d,%lld", sc->name, measured != 0, (long long)(t - t0));
+                for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+                    fprintf(csv, ",%.0f,%d", plant.cps[w], duty[w]);
+                }
+                fprintf(csv, "\n");
+            }
+        }
+
+        if (phase) {
+            *r = (result_t){0};
+            for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+                double rise = (t10[w] < 0 || t90[w] < 0) ? INFINITY : t90[w] - t10[w];
+                double ss = fabs(err[w] / settled) / fabs((double)target[w]) * 100;
+                r->rise_ms = fmax(r->rise_ms, rise);
+                r->overshoot_pct = fmax(r->overshoot_pct, peak[w] * 100);
+                r->ss_err_pct = fmax(r->ss_err_pct, ss);
+            }
+            r->stalled = loop.stalled;
+        }
+    }
+}
+
+/* Half speed on the encoder layout (middle wheels unmeasured) with wheel 0's
+** counter stuck at zero. Returns the periods until the loop dropped it, or
+** -1 if it never did, and in *max_duty the largest duty any open-loop wheel
+** was given.
+*/
+static int run_dead_encoder(int *max_duty) {
+    const uint8_t measured = 0x33;
+    plant_t plant;
+    speed_loop_t loop;
+    int32_t target[ROVER_NUM_MOTORS];
+    int16_t duty[ROVER_NUM_MOTORS];
+    int dropped = -1;
+
+    plant_init(&plant, 0);
+    speed_loop_init(&loop, measured);
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        target[w] = speed_target_cps(128);
+    }
+    *max_duty = 0;
+    for (int k = 0; k * PERIOD_US < HOLD_US; k++) {
+        int32_t counts[ROVER_NUM_MOTORS];
+        plant_advance(&plant, (int64_t)k * PERIOD_US);
+        memcpy(counts, plant.counts, sizeof(counts));
+        counts[0] = 0;
+        speed_loop_step(&loop, target, counts, (int64_t)k * PERIOD_US, duty);
+        memcpy(plant.duty, duty, sizeof(duty));
+        if (dropped < 0 && (loop.stalled & 1)) {
+            dropped = k;
+        }
+        for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+            if (!(loop.measured & (1u << w))) {
+                *max_duty = abs(duty[w]) > *max_duty ? abs(duty[w]) : *max_duty;
+            }
+        }
+    }
+    return loop.stalled == 1 ? dropped : -1;
+}
+
+int main(int argc, char **argv) {
+    int32_t kp = SPEED_KP_Q12, ki = SPEED_KI_Q12, kd = SPEED_KD_Q12;
+    bool defaults = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--kp") && i + 1 < argc) {
+            kp = atoi(argv[++i]);
+            defaults = false;
+        } else if (!strcmp(argv[i], "--ki") && i + 1 < argc) {
+            ki = atoi(argv[++i]);
+            defaults = false;
+        } else if (!strcmp(argv[i], "--kd") && i + 1 < argc) {
+            kd = atoi(argv[++i]);
+            defaults = false;
+        } else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+            csv = fopen(argv[++i], "w");
+            if (csv == NULL) {
+                perror(argv[i]);
+                return 2;
+            }
+            fprintf(csv, "scenario,closed,t_us");
+            for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+                fprintf(csv, ",cps%d,duty%d", w, w);
+            }
+            fprintf(csv, "\n");
+        } else {
+            fprintf(stderr, "usage: %s [--kp Q12] [--ki Q12] [--kd Q12] [--csv out.csv]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("kp %d ki %d kd %d kff %d (Q12), %d Hz, window %d\n", kp, ki, kd, SPEED_KFF_Q12, SPEED_RATE_HZ, SPEED_WINDOW);
+    printf("%-14s  %-11s  %8s  %9s  %8s\n", "scenario", "loop", "rise ms", "overshoot", "ss err");
+    bool fail = false;
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        for (int closed = 1; closed >= 0; closed--) {
+            const scenario_t *sc = &scenarios[s];
+            result_t r;
+            run(sc, closed ? (1u << ROVER_NUM_MOTORS) - 1 : 0, kp, ki, kd, &r);
+            bool bad = closed && (r.rise_ms > sc->max_rise_ms || r.overshoot_pct > sc->max_overshoot_pct || r.ss_err_pct > MAX_SS_ERR_PCT || r.stalled);
+            printf("%-14s  %-11s  %8.1f  %8.1f%%  %7.1f%%%s\n", sc->name, closed ? "closed" : "feedforward",
+                   r.rise_ms, r.overshoot_pct, r.ss_err_pct, bad ? "  FAIL" : "");
+            fail |= bad;
+        }
+    }
+
+    int max_duty;
+    int dropped = run_dead_encoder(&max_duty);
+    bool bad = dropped < 0 || dropped > SPEED_STALL_PERIODS + 1 || max_duty >= L298N_MAX_DUTY;
+    printf("dead encoder    dropped after %d periods, max duty %d%s\n", dropped, max_duty, bad ? "  FAIL" : "");
+    fail |= bad;
+
+    if (csv) {
+        fclose(csv);
+    }
+    // Only the shipped gains are held to the limits; other gains are for exploring.
+    return defaults && fail ? 1 : 0;
+}
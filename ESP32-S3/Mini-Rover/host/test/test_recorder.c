@@ -0,0 +1,239 @@
+/* Host test of the flight recorder (lib/Recorder/recorder.c) against the
+** simulated flash of shim/src/flash_host.c, with the real writer task.
+**
+** The partition is seeded before recorder_init(): the newest sector is only
+** newest with wrap-around sequence compare, the one after it holds stale
+** bytes, and the sectors past the erase-ahead pool hold junk. The cases then
+** run in order on the one recorder: resume after the newest sector, a
+** partial flush followed by more records in the same sector, drops while
+** both stage buffers are busy, and drops under recorder_hold_erase() once
+** the pre-erased sectors run out.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "protocol.h"
+#include "recorder.h"
+
+#define NEWEST 3
+#define NEWEST_SEQ 0u
+#define JUNK_FIRST (NEWEST + 2)
+#define JUNK_LAST (JUNK_FIRST + RECORDER_ERASE_AHEAD + 8)
+#define BIG_PAYLOAD (RECORDER_MAX_PAYLOAD - RECORDER_REC_HEADER_LEN)    // 255-byte records, 16 to a sector
+#define BIG_PER_SECTOR ((RECORDER_SECTOR_SIZE - RECORDER_SECTOR_HEADER_LEN) / (RECORDER_REC_HEADER_LEN + BIG_PAYLOAD))
+
+static int failures;
+static const esp_partition_t *part;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, __func__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    uint8_t type, len;
+    uint8_t data[RECORDER_MAX_PAYLOAD];
+} rec_t;
+
+static void put_header(uint32_t sector, uint32_t magic, uint32_t seq) {
+    uint8_t hdr[RECORDER_SECTOR_HEADER_LEN];
+    put_u32le(hdr, magic);
+    put_u32le(hdr + 4, seq);
+    esp_partition_write(part, sector * RECORDER_SECTOR_SIZE, hdr, sizeof(hdr));
+}
+
+static void fill_sector(uint32_t sector, uint8_t value) {
+    static uint8_t buf[RECORDER_SECTOR_SIZE];
+    memset(buf, value, sizeof(buf));
+    esp_partition_write(part, sector * RECORDER_SECTOR_SIZE, buf, sizeof(buf));
+}
+
+static uint8_t first_byte(uint32_t sector) {
+    uint8_t b = 0;
+    recorder_read(sector * RECORDER_SECTOR_SIZE, &b, 1);
+    return b;
+}
+
+/* Parse a sector as the recorder wrote it. Returns the number of records,
+** -1 if the header is not RECORDER_MAGIC with the given sequence number or
+** the bytes after the last record are not erased.
+*/
+static int read_sector(uint32_t sector, uint32_t seq, rec_t *out, int max) {
+    static uint8_t buf[RECORDER_SECTOR_SIZE];
+    if (recorder_read(sector * RECORDER_SECTOR_SIZE, buf, sizeof(buf)) != ESP_OK ||
+        get_u32le(buf) != RECORDER_MAGIC || get_u32le(buf + 4) != seq) {
+        return -1;
+    }
+    int n = 0;
+    uint32_t off = RECORDER_SECTOR_HEADER_LEN;
+    while (off + RECORDER_REC_HEADER_LEN <= sizeof(buf) && buf[off + 4] != 0xFF) {
+        uint8_t len = buf[off + 5];
+        if (off + RECORDER_REC_HEADER_LEN + len > sizeof(buf)) {
+            return -1;
+        }
+        if (n < max) {
+            out[n].type = buf[off + 4];
+            out[n].len = len;
+            memcpy(out[n].data, buf + off + RECORDER_REC_HEADER_LEN, len);
+        }
+        n++;
+        off += RECORDER_REC_HEADER_LEN + len;
+    }
+    for (; off < sizeof(buf); off++) {
+        if (buf[off] != 0xFF) {
+            return -1;
+        }
+    }
+    return n;
+}
+
+// Wait up to three flush periods for the sector to hold at least want records.
+static int wait_records(uint32_t sector, uint32_t seq, rec_t *out, int max, int want) {
+    int64_t end_us = esp_timer_get_time() + 3 * RECORDER_FLUSH_MS * 1000LL;
+    int n;
+    while ((n = read_sector(sector, seq, out, max)) < want && esp_timer_get_time() < end_us) {
+        usleep(10000);
+    }
+    return n;
+}
+
+static void write_big(uint8_t tag) {
+    uint8_t payload[BIG_PAYLOAD];
+    memset(payload, tag, sizeof(payload));
+    recorder_write(REC_CMD, payload, sizeof(payload));
+}
+
+static void test_resume(void) {
+    recorder_info_t info;
+    recorder_get_info(&info);
+    CHECK(info.head_sector == NEWEST + 1);
+    CHECK(info.head_seq == NEWEST_SEQ + 1);
+    CHECK(info.records == 1);       // REC_BOOT
+}
+
+static void test_partial_flush_then_continue(void) {
+    rec_t r[8];
+    recorder_write(REC_CMD, "a", 1);
+    recorder_write(REC_SERVO, "bb", 2);
+    recorder_write(REC_MOTOR, "ccc", 3);
+    // The stale bytes of the resumed sector are erased before the first write.
+    CHECK(wait_records(NEWEST + 1, NEWEST_SEQ + 1, r, 8, 4) == 4);
+    CHECK(r[0].type == REC_BOOT && r[0].len == 0);
+    CHECK(r[1].type == REC_CMD && r[1].len == 1 && r[1].data[0] == 'a');
+    CHECK(r[3].type == REC_MOTOR && r[3].len == 3 && memcmp(r[3].data, "ccc", 3) == 0);
+
+    // The next flush appends to the same sector: no second header, nothing rewritten.
+    recorder_write(REC_CMD, "dddd", 4);
+    recorder_write(REC_CMD, NULL, 0);
+    CHECK(wait_records(NEWEST + 1, NEWEST_SEQ + 1, r, 8, 6) == 6);
+    CHECK(r[2].type == REC_SERVO && r[2].len == 2 && memcmp(r[2].data, "bb", 2) == 0);
+    CHECK(r[4].type == REC_CMD && r[4].len == 4 && memcmp(r[4].data, "dddd", 4) == 0);
+    CHECK(r[5].type == REC_CMD && r[5].len == 0);
+}
+
+static void test_drop_when_both_buffers_busy(void) {
+    recorder_info_t before, after;
+    recorder_get_info(&before);
+    // Appends take microseconds, a sector write ~11 ms: the second buffer fills while the first is written.
+    int n = 0;
+    do {
+        write_big((uint8_t)n);
+        recorder_get_info(&after);
+    } while (after.dropped == before.dropped && ++n < 16 * BIG_PER_SECTOR);
+    CHECK(after.dropped == before.dropped + 1);
+    CHECK(after.records == before.records + n);
+    CHECK(after.head_sector > before.head_sector);
+
+    // Everything staged reaches flash in order, from the partly used sector on.
+    static rec_t r[BIG_PER_SECTOR + 8];
+    int tag = 0;
+    uint32_t seq = before.head_seq;
+    for (uint32_t sector = before.head_sector; sector <= after.head_sector; sector++, seq++) {
+        int skip = sector == before.head_sector ? 6 : 0;
+        int want = sector == after.head_sector ? n - tag : skip + 1;
+        int got = wait_records(sector, seq, r, BIG_PER_SECTOR + 8, want);
+        CHECK(got >= want);
+        for (int i = skip; i < got; i++) {
+            CHECK(r[i].type == REC_CMD && r[i].len == BIG_PAYLOAD && r[i].data[0] == (uint8_t)tag);
+            tag++;
+        }
+    }
+    CHECK(tag == n);
+}
+
+static void test_hold_erase(void) {
+    recorder_info_t info;
+    recorder_hold_erase(true);
+    usleep(100000);     // let a refill erase in progress finish
+
+    // Fill whole sectors until the head stops moving: the pool is used up.
+    recorder_get_info(&info);
+    uint32_t start = info.head_sector, head = start;
+    for (int i = 0; i <= RECORDER_ERASE_AHEAD + 1; i++) {
+        for (int j = 0; j < BIG_PER_SECTOR; j++) {
+            write_big(0xA0);
+        }
+        usleep(50000);
+        recorder_get_info(&info);
+        if (info.head_sector == head) {
+            break;
+        }
+        head = info.head_sector;
+    }
+    CHECK(head > start && head - start <= RECORDER_ERASE_AHEAD);
+    CHECK(head < JUNK_LAST);
+    // The sector after the last pooled one was never erased, and records keep being dropped.
+    CHECK(first_byte(head + 1) == 0x00);
+    uint32_t dropped = info.dropped;
+    write_big(0xA1);
+    recorder_get_info(&info);
+    CHECK(info.dropped == dropped + 1 && info.head_sector == head);
+
+    // Released, the next sector is erased on demand and logging goes on.
+    recorder_hold_erase(false);
+    write_big(0xA2);
+    recorder_get_info(&info);
+    CHECK(info.head_sector == head + 1);
+    rec_t r[2];
+    CHECK(wait_records(head + 1, info.head_seq, r, 2, 1) == 1);
+    CHECK(r[0].len == BIG_PAYLOAD && r[0].data[0] == 0xA2);
+}
+
+int main(void) {
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, RECORDER_PARTITION_LABEL);
+    if (part == NULL) {
+        fprintf(stderr, "no recorder partition\n");
+        return 1;
+    }
+    // Sequence 0 is newer than 0xFFFFFFFF and 0xFFFFFFFE found later in the scan.
+    put_header(NEWEST, RECORDER_MAGIC, NEWEST_SEQ);
+    put_header(NEWEST + 40 + JUNK_LAST, RECORDER_MAGIC, 0xFFFFFFFFu);
+    put_header(NEWEST + 41 + JUNK_LAST, RECORDER_MAGIC, 0xFFFFFFFEu);
+    put_header(NEWEST + 42 + JUNK_LAST, 0x12345678, 5);             // not a log sector
+    // Stale log bytes in the sector to resume in, and junk past the pool.
+    put_header(NEWEST + 1, RECORDER_MAGIC, NEWEST_SEQ - 0x100);
+    for (uint32_t s = JUNK_FIRST; s <= JUNK_LAST; s++) {
+        fill_sector(s, 0x00);
+    }
+
+    if (recorder_init() != ESP_OK) {
+        fprintf(stderr, "recorder_init failed\n");
+        return 1;
+    }
+    test_resume();
+    test_partial_flush_then_continue();
+    test_drop_when_both_buffers_busy();
+    test_hold_erase();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("recorder: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,126 @@
+/* Host test of the sequence filter (src/seqfilter.c): stale and duplicate
+** drops, 16-bit sequence wraparound, the SEQ_FILTER_WINDOW edge and the
+** resync beyond it, independent clients and command types, and the RFC 3550
+** jitter update including a sender clock that wraps at 32 bits.
+**
+** Every case uses its own client address, so it starts from an empty stream
+** (a new client takes over the slot idle longest).
+*/
+
+#include <stdio.h>
+#include "seqfilter.h"
+#include "stats.h"
+
+static int failures;
+static uint32_t next_ip = 0x0A000001;
+static int64_t now_us = 1000000;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, __func__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// Frame of type with sequence seq, sent at sender clock t_us, arriving rx_delay_us after the last one.
+static seq_verdict_t frame(uint32_t ip, uint16_t port, rover_msg_type_t type, uint16_t seq, uint32_t t_us, int64_t rx_delay_us) {
+    rover_cmd_t cmd = {.type = type, .has_seq = true, .seq = seq, .t_us = t_us};
+    now_us += rx_delay_us;
+    return seq_filter_check(ip, port, &cmd, now_us);
+}
+
+static seq_verdict_t drive(uint32_t ip, uint16_t seq) {
+    return frame(ip, 5000, ROVER_MSG_DRIVE, seq, 0, 1000);
+}
+
+static void test_in_order_duplicate_stale(void) {
+    uint32_t ip = next_ip++;
+    CHECK(drive(ip, 10) == SEQ_ACCEPT);
+    CHECK(drive(ip, 11) == SEQ_ACCEPT);
+    CHECK(drive(ip, 11) == SEQ_DUPLICATE);
+    CHECK(drive(ip, 10) == SEQ_STALE);
+    CHECK(drive(ip, 15) == SEQ_ACCEPT);     // gaps are fine, newest wins
+    CHECK(drive(ip, 12) == SEQ_STALE);
+}
+
+static void test_wraparound(void) {
+    uint32_t ip = next_ip++;
+    CHECK(drive(ip, 65534) == SEQ_ACCEPT);
+    CHECK(drive(ip, 65535) == SEQ_ACCEPT);
+    CHECK(drive(ip, 0) == SEQ_ACCEPT);
+    CHECK(drive(ip, 1) == SEQ_ACCEPT);
+    CHECK(drive(ip, 65535) == SEQ_STALE);   // behind across the wrap
+    CHECK(drive(ip, 1) == SEQ_DUPLICATE);
+}
+
+static void test_window_edge(void) {
+    uint32_t ip = next_ip++;
+    CHECK(drive(ip, 1000) == SEQ_ACCEPT);
+    CHECK(drive(ip, 1000 - SEQ_FILTER_WINDOW) == SEQ_STALE);
+
+    uint32_t resyncs = stats_get(STATS_SEQ_RESYNC);
+    CHECK(drive(ip, 1000 - SEQ_FILTER_WINDOW - 1) == SEQ_ACCEPT);
+    CHECK(stats_get(STATS_SEQ_RESYNC) == resyncs + 1);
+
+    // The stream follows the restarted sender from there.
+    CHECK(drive(ip, 1000 - SEQ_FILTER_WINDOW) == SEQ_ACCEPT);
+    CHECK(drive(ip, 1000) == SEQ_ACCEPT);
+}
+
+static void test_streams_independent(void) {
+    uint32_t a = next_ip++, b = next_ip++;
+    CHECK(frame(a, 5000, ROVER_MSG_SERVO, 100, 0, 1000) == SEQ_ACCEPT);
+    // Same numbers from another type, another port and another address are not repeats.
+    CHECK(frame(a, 5000, ROVER_MSG_MOTOR, 100, 0, 1000) == SEQ_ACCEPT);
+    CHECK(frame(a, 5001, ROVER_MSG_SERVO, 100, 0, 1000) == SEQ_ACCEPT);
+    CHECK(frame(b, 5000, ROVER_MSG_SERVO, 100, 0, 1000) == SEQ_ACCEPT);
+    CHECK(frame(a, 5000, ROVER_MSG_SERVO, 99, 0, 1000) == SEQ_STALE);
+    CHECK(frame(a, 5000, ROVER_MSG_MOTOR, 100, 0, 1000) == SEQ_DUPLICATE);
+
+    // Unsequenced commands and unsequenced types always pass.
+    rover_cmd_t plain = {.type = ROVER_MSG_SERVO, .has_seq = false};
+    CHECK(seq_filter_check(a, 5000, &plain, now_us) == SEQ_ACCEPT);
+    rover_cmd_t query = {.type = ROVER_MSG_STATS_QUERY, .has_seq = true, .seq = 0};
+    CHECK(seq_filter_check(a, 5000, &query, now_us) == SEQ_ACCEPT);
+    CHECK(seq_filter_check(a, 5000, &query, now_us) == SEQ_ACCEPT);
+}
+
+static void test_jitter(void) {
+    uint32_t ip = next_ip++;
+    // Sender clock close to the 32-bit wrap, so transit times wrap too.
+    uint32_t t = 0xFFFFF000u;
+
+    CHECK(frame(ip, 5000, ROVER_MSG_DRIVE, 1, t, 1000) == SEQ_ACCEPT);
+    // Arrives 1600 us later than the sender spacing: |D| = 1600, J = 1600 / 16.
+    t += 10000;
+    CHECK(frame(ip, 5000, ROVER_MSG_DRIVE, 2, t, 11600) == SEQ_ACCEPT);
+    CHECK(seq_filter_jitter_us() == 100);
+    // On time: J += (0 - J) / 16, 100 -> 93.75.
+    t += 10000;
+    CHECK(frame(ip, 5000, ROVER_MSG_DRIVE, 3, t, 10000) == SEQ_ACCEPT);
+    CHECK(seq_filter_jitter_us() == 93);
+    CHECK(stats_get(STATS_JITTER_US) == 93);
+    // Early by the same amount counts the same as late.
+    t += 10000;
+    CHECK(frame(ip, 5000, ROVER_MSG_DRIVE, 4, t, 8400) == SEQ_ACCEPT);
+    CHECK(seq_filter_jitter_us() == 187);
+
+    // Dropped frames leave the estimate alone.
+    CHECK(frame(ip, 5000, ROVER_MSG_DRIVE, 4, t, 50000) == SEQ_DUPLICATE);
+    CHECK(seq_filter_jitter_us() == 187);
+}
+
+int main(void) {
+    test_in_order_duplicate_stale();
+    test_wraparound();
+    test_window_edge();
+    test_streams_independent();
+    test_jitter();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("seqfilter: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "driver/pulse_cnt.h"
+#include "esp_log.h"
+#include "encoder.h"
+
+static const char *TAG = "ENCODER";
+
+/* Encoder wiring in wheel order (FL, FR, ML, MR, RL, RR). No encoders are
+** fitted yet, so every wheel is GPIO_NUM_NC and encoder_init() reports an
+** empty mask. When they are, give the corner wheels the four PCNT units on
+** free GPIOs: not the strapping pins (0, 3, 45, 46), USB D-/D+ (19, 20),
+** the flash and PSRAM pins (26-32, and 33-37 on octal PSRAM modules), the
+** console UART (43, 44), or the pins the L298N boards (l298n.c) and the I2C
+** bus (pca9685.h) already use. The right-hand motors are mounted mirrored,
+** so their encoders count backwards.
+*/
+static const encoder_pins_t pin_table[ENCODER_NUM_WHEELS] = {
+    {.pin_a = GPIO_NUM_NC, .pin_b = GPIO_NUM_NC},
+    {.pin_a = GPIO_NUM_NC, .pin_b = GPIO_NUM_NC, .invert = true},
+    {.pin_a = GPIO_NUM_NC, .pin_b = GPIO_NUM_NC},
+    {.pin_a = GPIO_NUM_NC, .pin_b = GPIO_NUM_NC, .invert = true},
+    {.pin_a = GPIO_NUM_NC, .pin_b = GPIO_NUM_NC},
+    {.pin_a = GPIO_NUM_NC, .pin_b = GPIO_NUM_NC, .invert = true},
+};
+
+static pcnt_unit_handle_t units[ENCODER_NUM_WHEELS];
+
+/* One encoder on one unit: channel 0 counts A edges gated by B, channel 1 B
+** edges gated by A. On failure everything created so far is released and
+** the error returned, so the caller can leave that wheel out.
+*/
+static esp_err_t setup_unit(const encoder_pins_t *pins, pcnt_unit_handle_t *out) {
+    pcnt_unit_config_t unit_config = {
+        .low_limit = -ENCODER_PCNT_LIMIT,
+        .high_limit = ENCODER_PCNT_LIMIT,
+        .flags.accum_count = true,
+    };
+    pcnt_unit_handle_t unit;
+    esp_err_t ret = pcnt_new_unit(&unit_config, &unit);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    pcnt_glitch_filter_config_t filter = {.max_glitch_ns = ENCODER_GLITCH_NS};
+    pcnt_chan_config_t chan_a_config = {.edge_gpio_num = pins->pin_a, .level_gpio_num = pins->pin_b};
+    pcnt_chan_config_t chan_b_config = {.edge_gpio_num = pins->pin_b, .level_gpio_num = pins->pin_a};
+    pcnt_channel_handle_t chan_a = NULL, chan_b = NULL;
+    bool enabled = false;
+
+    ret = pcnt_unit_set_glitch_filter(unit, &filter);
+    if (ret == ESP_OK) {
+        ret = pcnt_new_channel(unit, &chan_a_config, &chan_a);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_new_channel(unit, &chan_b_config, &chan_b);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_channel_set_edge_action(chan_a, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_channel_set_level_action(chan_a, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_channel_set_edge_action(chan_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_channel_set_level_action(chan_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+    }
+    // Watch points at the limits are what let the driver carry overflows into the total.
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_add_watch_point(unit, ENCODER_PCNT_LIMIT);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_add_watch_point(unit, -ENCODER_PCNT_LIMIT);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_enable(unit);
+        enabled = ret == ESP_OK;
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_clear_count(unit);
+    }
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_start(unit);
+    }
+
+    if (ret != ESP_OK) {
+        if (enabled) {
+            pcnt_unit_disable(unit);
+        }
+        if (chan_b) {
+            pcnt_del_channel(chan_b);
+        }
+        if (chan_a) {
+            pcnt_del_channel(chan_a);
+        }
+        pcnt_del_unit(unit);
+        return ret;
+    }
+    *out = unit;
+    return ESP_OK;
+}
+
+// A wheel whose unit cannot be set up is left out of the mask; the others still count.
+esp_err_t encoder_init(uint8_t *mask) {
+    *mask = 0;
+    for (int w = 0; w < ENCODER_NUM_WHEELS; w++) {
+        if (pin_table[w].pin_a == GPIO_NUM_NC) {
+            continue;
+        }
+        esp_err_t ret = setup_unit(&pin_table[w], &units[w]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Wheel %d: no PCNT unit (%s), running it without an encoder", w, esp_err_to_name(ret));
+            units[w] = NULL;
+            continue;
+        }
+        *mask |= 1u << w;
+    }
+    ESP_LOGI(TAG, "Encoders on wheel mask 0x%02x", *mask);
+    return ESP_OK;
+}
+
+void encoder_read(int32_t counts[ENCODER_NUM_WHEELS]) {
+    for (int w = 0; w < ENCODER_NUM_WHEELS; w++) {
+        int value = 0;
+        if (units[w] != NULL) {
+            pcnt_unit_get_count(units[w], &value);
+        }
+        counts[w] = pin_table[w].invert ? -value : value;
+    }
+}
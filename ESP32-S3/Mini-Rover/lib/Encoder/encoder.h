@@ -0,0 +1,43 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+/*
+** Quadrature wheel encoders on the PCNT peripheral.
+**
+** Both channels of a PCNT unit decode one encoder in x4 mode, so counting
+** costs no CPU at all; the only interrupt is the unit's overflow at
+** +-ENCODER_PCNT_LIMIT, which the driver folds into a 32-bit total
+** (accum_count). A glitch filter drops pulses shorter than
+** ENCODER_GLITCH_NS.
+**
+** The ESP32-S3 has four PCNT units, so four of the six wheels can carry an
+** encoder; the pin table in encoder.c gives the others GPIO_NUM_NC (for
+** now all of them, until encoders are fitted).
+*/
+
+#define ENCODER_NUM_WHEELS 6        // wheel order as the motor boards (see l298n.h)
+#define ENCODER_PCNT_LIMIT 30000    // within the 16-bit hardware counter
+
+#ifndef ENCODER_GLITCH_NS
+#define ENCODER_GLITCH_NS 1000
+#endif
+
+typedef struct {
+    gpio_num_t pin_a;
+    gpio_num_t pin_b;
+    bool invert;                    // mounted mirrored: count backwards when driving forwards
+} encoder_pins_t;
+
+// Set up a unit for every wheel with pins. *mask gets one bit per wheel that counts;
+// a wheel whose unit fails is logged and left out rather than failing the rest.
+esp_err_t encoder_init(uint8_t *mask);
+
+// Accumulated counts since encoder_init(); wheels without an encoder read 0.
+void encoder_read(int32_t counts[ENCODER_NUM_WHEELS]);
+
+#endif
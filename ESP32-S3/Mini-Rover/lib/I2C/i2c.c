@@ -1,18 +1,14 @@
-#include "driver/i2c.h"
+#include "i2c_bus.h"
 #include "esp_log.h"
 
 static const char *TAG = "I2C_SCAN";
 
+// Probe every 7-bit address through the bus engine. i2c_master_init() must have run.
 void i2c_scan() {
     ESP_LOGI(TAG, "Starting I2C scan...");
 
     for (uint8_t addr = 1; addr < 127; addr++) {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_stop(cmd);
-        esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
+        esp_err_t ret = i2c_bus_probe(addr);
 
         if (ret == ESP_OK) {
             ESP_LOGI(TAG, "Found I2C device at address 0x%02X", addr);
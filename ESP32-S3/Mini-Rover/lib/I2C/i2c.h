@@ -1,11 +1,7 @@
 #ifndef I2CSCAN_H
 #define I2CSCAN_H
 
-#define I2C_MASTER_SCL_IO 17
-#define I2C_MASTER_SDA_IO 18
-#define I2C_MASTER_NUM I2C_NUM_0
-#define I2C_FREQ 100000
-
+// Bus pins and port are defined in pca9685.h; the bus must be up (i2c_master_init()) before scanning.
 void i2c_scan();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "i2c_bus.h"
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+static const char *TAG = "I2C_BUS";
+
+typedef enum {
+    OP_WRITE,
+    OP_READ,
+    OP_PROBE,
+    OP_SET_SPEED,
+    OP_SYNC,
+    OP_NOTIFY,
+} i2c_bus_op_t;
+
+// Queue item. Write data travels inside the item, so callers keep no buffers alive.
+typedef struct {
+    uint8_t op;
+    i2c_bus_dev_t dev;
+    uint8_t reg;
+    uint8_t len;
+    uint8_t data[I2C_BUS_MAX_DATA];
+    uint8_t *rx;            // OP_READ destination
+    uint32_t value;         // OP_SET_SPEED rate, OP_PROBE address
+    i2c_bus_cb_t cb;
+    void *cb_arg;
+    esp_err_t *result;      // set for synchronous ops
+} i2c_bus_txn_t;
+
+typedef struct {
+    uint8_t addr;
+    uint32_t scl_hz;
+    i2c_master_dev_handle_t handle;
+} i2c_bus_device_t;
+
+static i2c_master_bus_handle_t bus;
+static i2c_bus_device_t devices[I2C_BUS_MAX_DEVICES];
+static uint8_t num_devices = 0;
+
+static QueueHandle_t queue;
+static SemaphoreHandle_t sync_lock;     // one synchronous caller at a time
+static SemaphoreHandle_t sync_done;     // given by the engine when that caller's op completes
+
+// Counters written by submitters on any core.
+static atomic_uint submitted, queue_full, max_depth;
+// Counters written only by the engine task.
+static i2c_bus_stats_t engine_stats;
+
+static esp_err_t add_handle(i2c_bus_device_t *d) {
+    i2c_device_config_t cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = d->addr,
+        .scl_speed_hz = d->scl_hz,
+    };
+    return i2c_master_bus_add_device(bus, &cfg, &d->handle);
+}
+
+static int can_merge(const i2c_bus_txn_t *t, const i2c_bus_txn_t *n) {
+    if (n->op != OP_WRITE || n->dev != t->dev || n->result != NULL || t->result != NULL) {
+        return 0;
+    }
+    int lo = n->reg < t->reg ? n->reg : t->reg;
+    int hi = (n->reg + n->len) > (t->reg + t->len) ? (n->reg + n->len) : (t->reg + t->len);
+    // Ranges must touch or overlap; a gap would need register values we do not have.
+    return n->reg <= t->reg + t->len && n->reg + n->len >= t->reg && hi - lo <= I2C_BUS_MAX_DATA;
+}
+
+// Fold write n into t. The merged range covers both and n's bytes win where they overlap.
+static void merge(i2c_bus_txn_t *t, const i2c_bus_txn_t *n) {
+    if (n->reg < t->reg) {
+        int shift = t->reg - n->reg;
+        memmove(&t->data[shift], t->data, t->len);
+        t->len += shift;
+        t->reg = n->reg;
+    }
+    int end = n->reg + n->len - t->reg;
+    if (end > t->len) {
+        t->len = end;
+    }
+    memcpy(&t->data[n->reg - t->reg], n->data, n->len);
+}
+
+static esp_err_t execute(i2c_bus_txn_t *t) {
+    i2c_bus_device_t *d = &devices[t->dev];
+    uint8_t buf[1 + I2C_BUS_MAX_DATA];
+    esp_err_t ret;
+
+    switch (t->op) {
+        case OP_WRITE:
+            buf[0] = t->reg;
+            memcpy(&buf[1], t->data, t->len);
+            ret = i2c_master_transmit(d->handle, buf, 1 + t->len, I2C_BUS_XFER_TIMEOUT_MS);
+            break;
+        case OP_READ:
+            ret = i2c_master_transmit_receive(d->handle, &t->reg, 1, t->rx, t->len, I2C_BUS_XFER_TIMEOUT_MS);
+            break;
+        case OP_PROBE:
+            return i2c_master_probe(bus, t->value, I2C_BUS_PROBE_TIMEOUT_MS);
+        case OP_SET_SPEED: {
+            // The driver fixes the rate when a device is added, so re-add it.
+            i2c_master_bus_rm_device(d->handle);
+            uint32_t old = d->scl_hz;
+            d->scl_hz = t->value;
+            ret = add_handle(d);
+            if (ret != ESP_OK) {
+                d->scl_hz = old;
+                add_handle(d);
+            }
+            return ret;
+        }
+        default:
+            return ESP_OK;
+    }
+
+    engine_stats.transfers++;
+    if (ret != ESP_OK) {
+        engine_stats.errors++;
+    }
+    return ret;
+}
+
+static void i2c_bus_task(void *arg) {
+    i2c_bus_txn_t t, next;
+    i2c_bus_cb_t cbs[I2C_BUS_MAX_MERGE];
+    void *cb_args[I2C_BUS_MAX_MERGE];
+
+    while (1) {
+        xQueueReceive(queue, &t, portMAX_DELAY);
+
+        int ncb = 0;
+        if (t.cb) {
+            cbs[ncb] = t.cb;
+            cb_args[ncb++] = t.cb_arg;
+        }
+        // Fold in queued writes that continue or overwrite this one.
+        if (t.op == OP_WRITE) {
+            while (ncb < I2C_BUS_MAX_MERGE && xQueuePeek(queue, &next, 0) == pdTRUE && can_merge(&t, &next)) {
+                xQueueReceive(queue, &next, 0);
+                merge(&t, &next);
+                engine_stats.merged++;
+                if (next.cb) {
+                    cbs[ncb] = next.cb;
+                    cb_args[ncb++] = next.cb_arg;
+                }
+            }
+        }
+
+        esp_err_t ret = execute(&t);
+
+        for (int i = 0; i < ncb; i++) {
+            cbs[i](ret, cb_args[i]);
+        }
+        if (t.result) {
+            *t.result = ret;
+            xSemaphoreGive(sync_done);
+        }
+    }// end while
+}
+
+esp_err_t i2c_bus_init(i2c_port_num_t port, int sda_io, int scl_io) {
+    i2c_master_bus_config_t cfg = {
+        .i2c_port = port,
+        .sda_io_num = sda_io,
+        .scl_io_num = scl_io,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t ret = i2c_new_master_bus(&cfg, &bus);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create I2C bus: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    queue = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(i2c_bus_txn_t));
+    sync_lock = xSemaphoreCreateMutex();
+    sync_done = xSemaphoreCreateBinary();
+    if (queue == NULL || sync_lock == NULL || sync_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(i2c_bus_task, "i2c_bus", I2C_BUS_TASK_STACK, NULL, I2C_BUS_TASK_PRIORITY, NULL, I2C_BUS_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void note_depth() {
+    unsigned depth = I2C_BUS_QUEUE_LEN - uxQueueSpacesAvailable(queue);
+    unsigned seen = atomic_load_explicit(&max_depth, memory_order_relaxed);
+    while (depth > seen && !atomic_compare_exchange_weak_explicit(&max_depth, &seen, depth, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Queue t and wait for the engine to run it.
+static esp_err_t submit_sync(i2c_bus_txn_t *t) {
+    if (queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t result = ESP_FAIL;
+    t->result = &result;
+
+    xSemaphoreTake(sync_lock, portMAX_DELAY);
+    xQueueSend(queue, t, portMAX_DELAY);
+    atomic_fetch_add_explicit(&submitted, 1, memory_order_relaxed);
+    note_depth();
+    xSemaphoreTake(sync_done, portMAX_DELAY);
+    xSemaphoreGive(sync_lock);
+    return result;
+}
+
+esp_err_t i2c_bus_add_device(uint8_t addr, uint32_t scl_hz, i2c_bus_dev_t *out) {
+    if (bus == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (int i = 0; i < num_devices; i++) {
+        if (devices[i].addr == addr) {
+            *out = i;
+            return ESP_OK;
+        }
+    }
+    if (num_devices == I2C_BUS_MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    i2c_bus_device_t *d = &devices[num_devices];
+    d->addr = addr;
+    d->scl_hz = scl_hz;
+    esp_err_t ret = add_handle(d);
+    if (ret == ESP_OK) {
+        *out = num_devices++;
+    }
+    return ret;
+}
+
+esp_err_t i2c_bus_set_speed(i2c_bus_dev_t dev, uint32_t scl_hz) {
+    if (dev >= num_devices || scl_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_bus_txn_t t = {.op = OP_SET_SPEED, .dev = dev, .value = scl_hz};
+    return submit_sync(&t);
+}
+
+uint32_t i2c_bus_get_speed(i2c_bus_dev_t dev) {
+    return dev < num_devices ? devices[dev].scl_hz : 0;
+}
+
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t dev, uint8_t reg, const uint8_t *data, size_t len, i2c_bus_cb_t cb, void *arg) {
+    if (dev >= num_devices || len == 0 || len > I2C_BUS_MAX_DATA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    i2c_bus_txn_t t = {.op = OP_WRITE, .dev = dev, .reg = reg, .len = len, .cb = cb, .cb_arg = arg};
+    memcpy(t.data, data, len);
+
+    if (xQueueSend(queue, &t, 0) != pdTRUE) {
+        atomic_fetch_add_explicit(&queue_full, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+    atomic_fetch_add_explicit(&submitted, 1, memory_order_relaxed);
+    note_depth();
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_notify(i2c_bus_cb_t cb, void *arg) {
+    if (queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    i2c_bus_txn_t t = {.op = OP_NOTIFY, .cb = cb, .cb_arg = arg};
+    if (xQueueSend(queue, &t, 0) != pdTRUE) {
+        atomic_fetch_add_explicit(&queue_full, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+    note_depth();
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_write(i2c_bus_dev_t dev, uint8_t reg, const uint8_t *data, size_t len) {
+    if (dev >= num_devices || len == 0 || len > I2C_BUS_MAX_DATA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_bus_txn_t t = {.op = OP_WRITE, .dev = dev, .reg = reg, .len = len};
+    memcpy(t.data, data, len);
+    return submit_sync(&t);
+}
+
+esp_err_t i2c_bus_read(i2c_bus_dev_t dev, uint8_t reg, uint8_t *data, size_t len) {
+    if (dev >= num_devices || len == 0 || len > 255) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_bus_txn_t t = {.op = OP_READ, .dev = dev, .reg = reg, .len = len, .rx = data};
+    return submit_sync(&t);
+}
+
+esp_err_t i2c_bus_probe(uint8_t addr) {
+    i2c_bus_txn_t t = {.op = OP_PROBE, .value = addr};
+    return submit_sync(&t);
+}
+
+esp_err_t i2c_bus_sync() {
+    i2c_bus_txn_t t = {.op = OP_SYNC};
+    return submit_sync(&t);
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *out) {
+    *out = engine_stats;
+    out->submitted = atomic_load_explicit(&submitted, memory_order_relaxed);
+    out->queue_full = atomic_load_explicit(&queue_full, memory_order_relaxed);
+    out->max_depth = atomic_load_explicit(&max_depth, memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "driver/i2c_master.h"
+
+/*
+** Queued I2C transaction engine.
+**
+** One task owns the bus (new i2c_master bus/device driver) and executes
+** transactions taken from a bounded queue. Register writes can be submitted
+** asynchronously: the caller copies the data into the queue and returns at
+** once, and an optional callback reports the result from the engine task.
+** Reads, probes and speed changes are synchronous.
+**
+** Consecutive queued writes to the same device whose register ranges touch
+** or overlap are merged into one auto-incremented transfer, later data
+** winning. That suits plain storage registers like the PCA9685 LEDn blocks;
+** writes whose intermediate value matters (e.g. MODE1 sleep/wake sequences)
+** must use the synchronous i2c_bus_write().
+*/
+
+#ifndef I2C_BUS_QUEUE_LEN
+#define I2C_BUS_QUEUE_LEN 16
+#endif
+
+#define I2C_BUS_MAX_DATA        64      // largest single register write (16 PCA9685 LEDn blocks)
+#define I2C_BUS_MAX_DEVICES     12      // up to PCA9685_MAX_DEVICES boards plus spares
+#define I2C_BUS_MAX_MERGE       8       // queued writes folded into one transfer
+#define I2C_BUS_XFER_TIMEOUT_MS 20
+#define I2C_BUS_PROBE_TIMEOUT_MS 2      // an address byte takes ~0.1 ms even at 100 kHz; only a stuck bus hits this
+
+#define I2C_BUS_TASK_STACK      3072
+#define I2C_BUS_TASK_PRIORITY   7       // above the control task so queued writes go out promptly
+#define I2C_BUS_TASK_CORE       1
+
+// Standard, fast and fast-mode plus SCL rates.
+#define I2C_BUS_FREQ_STD        100000
+#define I2C_BUS_FREQ_FAST       400000
+#define I2C_BUS_FREQ_FAST_PLUS  1000000
+
+typedef uint8_t i2c_bus_dev_t;
+
+// Completion callback for asynchronous writes; runs in the engine task and must not block.
+typedef void (*i2c_bus_cb_t)(esp_err_t err, void *arg);
+
+typedef struct {
+    uint32_t submitted;     // transactions accepted into the queue
+    uint32_t transfers;     // transfers actually put on the bus
+    uint32_t merged;        // queued writes folded into an earlier transfer
+    uint32_t errors;        // transfers that failed on the bus
+    uint32_t queue_full;    // async writes rejected because the queue was full
+    uint32_t max_depth;     // highest queue depth seen at submit time
+} i2c_bus_stats_t;
+
+esp_err_t i2c_bus_init(i2c_port_num_t port, int sda_io, int scl_io);
+
+// Register a device (or look up an existing one with the same address) at the given SCL rate.
+esp_err_t i2c_bus_add_device(uint8_t addr, uint32_t scl_hz, i2c_bus_dev_t *out);
+esp_err_t i2c_bus_set_speed(i2c_bus_dev_t dev, uint32_t scl_hz);
+uint32_t i2c_bus_get_speed(i2c_bus_dev_t dev);
+
+// Queue a write of len bytes starting at reg. Returns ESP_ERR_NO_MEM at once if the queue is full.
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t dev, uint8_t reg, const uint8_t *data, size_t len, i2c_bus_cb_t cb, void *arg);
+
+/* Queue a marker that puts nothing on the bus: cb runs from the engine once
+** every transaction queued before it has completed (ESP_OK, whatever they
+** returned). Returns ESP_ERR_NO_MEM at once if the queue is full.
+*/
+esp_err_t i2c_bus_notify(i2c_bus_cb_t cb, void *arg);
+
+// Blocking forms; they wait behind anything already queued.
+esp_err_t i2c_bus_write(i2c_bus_dev_t dev, uint8_t reg, const uint8_t *data, size_t len);
+esp_err_t i2c_bus_read(i2c_bus_dev_t dev, uint8_t reg, uint8_t *data, size_t len);
+esp_err_t i2c_bus_probe(uint8_t addr);
+
+// Block until every transaction queued so far has completed.
+esp_err_t i2c_bus_sync();
+
+void i2c_bus_get_stats(i2c_bus_stats_t *out);
+
+#endif
@@ -1,21 +1,113 @@
 #include <stdio.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "l298n.h"
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "esp_rom_gpio.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "trace.h"
 
 static const char *TAG = "L298N";
 
-// Use LEDC timer 0 in high-speed mode with 8-bit resolution (0–255 duty)
+// Use LEDC timer 0 in low-speed mode; rate and resolution come from l298n.h.
 #define LEDC_TIMER              LEDC_TIMER_0
 #define LEDC_MODE               LEDC_LOW_SPEED_MODE
-#define LEDC_DUTY_RES           LEDC_TIMER_8_BIT  
-#define LEDC_FREQUENCY          5000              // 5 kHz
+#define LEDC_DUTY_RES           ((ledc_timer_bit_t)L298N_PWM_RES_BITS)
+#define LEDC_FREQUENCY          L298N_PWM_FREQ_HZ
 #define gpio_pad_select_gpio esp_rom_gpio_pad_select_gpio
 
+static l298n_stats_t stats = {0};
+
+#if L298N_RAMP_MS > 0
+// Channels with a hardware fade in progress, one bit per LEDC channel.
+static atomic_uint fading;
+static atomic_uint fades_done;
+
+// Fade-end interrupt: the channel is free for its next fade.
+static bool IRAM_ATTR fade_end_isr(const ledc_cb_param_t *param, void *arg) {
+    if (param->event == LEDC_FADE_END_EVT) {
+        atomic_fetch_and(&fading, ~(1u << param->channel));
+        atomic_fetch_add(&fades_done, 1);
+    }
+    return false;
+}
+#endif
+
+// Speed (0..L298N_MAX_DUTY) to LEDC duty counts.
+static uint32_t speed_to_duty(int16_t speed) {
+    if (speed <= 0) {
+        return 0;
+    }
+    return ((uint32_t)speed * L298N_PWM_MAX + L298N_MAX_DUTY / 2) / L298N_MAX_DUTY;
+}
+
+/* Load a new duty on a channel without latching it. In ramp mode this sets
+** up a fade from wherever the channel is now, lasting in proportion to the
+** distance; a fade still running is stopped first, since the driver would
+** otherwise block until it ended.
+*/
+static esp_err_t load_duty(int channel, int16_t speed) {
+    uint32_t duty = speed_to_duty(speed);
+#if L298N_RAMP_MS > 0
+    uint32_t bit = 1u << channel;
+    if (atomic_load(&fading) & bit) {
+        ledc_fade_stop(LEDC_MODE, channel);
+        atomic_fetch_and(&fading, ~bit);
+        stats.fades_cut++;
+    }
+    uint32_t now = ledc_get_duty(LEDC_MODE, channel);
+    uint32_t delta = duty > now ? duty - now : now - duty;
+    int ms = (delta * L298N_RAMP_MS + L298N_PWM_MAX - 1) / L298N_PWM_MAX;
+    return ledc_set_fade_with_time(LEDC_MODE, channel, duty, ms > 0 ? ms : 1);
+#else
+    return ledc_set_duty(LEDC_MODE, channel, duty);
+#endif
+}
+
+// Make a loaded duty take effect: latch it, or start its fade.
+static esp_err_t latch_duty(int channel) {
+#if L298N_RAMP_MS > 0
+    uint32_t bit = 1u << channel;
+    atomic_fetch_or(&fading, bit);
+    esp_err_t ret = ledc_fade_start(LEDC_MODE, channel, LEDC_FADE_NO_WAIT);
+    if (ret == ESP_OK) {
+        stats.fades_started++;
+    } else {
+        atomic_fetch_and(&fading, ~bit);
+    }
+    return ret;
+#else
+    return ledc_update_duty(LEDC_MODE, channel);
+#endif
+}
+
+/* Ramp mode only: drop a motor whose direction is about to change to zero
+** duty at once, and mark its duty dirty so it fades up again from there.
+** Flipping the bridge at speed and fading down afterwards would drive the
+** motor hard against its own rotation.
+*/
+static void cut_duty(l298n_t *dev, int motor) {
+#if L298N_RAMP_MS > 0
+    int channel = motor == 0 ? dev->enA_channel : dev->enB_channel;
+    uint32_t bit = 1u << channel;
+    if (atomic_load(&fading) & bit) {
+        ledc_fade_stop(LEDC_MODE, channel);
+        atomic_fetch_and(&fading, ~bit);
+        stats.fades_cut++;
+    }
+    if (ledc_get_duty(LEDC_MODE, channel) != 0) {
+        ledc_set_duty(LEDC_MODE, channel, 0);
+        ledc_update_duty(LEDC_MODE, channel);
+    }
+    dev->dirty |= L298N_DIRTY_DUTY(motor);
+#endif
+}
+
 // Helper function to configure one LEDC channel for a given pin
 static esp_err_t setup_ledc_channel(int channel, gpio_num_t gpio_pin) {
     ledc_channel_config_t ledc_channel = {
@@ -71,6 +163,25 @@ esp_err_t l298n_init(l298n_t *dev){
     ESP_ERROR_CHECK(setup_ledc_channel(dev->enA_channel, dev->enA_pin));
     ESP_ERROR_CHECK(setup_ledc_channel(dev->enB_channel, dev->enB_pin));
 
+#if L298N_RAMP_MS > 0
+    // Fade service (once for all boards) and its end-of-fade interrupt per channel.
+    static bool fade_installed = false;
+    if (!fade_installed) {
+        ESP_ERROR_CHECK(ledc_fade_func_install(0));
+        fade_installed = true;
+    }
+    ledc_cbs_t cbs = {.fade_cb = fade_end_isr};
+    ESP_ERROR_CHECK(ledc_cb_register(LEDC_MODE, dev->enA_channel, &cbs, NULL));
+    ESP_ERROR_CHECK(ledc_cb_register(LEDC_MODE, dev->enB_channel, &cbs, NULL));
+#endif
+
+    // Pin levels are unknown until the first flush, so make sure it writes everything.
+    for (int motor = 0; motor < 2; motor++) {
+        dev->shadow_dir[motor] = -1;
+        dev->shadow_duty[motor] = -1;
+    }
+    dev->dirty = 0;
+
     // Initialize motors to a stopped state
     //l298n_set_motor(dev, 0, MOTOR_STOP, 0);
     //l298n_set_motor(dev, 1, MOTOR_STOP, 0);
@@ -79,147 +190,257 @@ esp_err_t l298n_init(l298n_t *dev){
     return ESP_OK;
 }
 
-void init_motor_controllers(l298n_t *b1, l298n_t *b2, l298n_t *b3){
-    // Create three L298N board instances with your chosen pin assignments.
-    // Adjust the pin numbers and LEDC channel assignments as needed.
+/* Wiring of every motor board, in wheel order. Adding a board is one more
+** entry here (and a bump of L298N_NUM_BOARDS); nothing else hardcodes pins.
+*/
+static const l298n_t board_table[L298N_NUM_BOARDS] = {
+    {   // Board 1
+        .in1_pinA = GPIO_NUM_4,  .in2_pinA = GPIO_NUM_5,  .enA_pin = GPIO_NUM_6,  .enA_channel = 0,
+        .in1_pinB = GPIO_NUM_7,  .in2_pinB = GPIO_NUM_15, .enB_pin = GPIO_NUM_16, .enB_channel = 1,
+    },
+    {   // Board 2
+        .in1_pinA = GPIO_NUM_9,  .in2_pinA = GPIO_NUM_10, .enA_pin = GPIO_NUM_11, .enA_channel = 2,
+        .in1_pinB = GPIO_NUM_12, .in2_pinB = GPIO_NUM_13, .enB_pin = GPIO_NUM_14, .enB_channel = 3,
+    },
+    {   // Board 3
+        .in1_pinA = GPIO_NUM_1,  .in2_pinA = GPIO_NUM_2,  .enA_pin = GPIO_NUM_42, .enA_channel = 4,
+        .in1_pinB = GPIO_NUM_41, .in2_pinB = GPIO_NUM_40, .enB_pin = GPIO_NUM_39, .enB_channel = 5,
+    },
+};
 
-    // Initialize Board 1 for two motors
-    *b1 = (l298n_t){
-        .in1_pinA = GPIO_NUM_4,
-        .in2_pinA = GPIO_NUM_5,
-        .enA_pin    = GPIO_NUM_6,
-        .enA_channel= 0,  // LEDC channel 0
+void init_motor_controllers(l298n_t boards[L298N_NUM_BOARDS]){
+    ESP_LOGI(TAG, "Initializing motor boards...");
+    for (int b = 0; b < L298N_NUM_BOARDS; b++) {
+        boards[b] = board_table[b];
+        l298n_init(&boards[b]);
+    }
+    ESP_LOGI(TAG, "Motor boards initialized.");
+}
 
-        .in1_pinB = GPIO_NUM_7,
-        .in2_pinB = GPIO_NUM_15,
-        .enB_pin    = GPIO_NUM_16,
-        .enB_channel= 1,  // LEDC channel 1
-    };
+/* Record the requested direction and speed in the board's shadow state and
+** mark only what changed as dirty. Nothing touches the hardware until
+** l298n_flush().
+*/
+esp_err_t l298n_stage_motor(l298n_t *dev, int motor, motorDirection_t direction, int16_t speed){
+    if (dev == NULL || (motor != 0 && motor != 1)) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    // Initialize Board 2 for two motors
-    *b2 = (l298n_t){
-        .in1_pinA = GPIO_NUM_9,
-        .in2_pinA = GPIO_NUM_10,
-        .enA_pin    = GPIO_NUM_11,
-        .enA_channel= 2,  // LEDC channel 2
-
-        .in1_pinB = GPIO_NUM_12,
-        .in2_pinB = GPIO_NUM_13,
-        .enB_pin    = GPIO_NUM_14,
-        .enB_channel= 3,  // LEDC channel 3
-    };
+    // Clamp speed to 0..L298N_MAX_DUTY; it is scaled to the PWM resolution on flush.
+    if (speed > L298N_MAX_DUTY) {
+        speed = L298N_MAX_DUTY;
+    } else if (speed < 0) {
+        speed = 0;
+    }
 
-    // Initialize Board 3 for two motors
-    *b3 = (l298n_t){
-        .in1_pinA = GPIO_NUM_1,
-        .in2_pinA = GPIO_NUM_2,
-        .enA_pin    = GPIO_NUM_42,
-        .enA_channel= 4,  // LEDC channel 4
-
-        .in1_pinB = GPIO_NUM_41,
-        .in2_pinB = GPIO_NUM_40,
-        .enB_pin    = GPIO_NUM_39,
-        .enB_channel= 5,  // LEDC channel 5
-    };
+    if (dev->shadow_dir[motor] != (int8_t)direction) {
+        dev->shadow_dir[motor] = direction;
+        dev->dirty |= L298N_DIRTY_DIR(motor);
+    } else {
+        stats.dir_writes_elided++;
+    }
 
-    // Initialize each L298N board.
-    ESP_LOGI(TAG, "Initializing motor boards...");
-    l298n_init(b1);
-    l298n_init(b2);
-    l298n_init(b3);
-    ESP_LOGI(TAG, "Motor boards initialized.");
+    if (dev->shadow_duty[motor] != speed) {
+        dev->shadow_duty[motor] = speed;
+        dev->dirty |= L298N_DIRTY_DUTY(motor);
+    } else {
+        stats.duty_writes_elided++;
+    }
+    return ESP_OK;
 }
 
+// Apply every dirty direction and duty on the board in one pass.
+esp_err_t l298n_flush(l298n_t *dev){
+    if (dev == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    for (int motor = 0; motor < 2 && dev->dirty; motor++) {
+        gpio_num_t in1_pin = motor == 0 ? dev->in1_pinA : dev->in1_pinB;
+        gpio_num_t in2_pin = motor == 0 ? dev->in2_pinA : dev->in2_pinB;
+        int en_channel = motor == 0 ? dev->enA_channel : dev->enB_channel;
+
+        // Set the motor direction pins according to desired direction.
+        if (dev->dirty & L298N_DIRTY_DIR(motor)) {
+            cut_duty(dev, motor);
+            switch(dev->shadow_dir[motor]) {
+                case MOTOR_FORWARD:
+                    gpio_set_level(in1_pin, 1);
+                    gpio_set_level(in2_pin, 0);
+                    break;
+                case MOTOR_REVERSE:
+                    gpio_set_level(in1_pin, 0);
+                    gpio_set_level(in2_pin, 1);
+                    break;
+                case MOTOR_BRAKE:
+                    gpio_set_level(in1_pin, 1);
+                    gpio_set_level(in2_pin, 1);
+                    break;
+                case MOTOR_STOP:
+                default:
+                    gpio_set_level(in1_pin, 0);
+                    gpio_set_level(in2_pin, 0);
+                    break;
+            }
+            dev->dirty &= ~L298N_DIRTY_DIR(motor);
+            stats.dir_writes_issued++;
+            TRACE(TRACE_EV_MOTOR_DIR, en_channel, dev->shadow_dir[motor], 0);
+        }
+
+        // Set PWM duty (speed) for the given enable channel.
+        if (dev->dirty & L298N_DIRTY_DUTY(motor)) {
+            int16_t speed = dev->shadow_duty[motor];
+            esp_err_t ret = load_duty(en_channel, speed);
+            if (ret == ESP_OK) {
+                ret = latch_duty(en_channel);
+            }
+            if (ret == ESP_OK) {
+                dev->dirty &= ~L298N_DIRTY_DUTY(motor);
+                stats.duty_writes_issued++;
+                TRACE(TRACE_EV_MOTOR_DUTY, en_channel, speed, 0);
+            } else {
+                // Stays dirty so the next flush retries it.
+                TRACE(TRACE_EV_LEDC_ERROR, en_channel, ret, 0);
+                err = ret;
+            }
+        }
+    }
+    return err;
+}
 
 esp_err_t l298n_set_motor(l298n_t *dev, int motor, motorDirection_t direction, int16_t speed){
-    if (dev == NULL || (motor != 0 && motor != 1)) {
-        return ESP_ERR_INVALID_ARG;
+    esp_err_t err = l298n_stage_motor(dev, motor, direction, speed);
+    if (err == ESP_OK) {
+        err = l298n_flush(dev);
     }
+    return err;
+}
 
-    // Select pins and LEDC channel for the specified motor.
-    gpio_num_t in1_pin, in2_pin;
-    int en_channel;
-    if (motor == 0) {
-        in1_pin = dev->in1_pinA;
-        in2_pin = dev->in2_pinA;
-        en_channel = dev->enA_channel;
+// IN1/IN2 levels for each direction.
+static const uint8_t dir_levels[][2] = {
+    [MOTOR_STOP]    = {0, 0},
+    [MOTOR_FORWARD] = {1, 0},
+    [MOTOR_REVERSE] = {0, 1},
+    [MOTOR_BRAKE]   = {1, 1},
+};
+
+// Add a pin to the set or clear mask of its GPIO bank (0: GPIO0-31, 1: GPIO32-48).
+static void mask_pin(uint32_t set[2], uint32_t clr[2], gpio_num_t pin, uint8_t level) {
+    uint32_t bit = 1u << (pin & 31);
+    if (level) {
+        set[pin >> 5] |= bit;
     } else {
-        in1_pin = dev->in1_pinB;
-        in2_pin = dev->in2_pinB;
-        en_channel = dev->enB_channel;
-    }
-
-    // Set the motor direction pins according to desired direction.
-    switch(direction) {
-        case MOTOR_FORWARD:
-            gpio_set_level(in1_pin, 1);
-            gpio_set_level(in2_pin, 0);
-            break;
-        case MOTOR_REVERSE:
-            gpio_set_level(in1_pin, 0);
-            gpio_set_level(in2_pin, 1);
-            break;
-        case MOTOR_BRAKE:
-            gpio_set_level(in1_pin, 1);
-            gpio_set_level(in2_pin, 1);
-            break;
-        case MOTOR_STOP:
-        default:
-            gpio_set_level(in1_pin, 0);
-            gpio_set_level(in2_pin, 0);
-            break;
-    }
-
-    // Clamp speed to maximum (0-255 with 8-bit resolution)
-    if (speed > 255) {
-        speed = 255;
-    }
-
-    // Set PWM duty (speed) for the given enable channel.
-    int pwmDC = 0;
-    esp_err_t err = ledc_set_duty(LEDC_MODE, en_channel, speed);
-    if (err == ESP_OK) {
-        err = ledc_update_duty(LEDC_MODE, en_channel);
+        clr[pin >> 5] |= bit;
     }
-    if (err == ESP_OK) {
-        pwmDC = ledc_get_duty(LEDC_MODE, en_channel);
-        ESP_LOGI("PWM_CHECK", "Channel %d duty is %d", en_channel, pwmDC);
-        ESP_LOGI(TAG, "Set motor %d: direction %d, speed %d, PWM %d on LEDC channel %d", motor, direction, speed, pwmDC, en_channel);
+}
+
+/* Flush every board at once. Direction pins of all wheels are gathered into
+** per-bank set/clear masks and written through the GPIO W1TC/W1TS registers,
+** clears first: a wheel that reverses passes through STOP (both low), never
+** through BRAKE. Then all duties are loaded and latched back to back; the
+** channels share one LEDC timer, so they take effect on the same PWM period
+** (in ramp mode, all fades start together).
+*/
+esp_err_t l298n_flush_all(l298n_t *boards, int num_boards){
+    if (boards == NULL || num_boards < 0 || num_boards > L298N_NUM_BOARDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t set[2] = {0, 0}, clr[2] = {0, 0};
+    for (int b = 0; b < num_boards; b++) {
+        l298n_t *dev = &boards[b];
+        for (int motor = 0; motor < 2; motor++) {
+            if (!(dev->dirty & L298N_DIRTY_DIR(motor))) {
+                continue;
+            }
+            int dir = dev->shadow_dir[motor];
+            const uint8_t *lv = dir_levels[(dir >= MOTOR_STOP && dir <= MOTOR_BRAKE) ? dir : MOTOR_STOP];
+            cut_duty(dev, motor);
+            mask_pin(set, clr, motor == 0 ? dev->in1_pinA : dev->in1_pinB, lv[0]);
+            mask_pin(set, clr, motor == 0 ? dev->in2_pinA : dev->in2_pinB, lv[1]);
+            dev->dirty &= ~L298N_DIRTY_DIR(motor);
+            stats.dir_writes_issued++;
+            TRACE(TRACE_EV_MOTOR_DIR, motor == 0 ? dev->enA_channel : dev->enB_channel, dir, 0);
+        }
+    }
+    if (clr[0]) {
+        REG_WRITE(GPIO_OUT_W1TC_REG, clr[0]);
+    }
+    if (clr[1]) {
+        REG_WRITE(GPIO_OUT1_W1TC_REG, clr[1]);
+    }
+    if (set[0]) {
+        REG_WRITE(GPIO_OUT_W1TS_REG, set[0]);
+    }
+    if (set[1]) {
+        REG_WRITE(GPIO_OUT1_W1TS_REG, set[1]);
+    }
+
+    // Load every changed duty first, then latch them all together.
+    esp_err_t err = ESP_OK;
+    uint8_t staged[L298N_NUM_BOARDS] = {0};
+    for (int b = 0; b < num_boards; b++) {
+        l298n_t *dev = &boards[b];
+        for (int motor = 0; motor < 2; motor++) {
+            if (!(dev->dirty & L298N_DIRTY_DUTY(motor))) {
+                continue;
+            }
+            int en_channel = motor == 0 ? dev->enA_channel : dev->enB_channel;
+            esp_err_t ret = load_duty(en_channel, dev->shadow_duty[motor]);
+            if (ret != ESP_OK) {
+                // Stays dirty so the next flush retries it.
+                TRACE(TRACE_EV_LEDC_ERROR, en_channel, ret, 0);
+                err = ret;
+                continue;
+            }
+            staged[b] |= L298N_DIRTY_DUTY(motor);
+        }
+    }
+    for (int b = 0; b < num_boards; b++) {
+        l298n_t *dev = &boards[b];
+        for (int motor = 0; motor < 2; motor++) {
+            if (!(staged[b] & L298N_DIRTY_DUTY(motor))) {
+                continue;
+            }
+            int en_channel = motor == 0 ? dev->enA_channel : dev->enB_channel;
+            esp_err_t ret = latch_duty(en_channel);
+            if (ret == ESP_OK) {
+                dev->dirty &= ~L298N_DIRTY_DUTY(motor);
+                stats.duty_writes_issued++;
+                TRACE(TRACE_EV_MOTOR_DUTY, en_channel, dev->shadow_duty[motor], 0);
+            } else {
+                TRACE(TRACE_EV_LEDC_ERROR, en_channel, ret, 0);
+                err = ret;
+            }
+        }
     }
     return err;
 }
 
+/* Set every wheel from one array of signed speeds (-255..255, sign is the
+** direction, 0 stops), one entry per wheel in board order, and apply them
+** together with l298n_flush_all().
+*/
+esp_err_t l298n_set_all(l298n_t *boards, int num_boards, const int16_t *speed){
+    if (boards == NULL || speed == NULL || num_boards < 0 || num_boards > L298N_NUM_BOARDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int w = 0; w < 2 * num_boards; w++) {
+        int s = speed[w];
+        motorDirection_t dir = s > 0 ? MOTOR_FORWARD : (s < 0 ? MOTOR_REVERSE : MOTOR_STOP);
+        int mag = s < 0 ? -s : s;
+        if (mag > L298N_MAX_DUTY) {
+            mag = L298N_MAX_DUTY;
+        }
+        l298n_stage_motor(&boards[w / 2], w % 2, dir, (int16_t)mag);
+    }
+    return l298n_flush_all(boards, num_boards);
+}
 
-/*
-// L298N Task
-void motor_control_task(void *arg){
-    while (1) {
-        ESP_LOGI(TAG, "Running motors...");
-
-        // For demonstration purposes, run a simple pattern:
-        // Board 1: Motor A forward at speed 200, Motor B reverse at speed 180
-        l298n_set_motor(&board1, 0, MOTOR_FORWARD, 200);
-        l298n_set_motor(&board1, 1, MOTOR_REVERSE, 180);
-        
-        // Board 2: Both motors forward at speed 220
-        l298n_set_motor(&board2, 0, MOTOR_FORWARD, 220);
-        l298n_set_motor(&board2, 1, MOTOR_FORWARD, 220);
-        
-        // Board 3: Both motors reverse at speed 150
-        l298n_set_motor(&board3, 0, MOTOR_REVERSE, 150);
-        l298n_set_motor(&board3, 1, MOTOR_REVERSE, 150);
-        
-        vTaskDelay(pdMS_TO_TICKS(2000));  // Run for 2 seconds
-
-        // Then stop all motors
-        l298n_set_motor(&board1, 0, MOTOR_STOP, 0);
-        l298n_set_motor(&board1, 1, MOTOR_STOP, 0);
-        l298n_set_motor(&board2, 0, MOTOR_STOP, 0);
-        l298n_set_motor(&board2, 1, MOTOR_STOP, 0);
-        l298n_set_motor(&board3, 0, MOTOR_STOP, 0);
-        l298n_set_motor(&board3, 1, MOTOR_STOP, 0);
-        
-        vTaskDelay(pdMS_TO_TICKS(2000));  // Stop for 2 seconds
-    }
-}
-*/
\ No newline at end of file
+void l298n_get_stats(l298n_stats_t *out){
+    *out = stats;
+#if L298N_RAMP_MS > 0
+    out->fades_done = atomic_load(&fades_done);
+#endif
+}
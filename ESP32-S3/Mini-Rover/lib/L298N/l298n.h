@@ -5,6 +5,33 @@
 #include "driver/ledc.h"
 #include "esp_err.h"
 
+// Motor boards on the rover; wheel w is motor w % 2 (A, B) of board w / 2.
+#define L298N_NUM_BOARDS 3
+#define L298N_NUM_MOTORS (2 * L298N_NUM_BOARDS)
+#define L298N_MAX_DUTY 255      // full speed in the units of the speed arguments below
+
+/* PWM timer shared by all enable channels. 20 kHz is above the audible range;
+** the LEDC counter runs from the 80 MHz APB clock, so freq << bits must stay
+** within 80 MHz (11 bits at 20 kHz). Speeds are scaled from 0..L298N_MAX_DUTY
+** to the full counter range.
+*/
+#ifndef L298N_PWM_FREQ_HZ
+#define L298N_PWM_FREQ_HZ 20000
+#endif
+#ifndef L298N_PWM_RES_BITS
+#define L298N_PWM_RES_BITS 10
+#endif
+#define L298N_PWM_MAX ((1 << L298N_PWM_RES_BITS) - 1)
+
+/* Hardware ramp mode. When non-zero, a duty change is handed to the LEDC
+** fade engine, which walks the channel to its new duty at a rate of full
+** scale per L298N_RAMP_MS with no CPU work per step. 0 applies duty changes
+** as immediate steps.
+*/
+#ifndef L298N_RAMP_MS
+#define L298N_RAMP_MS 0
+#endif
+
 typedef enum{
     MOTOR_STOP = 0,
     MOTOR_FORWARD,
@@ -24,10 +51,35 @@ typedef struct {
     gpio_num_t in2_pinB;
     gpio_num_t enB_pin;
     int enB_channel;
+
+    // Shadow of the last direction and duty applied to each motor, and which
+    // of them have been staged but not yet written (see L298N_DIRTY_*).
+    int8_t shadow_dir[2];
+    int16_t shadow_duty[2];
+    uint8_t dirty;
 } l298n_t;
 
+#define L298N_DIRTY_DIR(motor)  (1u << (2 * (motor)))
+#define L298N_DIRTY_DUTY(motor) (1u << (2 * (motor) + 1))
+
+// Counters for L298N hardware writes that were issued or elided by the shadow state.
+typedef struct {
+    uint32_t dir_writes_issued;
+    uint32_t dir_writes_elided;
+    uint32_t duty_writes_issued;
+    uint32_t duty_writes_elided;
+    uint32_t fades_started;     // ramp mode: fades handed to the LEDC engine
+    uint32_t fades_done;        // ramp mode: fades that ran to their target
+    uint32_t fades_cut;         // ramp mode: fades replaced before they finished
+} l298n_stats_t;
+
 esp_err_t l298n_init(l298n_t *dev);
 esp_err_t l298n_set_motor(l298n_t *dev, int motor, motorDirection_t direction, int16_t speed);
-void init_motor_controllers(l298n_t *b1, l298n_t *b2, l298n_t *b3);
+esp_err_t l298n_stage_motor(l298n_t *dev, int motor, motorDirection_t direction, int16_t speed);
+esp_err_t l298n_flush(l298n_t *dev);
+esp_err_t l298n_flush_all(l298n_t *boards, int num_boards);
+esp_err_t l298n_set_all(l298n_t *boards, int num_boards, const int16_t *speed);
+void l298n_get_stats(l298n_stats_t *out);
+void init_motor_controllers(l298n_t boards[L298N_NUM_BOARDS]);
 
 #endif
\ No newline at end of file
@@ -1,155 +1,844 @@
-#include "PCA9685.h"
-#include <math.h>
+#include "pca9685.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+#include "i2c_bus.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "trace.h"
 
 static const char *TAG = "PCA9685";
 
-/* Write to PCA9685 register */
-esp_err_t pca9685_write(uint8_t reg, uint8_t value){
-    uint8_t data[2] = {reg, value};
-    return i2c_master_write_to_device(I2C_MASTER_NUM, I2C_PCA9685_ADDR, data, 2, 1000/portTICK_PERIOD_MS);
+#define PULSE_UNKNOWN 0xFFFF
+
+/* One PCA9685 board. Every handle has its own register shadow and servo
+** calibration, so boards share nothing but the bus. Boards are kept in
+** address order, which fixes the global channel index: channel c is output
+** c % 16 of board c / 16.
+*/
+struct pca9685_dev {
+    uint8_t addr;
+    uint8_t index;                  // position in devs[]
+    i2c_bus_dev_t bus;
+
+    /* Shadow of the OFF count last written to each LEDn block. The client
+    ** resends unchanged setpoints many times a second, so writes are staged
+    ** against the shadow and only channels whose pulse changed are marked dirty.
+    */
+    uint16_t shadow_pulse[PCA9685_NUM_CHANNELS];
+    uint16_t dirty_mask;
+    pca9685_stats_t stats;
+
+    // Channels whose queued write failed on the bus; folded back into dirty_mask by the next flush.
+    atomic_uint failed_mask;
+    atomic_uint write_errors;
+
+    pca9685_cal_t cal[PCA9685_NUM_CHANNELS];
+};
+
+static pca9685_dev_t *devs[PCA9685_MAX_DEVICES];
+static int num_devs = 0;
+
+// Default calibration: the starting point of every new handle, and what channels without a board convert with.
+static pca9685_dev_t defaults;
+static uint8_t defaults_ready = 0;
+
+// Addresses found by the last bus enumeration; num_found is -1 until there has been one.
+static uint8_t found[PCA9685_MAX_DEVICES];
+static int num_found = -1;
+
+static esp_err_t dev_write(pca9685_dev_t *dev, uint8_t reg, uint8_t value) {
+    return i2c_bus_write(dev->bus, reg, &value, 1);
+}
+
+static esp_err_t dev_read(pca9685_dev_t *dev, uint8_t reg, uint8_t *data) {
+    return i2c_bus_read(dev->bus, reg, data, 1);
 }
 
-esp_err_t pca9685_read(uint8_t reg, uint8_t *data) {
-    return i2c_master_read_from_device(I2C_MASTER_NUM, I2C_PCA9685_ADDR, data, 1, 1000 / portTICK_PERIOD_MS);
+// Board and output for a global channel index, or NULL if no board carries that channel.
+static pca9685_dev_t *dev_for(uint16_t channel, uint8_t *local) {
+    int d = channel / PCA9685_NUM_CHANNELS;
+    if (d >= num_devs) {
+        return NULL;
+    }
+    *local = channel % PCA9685_NUM_CHANNELS;
+    return devs[d];
 }
 
-/* Function to initialize I2C */
+/* Function to initialize I2C: start the bus engine. The boards are found and registered by pca9685_init(). */
 void i2c_master_init(){
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .master.clk_speed = I2C_FREQ,
-    };
-    i2c_param_config(I2C_MASTER_NUM, &conf);
-    i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
+    ESP_ERROR_CHECK(i2c_bus_init(I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO));
 }
 
-void pca9685_init(){
-    ESP_LOGI("PCA9685", "Initializing PCA9685");
+/* Raise a board's bus clock to the fastest rate it answers reliably at.
+** Each candidate is checked by writing test patterns to SUBADR1, a plain R/W
+** register, and reading them back. The ESP32-S3 controller and the pull-ups
+** on the board decide whether Fm+ works, so it is tried rather than assumed.
+*/
+static uint32_t select_bus_speed(pca9685_dev_t *dev) {
+    static const uint32_t rates[] = {I2C_BUS_FREQ_FAST_PLUS, I2C_BUS_FREQ_FAST, I2C_BUS_FREQ_STD};
+    static const uint8_t patterns[] = {0x55, 0xAA, 0x00, 0xFE};
 
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        if (i2c_bus_set_speed(dev->bus, rates[r]) != ESP_OK) {
+            continue;
+        }
+        uint8_t ok = 1;
+        for (size_t p = 0; p < sizeof(patterns) && ok; p++) {
+            uint8_t back = ~patterns[p];
+            ok = dev_write(dev, PCA9685_SUBADR1, patterns[p]) == ESP_OK &&
+                 dev_read(dev, PCA9685_SUBADR1, &back) == ESP_OK &&
+                 back == patterns[p];
+        }
+        if (ok) {
+            dev_write(dev, PCA9685_SUBADR1, PCA9685_SUBADR1_DEFAULT);
+            return rates[r];
+        }
+        ESP_LOGW(TAG, "0x%02X: readback failed at %lu Hz", dev->addr, (unsigned long)rates[r]);
+    }
+
+    i2c_bus_set_speed(dev->bus, I2C_FREQ);
+    return I2C_FREQ;
+}
+
+/* Read MODE1 until (MODE1 & mask) == want and at least min_us have passed.
+** The chip takes a register write as soon as the bus transaction ends, so
+** this normally returns after one read instead of a fixed sleep; min_us
+** covers the oscillator start-up after waking, which is not visible in any
+** register. Gives up after PCA9685_INIT_TIMEOUT_US.
+*/
+static esp_err_t wait_mode1(pca9685_dev_t *dev, uint8_t mask, uint8_t want, int64_t min_us, uint8_t *mode1) {
+    int64_t start = esp_timer_get_time();
+    int64_t elapsed = 0;
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+
+    while (elapsed < PCA9685_INIT_TIMEOUT_US) {
+        if (dev_read(dev, PCA9685_MODE1, mode1) == ESP_OK && (*mode1 & mask) == want) {
+            ret = ESP_OK;
+            if (elapsed >= min_us) {
+                return ESP_OK;
+            }
+        }
+        elapsed = esp_timer_get_time() - start;
+    }
+    return ret;
+}
+
+// Prescaler for 50 Hz, wake-up and auto-increment: the register setup every board needs.
+static esp_err_t configure(pca9685_dev_t *dev) {
     // Put PCA9685 into sleep mode to set prescaler (set MODE1 to 0x10)
-    pca9685_write(PCA9685_MODE1, 0x10);
-    vTaskDelay(pdMS_TO_TICKS(10)); // arbitrary delay to ensure register is written to
+    dev_write(dev, PCA9685_MODE1, PCA9685_MODE1_SLEEP);
 
-    // Read back the MODE1 register
     uint8_t mode1 = 0;
-    esp_err_t ret = pca9685_read(PCA9685_MODE1, &mode1);
-    if (ret == ESP_OK) {
-        ESP_LOGI("PCA9685", "MODE1 register value: 0x%02X", mode1);
+    if (wait_mode1(dev, PCA9685_MODE1_SLEEP, PCA9685_MODE1_SLEEP, 0, &mode1) == ESP_OK) {
+        ESP_LOGI(TAG, "0x%02X: MODE1 register value: 0x%02X", dev->addr, mode1);
     } else {
-        ESP_LOGE("PCA9685", "Failed to read MODE1 register");
+        ESP_LOGE(TAG, "0x%02X: Failed to read MODE1 register", dev->addr);
     }
 
     // Set the prescaler for 50Hz PWM frequency
     uint8_t prescale = (uint8_t)(25000000.0 / (4096 * 50) - 1);  // datasheet page 25
-    if (pca9685_write(PCA9685_PRESCALE, prescale) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write PCA9685 prescaler");
-        return;
+    uint8_t back = 0;
+    if (dev_write(dev, PCA9685_PRESCALE, prescale) != ESP_OK ||
+        dev_read(dev, PCA9685_PRESCALE, &back) != ESP_OK || back != prescale) {
+        ESP_LOGE(TAG, "0x%02X: Failed to write PCA9685 prescaler", dev->addr);
+        return ESP_FAIL;
     }
 
     // Wake up PCA9685 and enable auto-increment
-    pca9685_write(PCA9685_MODE1, 0xA1); // datasheet page 14 for Mode Register 1 values
-    vTaskDelay(pdMS_TO_TICKS(10)); // arbitrary delay to ensure register is written to
+    dev_write(dev, PCA9685_MODE1, 0xA1); // datasheet page 14 for Mode Register 1 values
+    if (wait_mode1(dev, PCA9685_MODE1_SLEEP, 0, PCA9685_OSC_STARTUP_US, &mode1) != ESP_OK) {
+        ESP_LOGE(TAG, "0x%02X: PCA9685 did not wake (MODE1 0x%02X)", dev->addr, mode1);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "PCA9685 initialized.");
-    vTaskDelay(pdMS_TO_TICKS(10)); // arbitrary delay to ensure register is written to
+// Board list saved by the last full scan, or 0 if there is none.
+static int load_board_list(uint8_t *addrs) {
+    nvs_handle_t nvs;
+    size_t len = PCA9685_MAX_DEVICES;
+    if (nvs_open(PCA9685_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return 0;
+    }
+    esp_err_t ret = nvs_get_blob(nvs, PCA9685_NVS_BOARDS_KEY, addrs, &len);
+    nvs_close(nvs);
+    return ret == ESP_OK ? (int)len : 0;
 }
 
-void pca9685_set_servo_angle(uint8_t channel, float angle) {
-    // Servo value were found experimentally.
-    uint16_t pulseMin = SERVO_MIN;  // 1ms pulse width for 0 degrees
-    uint16_t pulseMax = SERVO_MAX;  // 2ms pulse width for 180 degrees
-    uint16_t pulse = pulseMin + (angle / 180.0) * (pulseMax - pulseMin);
+static void save_board_list(const uint8_t *addrs, int n) {
+    nvs_handle_t nvs;
+    if (nvs_open(PCA9685_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs, PCA9685_NVS_BOARDS_KEY, addrs, n) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
 
-    ESP_LOGI(TAG, "Setting servo channel %d to angle %.2f (pulse: %d)", channel, angle, pulse);
+/* Find the PCA9685 boards on the bus. Probes go through the bus engine with
+** its short probe timeout, so an empty address costs one NACKed address
+** byte. The result is cached in RAM and in NVS: later calls return it
+** without touching the bus, and the next boot only probes the saved
+** addresses, falling back to a full scan of 0x40 - 0x7F if any of them is
+** missing. A board added at a new address is therefore only found by a
+** rescan. 0x70 is never probed; it is the LED All Call address that every
+** board answers by default.
+*/
+int pca9685_enumerate(uint8_t *addrs, int max, uint8_t rescan) {
+    if (num_found < 0 || rescan) {
+        uint8_t saved[PCA9685_MAX_DEVICES];
+        int n = rescan ? 0 : load_board_list(saved);
+        int ok = n > 0;
+        for (int i = 0; i < n && ok; i++) {
+            ok = i2c_bus_probe(saved[i]) == ESP_OK;
+        }
 
-    uint8_t reg = PCA9685_LED0_ON_L + 4 * channel;
-    uint8_t data[4] = {
-        0x00,               // ON time low byte (always 0)
-        0x00,               // ON time high byte (always 0)
-        pulse & 0xFF,       // OFF time low byte
-        (pulse >> 8) & 0xFF // OFF time high byte
-    };
+        if (ok) {
+            memcpy(found, saved, n);
+            ESP_LOGI(TAG, "%d board(s) from the saved list", n);
+        } else {
+            n = 0;
+            for (int a = PCA9685_ADDR_FIRST; a <= PCA9685_ADDR_LAST && n < PCA9685_MAX_DEVICES; a++) {
+                if (a != PCA9685_ALLCALL_ADDR && i2c_bus_probe(a) == ESP_OK) {
+                    found[n++] = a;
+                }
+            }
+            if (n > 0) {
+                save_board_list(found, n);
+            }
+        }
+        num_found = n;
+    }
 
-    // Debugging the pulse width value
-    ESP_LOGI("PCA9685", "Setting servo %d to angle %.2f, pulse width: %d", channel, angle, pulse);
+    int n = num_found < max ? num_found : max;
+    memcpy(addrs, found, n);
+    return n;
+}
 
-    // Send register address + data in one transaction
-    uint8_t write_buffer[5] = {reg, data[0], data[1], data[2], data[3]};
-    esp_err_t ret = i2c_master_write_to_device(I2C_MASTER_NUM, I2C_PCA9685_ADDR, write_buffer, sizeof(write_buffer), 1000 / portTICK_PERIOD_MS);
+/* Register and configure the board at addr (or return the existing handle).
+** Its calibration is loaded from NVS and its bus clock raised as far as it
+** answers reliably. The handle is kept even when the board does not answer,
+** so writes to its channels show up as bus errors rather than vanishing.
+*/
+esp_err_t pca9685_open(uint8_t addr, pca9685_dev_t **out) {
+    for (int i = 0; i < num_devs; i++) {
+        if (devs[i]->addr == addr) {
+            *out = devs[i];
+            return ESP_OK;
+        }
+    }
+    if (num_devs == PCA9685_MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!defaults_ready) {
+        pca9685_cal_load();
+    }
 
+    pca9685_dev_t *dev = malloc(sizeof(*dev));
+    if (dev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(dev, &defaults, sizeof(*dev));
+    dev->addr = addr;
+    esp_err_t ret = i2c_bus_add_device(addr, I2C_FREQ, &dev->bus);
     if (ret != ESP_OK) {
-        ESP_LOGE("PCA9685", "Failed to write PWM data for servo %d", channel);
+        free(dev);
+        return ret;
     }
+
+    // Keep devs[] in address order; writes are only queued once init is done, so indices are stable by then.
+    int pos = num_devs;
+    while (pos > 0 && devs[pos - 1]->addr > addr) {
+        devs[pos] = devs[pos - 1];
+        devs[pos]->index = pos;
+        pos--;
+    }
+    dev->index = pos;
+    devs[pos] = dev;
+    num_devs++;
+
+    pca9685_dev_cal_load(dev);
+    ret = configure(dev);
+    if (ret == ESP_OK) {
+        uint32_t hz = select_bus_speed(dev);
+        ESP_LOGI(TAG, "0x%02X: channels %d-%d, I2C bus running at %lu kHz", addr,
+                 pos * PCA9685_NUM_CHANNELS, pos * PCA9685_NUM_CHANNELS + PCA9685_NUM_CHANNELS - 1, (unsigned long)(hz / 1000));
+    }
+    *out = dev;
+    return ret;
 }
 
-void set_full_pwm(uint8_t channel) {
-    uint8_t reg = PCA9685_LED0_ON_L + 4 * channel; // LEDx_ON_L register
-    uint8_t data[5] = {
-        reg,    // Register address
+void pca9685_init(){
+    ESP_LOGI(TAG, "Initializing PCA9685");
+    uint8_t addrs[PCA9685_MAX_DEVICES];
+    int n = pca9685_enumerate(addrs, PCA9685_MAX_DEVICES, 0);
+    if (n == 0) {
+        ESP_LOGE(TAG, "No PCA9685 answered; assuming one at 0x%02X", I2C_PCA9685_ADDR);
+        addrs[0] = I2C_PCA9685_ADDR;
+        n = 1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        pca9685_dev_t *dev;
+        if (pca9685_open(addrs[i], &dev) != ESP_OK) {
+            ESP_LOGE(TAG, "0x%02X: setup failed", addrs[i]);
+        }
+    }
+    if (num_devs == 0) {
+        ESP_LOGE(TAG, "No PCA9685 set up; servo writes are ignored");
+        return;
+    }
+    ESP_LOGI(TAG, "PCA9685 initialized: %d board(s), %d channels.", num_devs, pca9685_num_channels());
+}
+
+int pca9685_num_devices() {
+    return num_devs;
+}
+
+int pca9685_num_channels() {
+    return num_devs * PCA9685_NUM_CHANNELS;
+}
+
+pca9685_dev_t *pca9685_get_device(int index) {
+    return index >= 0 && index < num_devs ? devs[index] : NULL;
+}
+
+uint8_t pca9685_dev_addr(const pca9685_dev_t *dev) {
+    return dev->addr;
+}
+
+static uint8_t cal_valid(const pca9685_cal_t *c) {
+    return c->min_pulse < 4096 && c->max_pulse < 4096 && c->min_pulse != c->max_pulse &&
+           c->trim_dd > -PCA9685_ANGLE_MAX_DD && c->trim_dd < PCA9685_ANGLE_MAX_DD;
+}
+
+// The board at I2C_PCA9685_ADDR keeps the original key, so calibrations saved before multi-board support still load.
+static void cal_key(const pca9685_dev_t *dev, char *key, size_t len) {
+    if (dev->addr == I2C_PCA9685_ADDR) {
+        snprintf(key, len, "%s", PCA9685_NVS_CAL_KEY);
+    } else {
+        snprintf(key, len, "%s_%02x", PCA9685_NVS_CAL_KEY, dev->addr);
+    }
+}
+
+/* Load one board's calibration blob from NVS.
+** Channels keep the SERVO_MIN/SERVO_MAX default when nothing is stored or
+** the blob does not match this firmware's layout.
+*/
+esp_err_t pca9685_dev_cal_load(pca9685_dev_t *dev) {
+    char key[16];
+    cal_key(dev, key, sizeof(key));
+
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(PCA9685_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret == ESP_OK) {
+        pca9685_cal_t stored[PCA9685_NUM_CHANNELS];
+        size_t len = sizeof(stored);
+        ret = nvs_get_blob(nvs, key, stored, &len);
+        nvs_close(nvs);
+        if (ret == ESP_OK && len != sizeof(stored)) {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+        if (ret == ESP_OK) {
+            for (int i = 0; i < PCA9685_NUM_CHANNELS; i++) {
+                if (cal_valid(&stored[i])) {
+                    dev->cal[i] = stored[i];
+                } else {
+                    ESP_LOGW(TAG, "0x%02X: Ignoring invalid calibration for channel %d", dev->addr, i);
+                }
+            }
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGI(TAG, "0x%02X: No servo calibration in NVS (%s), using defaults", dev->addr, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+/* Set up the default calibration, then reload every open board's calibration.
+** Needs nvs_flash_init() to have run first if any board is open.
+*/
+esp_err_t pca9685_cal_load() {
+    if (!defaults_ready) {
+        for (int i = 0; i < PCA9685_NUM_CHANNELS; i++) {
+            defaults.cal[i] = (pca9685_cal_t){ .min_pulse = SERVO_MIN, .max_pulse = SERVO_MAX };
+            defaults.shadow_pulse[i] = PULSE_UNKNOWN;
+        }
+        defaults_ready = 1;
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (int d = 0; d < num_devs; d++) {
+        esp_err_t r = pca9685_dev_cal_load(devs[d]);
+        ret = ret == ESP_OK ? r : ret;
+    }
+    return ret;
+}
+
+esp_err_t pca9685_cal_save() {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(PCA9685_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    for (int d = 0; d < num_devs && ret == ESP_OK; d++) {
+        char key[16];
+        cal_key(devs[d], key, sizeof(key));
+        ret = nvs_set_blob(nvs, key, devs[d]->cal, sizeof(devs[d]->cal));
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+// Change one channel's calibration in RAM. Call pca9685_cal_save() to keep it across reboots.
+esp_err_t pca9685_set_calibration(uint16_t channel, const pca9685_cal_t *c) {
+    uint8_t local;
+    pca9685_dev_t *dev = dev_for(channel, &local);
+    if (dev == NULL || c == NULL || !cal_valid(c)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    dev->cal[local] = *c;
+    return ESP_OK;
+}
+
+void pca9685_get_calibration(uint16_t channel, pca9685_cal_t *out) {
+    uint8_t local;
+    pca9685_dev_t *dev = dev_for(channel, &local);
+    if (dev) {
+        *out = dev->cal[local];
+    }
+}
+
+/* Angle to OFF count through one channel's calibration, in integers only:
+** min + (a * (max - min) + 900) / 1800, rounded to the nearest count. Exact
+** for every tenth of a degree, and no per-board table to keep in RAM.
+*/
+static uint16_t cal_to_pulse(const pca9685_dev_t *dev, uint8_t channel, uint16_t angle_dd) {
+    const pca9685_cal_t *c = &dev->cal[channel & (PCA9685_NUM_CHANNELS - 1)];
+    int32_t a = angle_dd > PCA9685_ANGLE_MAX_DD ? PCA9685_ANGLE_MAX_DD : angle_dd;
+    if (c->invert) {
+        a = PCA9685_ANGLE_MAX_DD - a;
+    }
+    a += c->trim_dd;
+    if (a < 0) {
+        a = 0;
+    } else if (a > PCA9685_ANGLE_MAX_DD) {
+        a = PCA9685_ANGLE_MAX_DD;
+    }
+
+    // Round half away from zero, so a reversed servo (max < min) rounds the same way.
+    int32_t num = ((int32_t)c->max_pulse - c->min_pulse) * a;
+    int32_t half = PCA9685_ANGLE_MAX_DD / 2;
+    int32_t offset = (num >= 0) ? (num + half) / PCA9685_ANGLE_MAX_DD : -((half - num) / PCA9685_ANGLE_MAX_DD);
+    return (uint16_t)(c->min_pulse + offset);
+}
+
+// 12-bit OFF count for an angle in tenths of a degree. Channels without a board use the default calibration.
+uint16_t pca9685_angle_to_pulse(uint16_t channel, uint16_t angle_dd) {
+    uint8_t local = channel % PCA9685_NUM_CHANNELS;
+    pca9685_dev_t *dev = dev_for(channel, &local);
+    return cal_to_pulse(dev ? dev : &defaults, local, angle_dd);
+}
+
+// Legacy float angles (degrees) are converted to tenths once at the API boundary.
+static uint16_t degrees_to_dd(float angle) {
+    if (!(angle > 0)) {
+        return 0;
+    }
+    if (angle >= SERVO_MAX_ANGLE) {
+        return PCA9685_ANGLE_MAX_DD;
+    }
+    return (uint16_t)(angle * PCA9685_ANGLE_SCALE + 0.5f);
+}
+
+// Fill one 4-byte LEDn_ON_L..LEDn_OFF_H block for a pulse that starts at count 0.
+static void fill_led_regs(uint8_t *dst, uint16_t pulse) {
+    dst[0] = 0x00;                  // ON time low byte (always 0)
+    dst[1] = 0x00;                  // ON time high byte (always 0)
+    dst[2] = pulse & 0xFF;          // OFF time low byte
+    dst[3] = (pulse >> 8) & 0xFF;   // OFF time high byte
+}
+
+/* Bus engine completion for LEDn writes. arg carries the board index in the
+** upper half and the channel mask of the write in the lower 16 bits.
+*/
+static void write_done(esp_err_t err, void *arg) {
+    if (err != ESP_OK) {
+        uintptr_t v = (uintptr_t)arg;
+        pca9685_dev_t *dev = devs[v >> 16];
+        unsigned mask = v & 0xFFFF;
+        atomic_fetch_or_explicit(&dev->failed_mask, mask, memory_order_relaxed);
+        atomic_fetch_add_explicit(&dev->write_errors, 1, memory_order_relaxed);
+        TRACE(TRACE_EV_I2C_ERROR, PCA9685_LED0_ON_L + 4 * __builtin_ctz(mask), err, __builtin_popcount(mask));
+    }
+}
+
+static inline void *done_arg(const pca9685_dev_t *dev, uint16_t mask) {
+    return (void *)(((uintptr_t)dev->index << 16) | mask);
+}
+
+void pca9685_dev_stage_pulse(pca9685_dev_t *dev, uint8_t channel, uint16_t pulse) {
+    if (channel >= PCA9685_NUM_CHANNELS) {
+        return;
+    }
+    if (dev->shadow_pulse[channel] == pulse && !(dev->dirty_mask & (1u << channel))) {
+        dev->stats.writes_elided++;
+        return;
+    }
+    TRACE(TRACE_EV_SERVO_PULSE, dev->index * PCA9685_NUM_CHANNELS + channel, pulse, 0);
+    dev->shadow_pulse[channel] = pulse;
+    dev->dirty_mask |= (1u << channel);
+}
+
+void pca9685_stage_pulse(uint16_t channel, uint16_t pulse) {
+    uint8_t local;
+    pca9685_dev_t *dev = dev_for(channel, &local);
+    if (dev) {
+        pca9685_dev_stage_pulse(dev, local, pulse);
+    }
+}
+
+/* Write every dirty channel of one board. Runs of dirty channels go out as
+** auto-incremented bursts; clean channels between two dirty ones are
+** rewritten with their shadow value, which is cheaper than starting a
+** second transaction. A clean channel that has never been written
+** (PULSE_UNKNOWN) has nothing to rewrite it with, so the burst is split
+** there instead.
+**
+** Bursts are queued on the bus engine and this returns without waiting.
+** Channels whose write later fails are marked dirty again and retried by
+** the next flush.
+*/
+esp_err_t pca9685_dev_flush(pca9685_dev_t *dev) {
+    dev->dirty_mask |= atomic_exchange_explicit(&dev->failed_mask, 0, memory_order_relaxed);
+
+    while (dev->dirty_mask) {
+        int first = __builtin_ctz(dev->dirty_mask);
+        int last = first;
+        for (int c = first + 1; c < PCA9685_NUM_CHANNELS && (dev->dirty_mask >> c); c++) {
+            if (dev->dirty_mask & (1u << c)) {
+                last = c;
+            } else if (dev->shadow_pulse[c] == PULSE_UNKNOWN) {
+                break;
+            }
+        }
+        int count = last - first + 1;
+
+        uint8_t data[4 * PCA9685_NUM_CHANNELS];
+        for (int i = 0; i < count; i++) {
+            fill_led_regs(&data[4 * i], dev->shadow_pulse[first + i]);
+        }
+
+        uint16_t span = (uint16_t)(((1u << count) - 1) << first);
+        esp_err_t ret = i2c_bus_write_async(dev->bus, PCA9685_LED0_ON_L + 4 * first, data, 4 * count, write_done, done_arg(dev, span));
+        if (ret != ESP_OK) {
+            // Queue full: leave the channels dirty so the next flush retries them.
+            TRACE(TRACE_EV_I2C_ERROR, PCA9685_LED0_ON_L + 4 * first, ret, count);
+            return ret;
+        }
+
+        TRACE(TRACE_EV_SERVO_FLUSH, dev->index * PCA9685_NUM_CHANNELS + first, count, 0);
+
+        dev->stats.writes_issued += count;
+        dev->stats.transactions++;
+        dev->dirty_mask &= ~span;
+    }
+    return ESP_OK;
+}
+
+/* Flush every board: one queued burst per board with dirty channels (more
+** only while a board has outputs that were never written), so the caller's
+** cost grows with the number of boards touched, not with channels, and the
+** bursts go out back to back on the bus engine.
+*/
+esp_err_t pca9685_flush() {
+    esp_err_t ret = ESP_OK;
+    for (int d = 0; d < num_devs; d++) {
+        esp_err_t r = pca9685_dev_flush(devs[d]);
+        ret = ret == ESP_OK ? r : ret;
+    }
+    return ret;
+}
+
+esp_err_t pca9685_when_done(i2c_bus_cb_t cb, void *arg) {
+    return i2c_bus_notify(cb, arg);
+}
+
+void pca9685_get_stats(pca9685_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    for (int d = 0; d < num_devs; d++) {
+        const pca9685_dev_t *dev = devs[d];
+        out->writes_issued += dev->stats.writes_issued;
+        out->writes_elided += dev->stats.writes_elided;
+        out->transactions += dev->stats.transactions;
+        out->write_errors += atomic_load_explicit(&dev->write_errors, memory_order_relaxed);
+    }
+}
+
+void pca9685_get_pulses(uint16_t *out, uint16_t count) {
+    for (int i = 0; i < count; i++) {
+        uint8_t local;
+        pca9685_dev_t *dev = dev_for(i, &local);
+        out[i] = dev ? dev->shadow_pulse[local] : PULSE_UNKNOWN;
+    }
+}
+
+void pca9685_set_servo_angle(uint16_t channel, float angle) {
+    uint8_t local;
+    pca9685_dev_t *dev = dev_for(channel, &local);
+    if (dev == NULL) {
+        return;
+    }
+    pca9685_dev_stage_pulse(dev, local, cal_to_pulse(dev, local, degrees_to_dd(angle)));
+    pca9685_dev_flush(dev);
+}
+
+/* Write the same pulse to all 16 outputs of a board through the ALL_LED
+** registers, a single 4-byte write instead of a 64-byte burst. Only
+** pca9685_set_all_servos() gets here: the rover's own servo updates cover
+** six channels with different pulses and always take the LEDn burst.
+*/
+static esp_err_t write_all_pulse(pca9685_dev_t *dev, uint16_t pulse) {
+    uint16_t changed = 0;
+    for (int i = 0; i < PCA9685_NUM_CHANNELS; i++) {
+        if (dev->shadow_pulse[i] != pulse) {
+            changed |= (1u << i);
+        }
+    }
+    if (changed == 0 && dev->dirty_mask == 0) {
+        dev->stats.writes_elided += PCA9685_NUM_CHANNELS;
+        return ESP_OK;
+    }
+
+    uint8_t data[4];
+    fill_led_regs(data, pulse);
+
+    esp_err_t ret = i2c_bus_write_async(dev->bus, PCA9685_ALL_LED_ON_L, data, sizeof(data), write_done, done_arg(dev, 0xFFFF));
+    if (ret != ESP_OK) {
+        TRACE(TRACE_EV_I2C_ERROR, PCA9685_ALL_LED_ON_L, ret, 1);
+        return ret;
+    }
+
+    for (int i = 0; i < PCA9685_NUM_CHANNELS; i++) {
+        dev->shadow_pulse[i] = pulse;
+    }
+    dev->dirty_mask = 0;
+    dev->stats.writes_issued++;
+    dev->stats.transactions++;
+    return ESP_OK;
+}
+
+// Stage pulses for a board's channels 0..count-1 and flush.
+static esp_err_t set_pulses(pca9685_dev_t *dev, const uint16_t *pulses, uint8_t count) {
+    for (int i = 0; i < count; i++) {
+        pca9685_dev_stage_pulse(dev, i, pulses[i]);
+    }
+    return pca9685_dev_flush(dev);
+}
+
+/* Set servos 0..count-1 (global channel indices) with one transaction per
+** board. MODE1 has auto-increment enabled by pca9685_init(), so each chip
+** advances through the LEDn registers on its own and every output of a
+** board latches the new pulse on the same PWM cycle. Channels whose pulse
+** has not changed are skipped. Angles are in tenths of a degree and go
+** through each channel's calibration. With no board set up this does
+** nothing and succeeds; pca9685_init() has already said so once.
+*/
+esp_err_t pca9685_set_servos_dd(const uint16_t *angle_dd, uint16_t count) {
+    if (num_devs == 0) {
+        return ESP_OK;
+    }
+    if (angle_dd == NULL || count == 0 || count > pca9685_num_channels()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (int d = 0; d * PCA9685_NUM_CHANNELS < count; d++) {
+        const uint16_t *a = angle_dd + d * PCA9685_NUM_CHANNELS;
+        int n = count - d * PCA9685_NUM_CHANNELS;
+        n = n > PCA9685_NUM_CHANNELS ? PCA9685_NUM_CHANNELS : n;
+
+        uint16_t pulses[PCA9685_NUM_CHANNELS];
+        for (int i = 0; i < n; i++) {
+            pulses[i] = cal_to_pulse(devs[d], i, a[i]);
+        }
+        esp_err_t r = set_pulses(devs[d], pulses, n);
+        ret = ret == ESP_OK ? r : ret;
+    }
+    return ret;
+}
+
+esp_err_t pca9685_set_servos(const float *angles, uint16_t count) {
+    if (num_devs == 0) {
+        return ESP_OK;
+    }
+    if (angles == NULL || count == 0 || count > pca9685_num_channels()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint16_t angle_dd[PCA9685_MAX_CHANNELS];
+    for (int i = 0; i < count; i++) {
+        angle_dd[i] = degrees_to_dd(angles[i]);
+    }
+    return pca9685_set_servos_dd(angle_dd, count);
+}
+
+/* Drive every output of every board to the same angle, e.g. to centre all
+** servos. A board whose 16 channels share a calibration gets one ALL_LED
+** write; otherwise the pulses go out as a normal burst.
+*/
+esp_err_t pca9685_set_all_servos(float angle) {
+    uint16_t angle_dd = degrees_to_dd(angle);
+
+    esp_err_t ret = ESP_OK;
+    for (int d = 0; d < num_devs; d++) {
+        uint16_t pulses[PCA9685_NUM_CHANNELS];
+        uint8_t same = 1;
+        for (int i = 0; i < PCA9685_NUM_CHANNELS; i++) {
+            pulses[i] = cal_to_pulse(devs[d], i, angle_dd);
+            same = same && pulses[i] == pulses[0];
+        }
+        esp_err_t r = same ? write_all_pulse(devs[d], pulses[0]) : set_pulses(devs[d], pulses, PCA9685_NUM_CHANNELS);
+        ret = ret == ESP_OK ? r : ret;
+    }
+    return ret;
+}
+
+// Turn one board's outputs fully off (full-OFF bit in ALL_LED_OFF_H), e.g. to release the servos.
+esp_err_t pca9685_dev_all_off(pca9685_dev_t *dev) {
+    uint8_t data[4] = {0x00, 0x00, 0x00, 0x10};
+    esp_err_t ret = i2c_bus_write(dev->bus, PCA9685_ALL_LED_ON_L, data, sizeof(data));
+
+    // The full-OFF bit overrides the LEDn blocks, so force the next staged pulse out.
+    for (int i = 0; i < PCA9685_NUM_CHANNELS; i++) {
+        dev->shadow_pulse[i] = PULSE_UNKNOWN;
+    }
+    dev->dirty_mask = 0;
+    atomic_store_explicit(&dev->failed_mask, 0, memory_order_relaxed);
+    return ret;
+}
+
+esp_err_t pca9685_all_off() {
+    esp_err_t ret = ESP_OK;
+    for (int d = 0; d < num_devs; d++) {
+        esp_err_t r = pca9685_dev_all_off(devs[d]);
+        ret = ret == ESP_OK ? r : ret;
+    }
+    return ret;
+}
+
+void set_full_pwm(uint16_t channel) {
+    uint8_t local;
+    pca9685_dev_t *dev = dev_for(channel, &local);
+    if (dev == NULL) {
+        return;
+    }
+    uint8_t reg = PCA9685_LED0_ON_L + 4 * local; // LEDx_ON_L register
+    uint8_t data[4] = {
         0x00,   // ON time low byte (always 0)
         0x00,   // ON time high byte (always 0)
         0xFF,   // OFF time low byte (0x0FFF for full duty cycle)
         0x0F    // OFF time high byte
     };
 
-    esp_err_t ret = i2c_master_write_to_device(I2C_MASTER_NUM, I2C_PCA9685_ADDR, data, sizeof(data), 1000 / portTICK_PERIOD_MS);
+    esp_err_t ret = i2c_bus_write(dev->bus, reg, data, sizeof(data));
 
     if (ret != ESP_OK) {
         ESP_LOGE("PCA9685", "Failed to set full PWM on channel %d", channel);
     } else {
+        dev->shadow_pulse[local] = 0x0FFF;
+        dev->dirty_mask &= ~(1u << local);
         ESP_LOGI("PCA9685", "Set channel %d to full PWM (always HIGH)", channel);
     }
 }
 
+// MODE1 of the first board, 0 if there is none.
 uint8_t read_pca9685_mode1() {
-    uint8_t mode1;
-    i2c_master_write_to_device(I2C_MASTER_NUM, I2C_PCA9685_ADDR, (uint8_t[]){PCA9685_MODE1}, 1, 1000 / portTICK_PERIOD_MS);
-    i2c_master_read_from_device(I2C_MASTER_NUM, I2C_PCA9685_ADDR, &mode1, 1, 1000 / portTICK_PERIOD_MS);
+    uint8_t mode1 = 0;
+    if (num_devs > 0) {
+        dev_read(devs[0], PCA9685_MODE1, &mode1);
+    }
     return mode1;
 }
 
+// Clear the SLEEP bit of the first board.
 void force_wake_up(){
+    if (num_devs == 0) {
+        return;
+    }
     uint8_t mode1;
-    pca9685_read_register(I2C_MASTER_NUM, I2C_PCA9685_ADDR, PCA9685_MODE1, &mode1);
+    pca9685_dev_read_register(devs[0], PCA9685_MODE1, &mode1);
     mode1 &= ~(1 << 4); // Clear sleep bit
-    pca9685_write_register(I2C_MASTER_NUM, I2C_PCA9685_ADDR, PCA9685_MODE1, mode1);
+    pca9685_dev_write_register(devs[0], PCA9685_MODE1, mode1);
     vTaskDelay(pdMS_TO_TICKS(10)); // Give time to restart PWM generator
     printf("PCA9685 MODE1 register after wake-up: 0x%02X\n", mode1);
 }
 
-esp_err_t pca9685_read_register(i2c_port_t i2c_num, uint8_t device_addr, uint8_t reg, uint8_t *data) {
-    return i2c_master_write_read_device(i2c_num, device_addr, &reg, 1, data, 1, 1000 / portTICK_PERIOD_MS);
+esp_err_t pca9685_dev_read_register(pca9685_dev_t *dev, uint8_t reg, uint8_t *data) {
+    return dev_read(dev, reg, data);
 }
 
-esp_err_t pca9685_write_register(i2c_port_t i2c_num, uint8_t device_addr, uint8_t reg, uint8_t value) {
-    uint8_t data[2] = {reg, value};
-    return i2c_master_write_to_device(i2c_num, device_addr, data, 2, 1000 / portTICK_PERIOD_MS);
+esp_err_t pca9685_dev_write_register(pca9685_dev_t *dev, uint8_t reg, uint8_t value) {
+    return dev_write(dev, reg, value);
 }
 
-void sinewave_servo_task(void *arg) {
-    const float frequency = 2 * M_PI / (WAVE_PERIOD_MS / 1000.0); 
-    const float amplitude = (SERVO_MAX_ANGLE - SERVO_MIN_ANGLE) / 2.0;
-    const float midpoint = (SERVO_MAX_ANGLE + SERVO_MIN_ANGLE) / 2.0;
+// Quarter-wave sine in Q15, 64 steps from 0 to 90 degrees.
+static const int16_t quarter_sine[65] = {
+        0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+     6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767,
+};
+
+// Q15 sine of a phase given as a fraction of a full turn (0 - 255).
+static int32_t isin256(uint8_t phase) {
+    uint8_t idx = phase & 0x3F;
+    switch (phase >> 6) {
+        case 0:  return  quarter_sine[idx];
+        case 1:  return  quarter_sine[64 - idx];
+        case 2:  return -quarter_sine[idx];
+        default: return -quarter_sine[64 - idx];
+    }
+}
+
+void pca9685_sine_angles(uint8_t phase, uint16_t *angle_dd, uint16_t count) {
+    const int32_t amplitude_dd = (SERVO_MAX_ANGLE - SERVO_MIN_ANGLE) * PCA9685_ANGLE_SCALE / 2;
+    const int32_t midpoint_dd = (SERVO_MAX_ANGLE + SERVO_MIN_ANGLE) * PCA9685_ANGLE_SCALE / 2;
 
+    // Each servo is shifted by 30 degrees.
+    for (int i = 0; i < count; i++) {
+        uint8_t shifted = phase + (uint8_t)((i * 256) / 12);
+        angle_dd[i] = midpoint_dd + ((amplitude_dd * isin256(shifted)) >> 15);
+    }
+}
+
+void sinewave_servo_task(void *arg) {
     int64_t start_time = esp_timer_get_time();  // start time in microseconds
 
     while (1) { 
         int64_t current_time = esp_timer_get_time();  // current time in microseconds
-        int elapsed_time_ms = (current_time - start_time) / 1000;  // convert to milliseconds
+        int64_t elapsed_time_ms = (current_time - start_time) / 1000;  // convert to milliseconds
 
-        for (int i = 0; i < 6; i++) { // apply phase shift to each servo
-            float phase_shift = (i * 30.0) * (M_PI / 180.0); 
-            float angle = midpoint + amplitude * sin(frequency * (elapsed_time_ms / 1000.0) + phase_shift);
-            pca9685_set_servo_angle(i, angle);
-        }
+        // Phase in 1/256ths of a turn.
+        uint8_t phase = (uint8_t)(((elapsed_time_ms % WAVE_PERIOD_MS) * 256) / WAVE_PERIOD_MS);
+        uint16_t angles[NUM_SERVOS];
+        pca9685_sine_angles(phase, angles, NUM_SERVOS);
+        pca9685_set_servos_dd(angles, NUM_SERVOS);
 
-        vTaskDelay(pdMS_TO_TICKS(5)); 
+        vTaskDelay(pdMS_TO_TICKS(5));
     }
-}
\ No newline at end of file
+}
@@ -1,8 +1,9 @@
 #ifndef PCA9685_H
 #define PCA9685_H
 
-#include "driver/i2c.h"
+#include "driver/i2c_master.h"
 #include "esp_log.h"
+#include "i2c_bus.h"
 
 #define I2C_MASTER_SCL_IO 17
 #define I2C_MASTER_SDA_IO 18
@@ -11,9 +12,31 @@
 #define I2C_PCA9685_ADDR 0x40
 
 #define PCA9685_MODE1 0x00
+#define PCA9685_MODE1_SLEEP 0x10
+#define PCA9685_SUBADR1 0x02
+#define PCA9685_SUBADR1_DEFAULT 0xE2
 #define PCA9685_PRESCALE 0xFE
 #define PCA9685_LED0_ON_L 0x06
+#define PCA9685_ALL_LED_ON_L 0xFA
+#define PCA9685_NUM_CHANNELS 16
 
+/* Several boards can share the bus. Board addresses run from 0x40 to 0x7F
+** (six address pins); 0x70 is the LED All Call address every board answers
+** by default, so it is never taken for a board. Channels are numbered
+** globally, board by board in address order: channel c is output c % 16 of
+** board c / 16.
+*/
+#define PCA9685_ADDR_FIRST 0x40
+#define PCA9685_ADDR_LAST 0x7F
+#define PCA9685_ALLCALL_ADDR 0x70
+#define PCA9685_MAX_DEVICES 8
+#define PCA9685_MAX_CHANNELS (PCA9685_MAX_DEVICES * PCA9685_NUM_CHANNELS)
+
+// Init polls MODE1 instead of sleeping; the oscillator needs 500 us after SLEEP is cleared (datasheet 7.3.1.1).
+#define PCA9685_OSC_STARTUP_US 500
+#define PCA9685_INIT_TIMEOUT_US 10000
+
+// Default calibration, used for any channel without a calibration stored in NVS.
 #define SERVO_MIN 100
 #define SERVO_MAX 500
 #define SERVO_MIN_ANGLE 0
@@ -29,14 +52,79 @@
 #define SERVO5 4
 #define SERVO6 5
 
+// Servo angles are handled internally in tenths of a degree (0 - 1800).
+#define PCA9685_ANGLE_SCALE     10
+#define PCA9685_ANGLE_MAX_DD    (SERVO_MAX_ANGLE * PCA9685_ANGLE_SCALE)
+
+#define PCA9685_NVS_NAMESPACE   "pca9685"
+#define PCA9685_NVS_CAL_KEY     "cal"      // board at I2C_PCA9685_ADDR; others use "cal_<addr hex>"
+#define PCA9685_NVS_BOARDS_KEY  "boards"   // addresses found by the last full scan
+
+// Per-channel servo calibration, stored in NVS as one blob per board.
+typedef struct {
+    uint16_t min_pulse;  // OFF count at 0 degrees
+    uint16_t max_pulse;  // OFF count at 180 degrees
+    int16_t trim_dd;     // center trim, added to the commanded angle (tenths of a degree)
+    uint8_t invert;      // 1 if the servo is mounted mirrored
+    uint8_t reserved;
+} pca9685_cal_t;
+
+// Handle for one board; see pca9685_open().
+typedef struct pca9685_dev pca9685_dev_t;
+
+// Counters for PCA9685 output writes that were issued to the bus or elided by the shadow registers.
+typedef struct {
+    uint32_t writes_issued;  // LEDn blocks written
+    uint32_t writes_elided;  // LEDn blocks skipped because the pulse was unchanged
+    uint32_t transactions;   // I2C transactions queued for LEDn writes
+    uint32_t write_errors;   // queued LEDn writes that failed on the bus (and were retried)
+} pca9685_stats_t;
+
 void i2c_master_init();
+
+// Find every board on the bus, open each one, and number their channels.
 void pca9685_init();
-void pca9685_set_servo_angle(uint8_t channel, float angle);
-void set_full_pwm(uint8_t channel);
+// Board addresses, from the cache unless rescan is set; returns how many were written to addrs.
+int pca9685_enumerate(uint8_t *addrs, int max, uint8_t rescan);
+esp_err_t pca9685_open(uint8_t addr, pca9685_dev_t **out);
+int pca9685_num_devices();
+int pca9685_num_channels();
+pca9685_dev_t *pca9685_get_device(int index);
+uint8_t pca9685_dev_addr(const pca9685_dev_t *dev);
+
+// Per-board access; channel is the board's own output, 0 - 15.
+void pca9685_dev_stage_pulse(pca9685_dev_t *dev, uint8_t channel, uint16_t pulse);
+esp_err_t pca9685_dev_flush(pca9685_dev_t *dev);
+esp_err_t pca9685_dev_cal_load(pca9685_dev_t *dev);
+esp_err_t pca9685_dev_all_off(pca9685_dev_t *dev);
+// Raw register access through the board's bus handle.
+esp_err_t pca9685_dev_read_register(pca9685_dev_t *dev, uint8_t reg, uint8_t *data);
+esp_err_t pca9685_dev_write_register(pca9685_dev_t *dev, uint8_t reg, uint8_t value);
+
+// Everything below takes global channel indices and spans all boards.
+void pca9685_set_servo_angle(uint16_t channel, float angle);
+esp_err_t pca9685_set_servos(const float *angles, uint16_t count);
+esp_err_t pca9685_set_servos_dd(const uint16_t *angle_dd, uint16_t count);
+esp_err_t pca9685_set_all_servos(float angle);
+uint16_t pca9685_angle_to_pulse(uint16_t channel, uint16_t angle_dd);
+esp_err_t pca9685_cal_load();
+esp_err_t pca9685_cal_save();
+esp_err_t pca9685_set_calibration(uint16_t channel, const pca9685_cal_t *cal);
+void pca9685_get_calibration(uint16_t channel, pca9685_cal_t *out);
+esp_err_t pca9685_all_off();
+void pca9685_stage_pulse(uint16_t channel, uint16_t pulse);
+// One queued burst per board with dirty channels.
+esp_err_t pca9685_flush();
+// Run cb from the bus engine once every servo write queued so far is on the wire.
+esp_err_t pca9685_when_done(i2c_bus_cb_t cb, void *arg);
+void pca9685_get_stats(pca9685_stats_t *out);
+// Last pulse staged for each of the first count channels, 0xFFFF where none was written yet.
+void pca9685_get_pulses(uint16_t *out, uint16_t count);
+void set_full_pwm(uint16_t channel);
 uint8_t read_pca9685_mode1();
 void force_wake_up();
-esp_err_t pca9685_read_register(i2c_port_t i2c_num, uint8_t device_addr, uint8_t reg, uint8_t *data);
-esp_err_t pca9685_write_register(i2c_port_t i2c_num, uint8_t device_addr, uint8_t reg, uint8_t value);
+// Angles of the sine sweep at phase (1/256ths of a turn), each channel 30 degrees behind the last.
+void pca9685_sine_angles(uint8_t phase, uint16_t *angle_dd, uint16_t count);
 void sinewave_servo_task(void *arg);
 
 #endif
\ No newline at end of file
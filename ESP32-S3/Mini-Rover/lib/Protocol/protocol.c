@@ -0,0 +1,329 @@
+#include "protocol.h"
+
+// Expected payload length for each command type, -1 if the rover does not accept the type.
+static int payload_len_for(uint8_t type) {
+    switch (type) {
+        case ROVER_MSG_SERVO:
+            return ROVER_NUM_SERVOS * sizeof(uint16_t);
+        case ROVER_MSG_MOTOR:
+            return ROVER_NUM_MOTORS * sizeof(int16_t);
+        case ROVER_MSG_STEER:
+            return sizeof(int16_t);
+        case ROVER_MSG_DRIVE:
+            return ROVER_DRIVE_LEN;
+        case ROVER_MSG_STATS_QUERY:
+        case ROVER_MSG_TELEMETRY_SUB:
+        case ROVER_MSG_PROF_QUERY:
+            return 0;
+        case ROVER_MSG_LOG_READ:
+            return ROVER_LOG_READ_LEN;
+        default:
+            return -1;
+    }
+}
+
+/* Fletcher-16. The modulo is deferred and applied once per block, which is
+** safe for blocks of up to 5802 bytes without overflowing 32 bits.
+*/
+uint16_t rover_checksum(const uint8_t *data, size_t len) {
+    uint32_t sum1 = 0, sum2 = 0;
+    while (len > 0) {
+        size_t block = len > 5802 ? 5802 : len;
+        len -= block;
+        while (block--) {
+            sum1 += *data++;
+            sum2 += sum1;
+        }
+        sum1 %= 255;
+        sum2 %= 255;
+    }
+    return (uint16_t)((sum2 << 8) | sum1);
+}
+
+rover_proto_err_t rover_decode_binary(const uint8_t *buf, size_t len, rover_cmd_t *cmd) {
+    if (len < ROVER_PROTO_HEADER_LEN + ROVER_PROTO_CRC_LEN) {
+        return ROVER_PROTO_ERR_SHORT;
+    }
+    if (buf[0] != ROVER_PROTO_MAGIC) {
+        return ROVER_PROTO_ERR_TYPE;
+    }
+    if (buf[1] != ROVER_PROTO_VERSION && buf[1] != ROVER_PROTO_VERSION_SEQ) {
+        return ROVER_PROTO_ERR_VERSION;
+    }
+    size_t hlen = ROVER_PROTO_HEADER_LEN + (buf[1] == ROVER_PROTO_VERSION_SEQ ? ROVER_PROTO_SEQ_LEN : 0);
+
+    uint8_t type = buf[2];
+    size_t plen = buf[3];
+    int expected = payload_len_for(type);
+    if (expected < 0) {
+        return ROVER_PROTO_ERR_TYPE;
+    }
+    if (plen != (size_t)expected) {
+        return ROVER_PROTO_ERR_LENGTH;
+    }
+    if (len < hlen + plen + ROVER_PROTO_CRC_LEN) {
+        return ROVER_PROTO_ERR_SHORT;
+    }
+
+    const uint8_t *payload = buf + hlen;
+    if (rover_checksum(buf, hlen + plen) != get_u16le(payload + plen)) {
+        return ROVER_PROTO_ERR_CHECKSUM;
+    }
+
+    rover_cmd_t out;
+    out.type = (rover_msg_type_t)type;
+    out.has_seq = hlen > ROVER_PROTO_HEADER_LEN;
+    out.seq = out.has_seq ? get_u16le(buf + ROVER_PROTO_HEADER_LEN) : 0;
+    out.t_us = out.has_seq ? get_u32le(buf + ROVER_PROTO_HEADER_LEN + 2) : 0;
+    switch (type) {
+        case ROVER_MSG_SERVO:
+            for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+                out.servo.angle_dd[i] = get_u16le(payload + 2 * i);
+                if (out.servo.angle_dd[i] > ROVER_ANGLE_MAX_DD) {
+                    return ROVER_PROTO_ERR_RANGE;
+                }
+            }
+            break;
+        case ROVER_MSG_MOTOR:
+            for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+                out.motor.speed[i] = (int16_t)get_u16le(payload + 2 * i);
+            }
+            break;
+        case ROVER_MSG_STEER:
+            out.steer.steer = (int16_t)get_u16le(payload);
+            if (out.steer.steer < -32767) {
+                return ROVER_PROTO_ERR_RANGE;
+            }
+            break;
+        case ROVER_MSG_DRIVE:
+            out.drive.seq = get_u16le(payload);
+            out.drive.flags = payload[2];
+            out.drive.t_us = get_u32le(payload + 4);
+            out.drive.steer = (int16_t)get_u16le(payload + 8);
+            out.drive.speed = (int16_t)get_u16le(payload + 10);
+            if (out.drive.steer < -32767) {
+                return ROVER_PROTO_ERR_RANGE;
+            }
+            out.has_seq = true;
+            out.seq = out.drive.seq;
+            out.t_us = out.drive.t_us;
+            break;
+        case ROVER_MSG_LOG_READ:
+            out.log_read.offset = get_u32le(payload);
+            out.log_read.len = get_u16le(payload + 4);
+            break;
+        default:
+            break;
+    }
+
+    *cmd = out;
+    return ROVER_PROTO_OK;
+}
+
+/* Parse a comma-separated list of exactly n signed decimal integers starting
+** at *p. Trailing whitespace (e.g. a newline from netcat) is allowed.
+*/
+static rover_proto_err_t parse_int_list(const char *p, const char *end, int32_t *vals, int n) {
+    for (int i = 0; i < n; i++) {
+        if (p >= end || *p != ',') {
+            return ROVER_PROTO_ERR_SYNTAX;
+        }
+        p++;
+
+        int neg = 0;
+        if (p < end && (*p == '-' || *p == '+')) {
+            neg = (*p == '-');
+            p++;
+        }
+        if (p >= end || *p < '0' || *p > '9') {
+            return ROVER_PROTO_ERR_SYNTAX;
+        }
+
+        int32_t v = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            v = v * 10 + (*p - '0');
+            if (v > 32767) {
+                return ROVER_PROTO_ERR_RANGE;
+            }
+            p++;
+        }
+        vals[i] = neg ? -v : v;
+    }
+
+    while (p < end && (*p == ' ' || *p == '\r' || *p == '\n' || *p == '\0')) {
+        p++;
+    }
+    return p == end ? ROVER_PROTO_OK : ROVER_PROTO_ERR_SYNTAX;
+}
+
+rover_proto_err_t rover_decode_text(const char *buf, size_t len, rover_cmd_t *cmd) {
+    if (len < 1) {
+        return ROVER_PROTO_ERR_SHORT;
+    }
+
+    const char *end = buf + len;
+    int32_t vals[ROVER_NUM_SERVOS];
+    rover_proto_err_t err;
+    rover_cmd_t out;
+    out.has_seq = false;
+    out.seq = 0;
+    out.t_us = 0;
+
+    switch (buf[0]) {
+        case 'S':
+            err = parse_int_list(buf + 1, end, vals, ROVER_NUM_SERVOS);
+            if (err != ROVER_PROTO_OK) {
+                return err;
+            }
+            out.type = ROVER_MSG_SERVO;
+            for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+                if (vals[i] < 0 || vals[i] > 180) {
+                    return ROVER_PROTO_ERR_RANGE;
+                }
+                out.servo.angle_dd[i] = (uint16_t)(vals[i] * ROVER_ANGLE_SCALE);
+            }
+            break;
+        case 'M':
+            err = parse_int_list(buf + 1, end, vals, 1);
+            if (err != ROVER_PROTO_OK) {
+                return err;
+            }
+            out.type = ROVER_MSG_MOTOR;
+            for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+                out.motor.speed[i] = (int16_t)vals[0];
+            }
+            break;
+        case 'A':
+            err = parse_int_list(buf + 1, end, vals, 1);
+            if (err != ROVER_PROTO_OK) {
+                return err;
+            }
+            if (vals[0] < -32767) {
+                return ROVER_PROTO_ERR_RANGE;
+            }
+            out.type = ROVER_MSG_STEER;
+            out.steer.steer = (int16_t)vals[0];
+            break;
+        case 'Q':
+            err = parse_int_list(buf + 1, end, vals, 0);
+            if (err != ROVER_PROTO_OK) {
+                return err;
+            }
+            out.type = ROVER_MSG_STATS_QUERY;
+            break;
+        case 'T':
+            err = parse_int_list(buf + 1, end, vals, 0);
+            if (err != ROVER_PROTO_OK) {
+                return err;
+            }
+            out.type = ROVER_MSG_TELEMETRY_SUB;
+            break;
+        case 'P':
+            err = parse_int_list(buf + 1, end, vals, 0);
+            if (err != ROVER_PROTO_OK) {
+                return err;
+            }
+            out.type = ROVER_MSG_PROF_QUERY;
+            break;
+        default:
+            return ROVER_PROTO_ERR_TYPE;
+    }
+
+    *cmd = out;
+    return ROVER_PROTO_OK;
+}
+
+rover_proto_err_t rover_decode(const uint8_t *buf, size_t len, rover_cmd_t *cmd) {
+    if (len < 1) {
+        return ROVER_PROTO_ERR_SHORT;
+    }
+    if (buf[0] == ROVER_PROTO_MAGIC) {
+        return rover_decode_binary(buf, len, cmd);
+    }
+    return rover_decode_text((const char *)buf, len, cmd);
+}
+
+// Frame a payload, with a version 2 sequence header when seq is non-NULL.
+static size_t encode_frame(uint8_t type, const uint16_t *seq, uint32_t t_us, const uint8_t *payload, size_t plen, uint8_t *buf, size_t cap) {
+    size_t hlen = ROVER_PROTO_HEADER_LEN + (seq ? ROVER_PROTO_SEQ_LEN : 0);
+    size_t total = hlen + plen + ROVER_PROTO_CRC_LEN;
+    if (plen > ROVER_PROTO_MAX_PAYLOAD || cap < total) {
+        return 0;
+    }
+
+    buf[0] = ROVER_PROTO_MAGIC;
+    buf[1] = seq ? ROVER_PROTO_VERSION_SEQ : ROVER_PROTO_VERSION;
+    buf[2] = type;
+    buf[3] = (uint8_t)plen;
+    if (seq) {
+        put_u16le(buf + ROVER_PROTO_HEADER_LEN, *seq);
+        put_u32le(buf + ROVER_PROTO_HEADER_LEN + 2, t_us);
+    }
+    for (size_t i = 0; i < plen; i++) {
+        buf[hlen + i] = payload[i];
+    }
+    put_u16le(buf + hlen + plen, rover_checksum(buf, hlen + plen));
+    return total;
+}
+
+size_t rover_encode_frame(uint8_t type, const uint8_t *payload, size_t plen, uint8_t *buf, size_t cap) {
+    return encode_frame(type, NULL, 0, payload, plen, buf, cap);
+}
+
+size_t rover_encode(const rover_cmd_t *cmd, uint8_t *buf, size_t cap) {
+    int plen = payload_len_for(cmd->type);
+    if (plen < 0) {
+        return 0;
+    }
+
+    uint8_t payload[ROVER_PROTO_MAX_PAYLOAD];
+    switch (cmd->type) {
+        case ROVER_MSG_SERVO:
+            for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+                put_u16le(payload + 2 * i, cmd->servo.angle_dd[i]);
+            }
+            break;
+        case ROVER_MSG_MOTOR:
+            for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+                put_u16le(payload + 2 * i, (uint16_t)cmd->motor.speed[i]);
+            }
+            break;
+        case ROVER_MSG_STEER:
+            put_u16le(payload, (uint16_t)cmd->steer.steer);
+            break;
+        case ROVER_MSG_DRIVE:
+            put_u16le(payload, cmd->drive.seq);
+            payload[2] = cmd->drive.flags;
+            payload[3] = 0;
+            put_u32le(payload + 4, cmd->drive.t_us);
+            put_u16le(payload + 8, (uint16_t)cmd->drive.steer);
+            put_u16le(payload + 10, (uint16_t)cmd->drive.speed);
+            break;
+        default:
+            break;
+    }
+    bool seq_header = cmd->has_seq && cmd->type != ROVER_MSG_DRIVE;
+    return encode_frame(cmd->type, seq_header ? &cmd->seq : NULL, cmd->t_us, payload, plen, buf, cap);
+}
+
+size_t rover_encode_drive_echo(const rover_cmd_t *drive, uint8_t *buf, size_t cap) {
+    uint8_t payload[ROVER_DRIVE_ECHO_LEN];
+    put_u16le(payload, drive->drive.seq);
+    put_u16le(payload + 2, 0);
+    put_u32le(payload + 4, drive->drive.t_us);
+    return rover_encode_frame(ROVER_MSG_DRIVE_ECHO, payload, sizeof(payload), buf, cap);
+}
+
+const char *rover_proto_err_str(rover_proto_err_t err) {
+    switch (err) {
+        case ROVER_PROTO_OK:           return "ok";
+        case ROVER_PROTO_ERR_SHORT:    return "short frame";
+        case ROVER_PROTO_ERR_VERSION:  return "bad version";
+        case ROVER_PROTO_ERR_TYPE:     return "unknown type";
+        case ROVER_PROTO_ERR_LENGTH:   return "bad length";
+        case ROVER_PROTO_ERR_CHECKSUM: return "bad checksum";
+        case ROVER_PROTO_ERR_SYNTAX:   return "syntax error";
+        case ROVER_PROTO_ERR_RANGE:    return "out of range";
+        default:                       return "unknown error";
+    }
+}
@@ -0,0 +1,196 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+** Rover command protocol.
+**
+** Binary frame layout (all multi-byte fields little-endian):
+**
+**   offset  size  field
+**   0       1     magic (ROVER_PROTO_MAGIC)
+**   1       1     version (ROVER_PROTO_VERSION)
+**   2       1     message type (rover_msg_type_t)
+**   3       1     payload length in bytes
+**   4       n     payload
+**   4+n     2     Fletcher-16 checksum over bytes [0, 4+n)
+**
+** Version 2 frames (ROVER_PROTO_VERSION_SEQ) insert a sequence header
+** between the header and the payload; the length byte still counts only
+** the payload:
+**
+**   4       2     seq, incremented per command by the sender
+**   6       4     t_us, sender timestamp in microseconds (wraps)
+**   10      n     payload
+**
+** Any command type may be sent either way. Sequenced commands go through
+** the per-client reorder window (src/seqfilter.h); version 1 frames and
+** text commands are always applied. Replies are always version 1.
+**
+** The legacy ASCII commands ("S,a1,...,a6", "M,speed") are still accepted
+** by rover_decode() as a fallback. The magic byte is not printable ASCII so
+** the two formats can never be confused.
+**
+** ROVER_MSG_DRIVE carries steering and drive together, with a sequence
+** number and the sender's clock so the PC client can send only on change
+** and measure round-trip time:
+**
+**   offset  size  field
+**   0       2     seq, incremented per datagram by the sender
+**   2       1     flags (ROVER_DRIVE_FLAG_*)
+**   3       1     reserved, 0
+**   4       4     t_us, sender timestamp in microseconds (wraps)
+**   8       2     steer, Q15 as in ROVER_MSG_STEER
+**   10      2     speed for every wheel, -255..255
+**
+** Motor speeds (here, in ROVER_MSG_MOTOR and in "M,speed") are wheel speed
+** targets when the rover runs closed-loop speed control (src/speed.h,
+** SPEED_CONTROL): 255 is full speed, measured at the wheel. Without it they
+** are PWM duty.
+**
+** With ROVER_DRIVE_FLAG_ECHO set the rover answers with a
+** ROVER_MSG_DRIVE_ECHO holding u16 seq, u16 reserved, u32 t_us copied from
+** the request.
+**
+** ROVER_MSG_LOG_READ downloads the flight recorder partition
+** (lib/Recorder/recorder.h). The reply holds one ROVER_MSG_LOG_INFO frame
+**
+**   u32 partition_size, head_sector, head_seq, records, dropped, flash_errors
+**
+** followed by ROVER_MSG_LOG_DATA frames covering [offset, offset + len),
+** len being clipped to ROVER_LOG_READ_MAX. A len of 0 asks for the info only.
+**
+** python/rover_protocol.py mirrors this layout for the PC client; keep the
+** two in sync.
+*/
+
+#define ROVER_PROTO_MAGIC       0xA5
+#define ROVER_PROTO_VERSION     1
+#define ROVER_PROTO_VERSION_SEQ 2
+#define ROVER_PROTO_HEADER_LEN  4
+#define ROVER_PROTO_SEQ_LEN     6
+#define ROVER_PROTO_CRC_LEN     2
+#define ROVER_PROTO_MAX_PAYLOAD 255
+#define ROVER_PROTO_MAX_FRAME   (ROVER_PROTO_HEADER_LEN + ROVER_PROTO_SEQ_LEN + ROVER_PROTO_MAX_PAYLOAD + ROVER_PROTO_CRC_LEN)
+
+#define ROVER_NUM_SERVOS 6
+#define ROVER_NUM_MOTORS 6
+
+// Servo angles are carried in tenths of a degree (0 - 1800)
+#define ROVER_ANGLE_SCALE   10
+#define ROVER_ANGLE_MAX_DD  (180 * ROVER_ANGLE_SCALE)
+
+typedef enum {
+    ROVER_MSG_SERVO = 0x01,     // uint16 angle_dd[ROVER_NUM_SERVOS]
+    ROVER_MSG_MOTOR = 0x02,     // int16 speed[ROVER_NUM_MOTORS], speed targets, see above
+    ROVER_MSG_STEER = 0x03,     // int16 steer, Q15 (-32767 full left .. 32767 full right), text "A,steer"
+    ROVER_MSG_DRIVE = 0x04,     // combined steer + speed with seq and timestamp, see above
+
+    // Queries (PC -> rover) and their replies (rover -> PC). A reply may pack
+    // several frames back to back in one datagram.
+    ROVER_MSG_STATS_QUERY = 0x10,       // empty payload, text form "Q"
+    ROVER_MSG_STATS_COUNTERS = 0x11,    // see stats.h
+    ROVER_MSG_STATS_HIST = 0x12,        // see stats.h
+    ROVER_MSG_DRIVE_ECHO = 0x13,        // reply to a DRIVE with ROVER_DRIVE_FLAG_ECHO
+    ROVER_MSG_TELEMETRY_SUB = 0x14,     // empty payload, text form "T"; see src/telemetry.h
+    ROVER_MSG_TELEMETRY = 0x15,         // one telemetry sample, see src/telemetry.h
+    ROVER_MSG_LOG_READ = 0x16,          // u32 offset, u16 len: read the flight recorder, see below
+    ROVER_MSG_LOG_INFO = 0x17,          // recorder state, first frame of every LOG_READ reply
+    ROVER_MSG_LOG_DATA = 0x18,          // u32 offset, then raw partition bytes
+    ROVER_MSG_PROF_QUERY = 0x19,        // empty payload, text form "P"; see src/profiler.h
+    ROVER_MSG_PROF_SUMMARY = 0x1A,      // window, heap and per-core idle, first frame of the reply
+    ROVER_MSG_PROF_TASK = 0x1B,         // CPU load and stack high-water of one task
+    ROVER_MSG_PROF_LOOP = 0x1C,         // wake-up lateness of one periodic loop
+} rover_msg_type_t;
+
+#define ROVER_DRIVE_LEN         12
+#define ROVER_DRIVE_ECHO_LEN    8
+#define ROVER_DRIVE_FLAG_ECHO   0x01
+#define ROVER_TELEMETRY_LEN     76
+#define ROVER_LOG_READ_LEN      6
+#define ROVER_LOG_INFO_LEN      24
+#define ROVER_LOG_DATA_CHUNK    232     // partition bytes per LOG_DATA frame; a full reply fits 1 KB
+#define ROVER_LOG_READ_MAX      (4 * ROVER_LOG_DATA_CHUNK)
+
+typedef enum {
+    ROVER_PROTO_OK = 0,
+    ROVER_PROTO_ERR_SHORT,      // buffer too short for the claimed frame
+    ROVER_PROTO_ERR_VERSION,    // unsupported protocol version
+    ROVER_PROTO_ERR_TYPE,       // unknown message type / command letter
+    ROVER_PROTO_ERR_LENGTH,     // payload length does not match the type
+    ROVER_PROTO_ERR_CHECKSUM,   // checksum mismatch
+    ROVER_PROTO_ERR_SYNTAX,     // malformed text command
+    ROVER_PROTO_ERR_RANGE,      // value out of range
+} rover_proto_err_t;
+
+typedef struct {
+    rover_msg_type_t type;
+    // Sender sequence number and clock, from a version 2 header or a DRIVE payload.
+    bool has_seq;
+    uint16_t seq;
+    uint32_t t_us;
+    union {
+        struct {
+            uint16_t angle_dd[ROVER_NUM_SERVOS];
+        } servo;
+        struct {
+            int16_t speed[ROVER_NUM_MOTORS];
+        } motor;
+        struct {
+            int16_t steer;
+        } steer;
+        struct {
+            uint16_t seq;
+            uint8_t flags;
+            uint32_t t_us;
+            int16_t steer;
+            int16_t speed;
+        } drive;
+        struct {
+            uint32_t offset;
+            uint16_t len;
+        } log_read;
+    };
+} rover_cmd_t;
+
+// Decode either a binary frame or a legacy text command. On error *cmd is left untouched.
+rover_proto_err_t rover_decode(const uint8_t *buf, size_t len, rover_cmd_t *cmd);
+rover_proto_err_t rover_decode_binary(const uint8_t *buf, size_t len, rover_cmd_t *cmd);
+rover_proto_err_t rover_decode_text(const char *buf, size_t len, rover_cmd_t *cmd);
+
+// Encode cmd as a binary frame, version 2 if it has_seq (except DRIVE, which
+// carries its own). Returns the frame length, or 0 if cap is too small.
+size_t rover_encode(const rover_cmd_t *cmd, uint8_t *buf, size_t cap);
+
+// Wrap an arbitrary payload in a frame. Returns the frame length, or 0 if it does not fit.
+size_t rover_encode_frame(uint8_t type, const uint8_t *payload, size_t plen, uint8_t *buf, size_t cap);
+
+// Encode the ROVER_MSG_DRIVE_ECHO answer to a decoded drive command. Returns the frame length, or 0.
+size_t rover_encode_drive_echo(const rover_cmd_t *drive, uint8_t *buf, size_t cap);
+
+uint16_t rover_checksum(const uint8_t *data, size_t len);
+const char *rover_proto_err_str(rover_proto_err_t err);
+
+// Little-endian field access, for payloads and everything else the rover serialises.
+static inline uint16_t get_u16le(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void put_u16le(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static inline uint32_t get_u32le(const uint8_t *p) {
+    return (uint32_t)get_u16le(p) | ((uint32_t)get_u16le(p + 2) << 16);
+}
+
+static inline void put_u32le(uint8_t *p, uint32_t v) {
+    put_u16le(p, v & 0xFFFF);
+    put_u16le(p + 2, v >> 16);
+}
+
+#endif
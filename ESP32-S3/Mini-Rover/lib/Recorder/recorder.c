@@ -0,0 +1,261 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "recorder.h"
+#include "protocol.h"
+
+static const char *TAG = "RECORDER";
+
+// A run of bytes bound for one sector, starting at offset within it.
+typedef struct {
+    uint32_t sector;
+    uint32_t offset;
+    uint32_t len;
+    bool erased;                // sector came from the pre-erased pool
+    uint8_t data[RECORDER_SECTOR_SIZE];
+} stage_t;
+
+static const esp_partition_t *part;
+static uint32_t num_sectors;
+static TaskHandle_t writer;
+static atomic_bool hold;
+
+/* Everything below is guarded by lock. Appends only touch stage[active];
+** the writer task owns stage[pending] until it clears pending, so the flash
+** write itself runs outside the lock.
+*/
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static stage_t stage[2];
+static int active = 0;
+static int pending = -1;
+static uint32_t head_sector, head_seq;
+static uint32_t fill;           // bytes of the head sector used, written or staged
+static uint32_t erased_ahead;   // sectors after the head already erased
+static uint32_t records, dropped, flash_errors;
+
+// Give the active buffer to the writer. False if the writer still holds the other one.
+static bool hand_off_locked() {
+    stage_t *s = &stage[active];
+    if (s->len == 0) {
+        return true;
+    }
+    if (pending >= 0) {
+        return false;
+    }
+    pending = active;
+    active ^= 1;
+    stage[active].sector = s->sector;
+    stage[active].offset = s->offset + s->len;
+    stage[active].len = 0;
+    stage[active].erased = true;    // a continuation never erases
+    return true;
+}
+
+// Start the next sector in the active buffer, header first.
+static void open_sector_locked(uint32_t sector, uint32_t seq, bool erased) {
+    stage_t *s = &stage[active];
+    head_sector = sector;
+    head_seq = seq;
+    s->sector = sector;
+    s->offset = 0;
+    s->erased = erased;
+    put_u32le(s->data, RECORDER_MAGIC);
+    put_u32le(s->data + 4, seq);
+    s->len = RECORDER_SECTOR_HEADER_LEN;
+    fill = RECORDER_SECTOR_HEADER_LEN;
+}
+
+void recorder_write(uint8_t type, const void *data, size_t len) {
+    if (part == NULL) {
+        return;
+    }
+    if (len > RECORDER_MAX_PAYLOAD) {
+        len = RECORDER_MAX_PAYLOAD;
+    }
+    uint32_t ts = (uint32_t)esp_timer_get_time();
+    uint32_t need = RECORDER_REC_HEADER_LEN + len;
+    bool wake = false;
+
+    portENTER_CRITICAL(&lock);
+    if (fill + need > RECORDER_SECTOR_SIZE) {
+        bool erased = erased_ahead > 0;
+        if ((!erased && atomic_load(&hold)) || !hand_off_locked()) {
+            dropped++;
+            portEXIT_CRITICAL(&lock);
+            return;
+        }
+        if (erased) {
+            erased_ahead--;
+        }
+        wake = true;
+        open_sector_locked((head_sector + 1) % num_sectors, head_seq + 1, erased);
+    }
+    stage_t *s = &stage[active];
+    uint8_t *p = s->data + s->len;
+    put_u32le(p, ts);
+    p[4] = type;
+    p[5] = (uint8_t)len;
+    if (len) {
+        memcpy(p + RECORDER_REC_HEADER_LEN, data, len);
+    }
+    s->len += need;
+    fill += need;
+    records++;
+    portEXIT_CRITICAL(&lock);
+
+    if (wake) {
+        xTaskNotifyGive(writer);
+    }
+}
+
+// Erase the next sector past the pool, unless held or the pool is full. True if it erased one.
+static bool erase_ahead() {
+    portENTER_CRITICAL(&lock);
+    uint32_t sector = (head_sector + 1 + erased_ahead) % num_sectors;
+    bool want = !atomic_load(&hold) && erased_ahead < RECORDER_ERASE_AHEAD && erased_ahead + 2 < num_sectors;
+    portEXIT_CRITICAL(&lock);
+    if (!want) {
+        return false;
+    }
+
+    esp_err_t err = esp_partition_erase_range(part, sector * RECORDER_SECTOR_SIZE, RECORDER_SECTOR_SIZE);
+    portENTER_CRITICAL(&lock);
+    if (err != ESP_OK) {
+        flash_errors++;
+    } else if (sector == (head_sector + 1 + erased_ahead) % num_sectors) {
+        erased_ahead++;
+    }
+    // Otherwise the head moved onto an unerased sector meanwhile; its own write erases it again.
+    portEXIT_CRITICAL(&lock);
+    return true;
+}
+
+/* Writes handed-off buffers. A sector not taken from the pool is erased just
+** before its first bytes go out; the pool is refilled one sector per
+** RECORDER_ERASE_PACE_MS while nothing is pending.
+*/
+static void recorder_task(void *arg) {
+    int64_t flushed_us = esp_timer_get_time();
+    TickType_t wait = pdMS_TO_TICKS(RECORDER_FLUSH_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, wait);
+        int64_t now_us = esp_timer_get_time();
+        bool flush = now_us - flushed_us >= RECORDER_FLUSH_MS * 1000LL;
+        portENTER_CRITICAL(&lock);
+        if (flush) {
+            hand_off_locked();
+        }
+        int idx = pending;
+        portEXIT_CRITICAL(&lock);
+        if (flush) {
+            flushed_us = now_us;
+        }
+        if (idx < 0) {
+            int64_t wait_ms = erase_ahead() ? RECORDER_ERASE_PACE_MS : RECORDER_FLUSH_MS;
+            int64_t flush_in_ms = (flushed_us - esp_timer_get_time()) / 1000 + RECORDER_FLUSH_MS;
+            if (flush_in_ms < wait_ms) {
+                wait_ms = flush_in_ms > 0 ? flush_in_ms : 0;
+            }
+            wait = pdMS_TO_TICKS(wait_ms);
+            continue;
+        }
+        wait = 0;
+
+        stage_t *s = &stage[idx];
+        uint32_t base = s->sector * RECORDER_SECTOR_SIZE;
+        esp_err_t err = ESP_OK;
+        if (s->offset == 0 && !s->erased) {
+            err = esp_partition_erase_range(part, base, RECORDER_SECTOR_SIZE);
+        }
+        if (err == ESP_OK) {
+            err = esp_partition_write(part, base + s->offset, s->data, s->len);
+        }
+
+        portENTER_CRITICAL(&lock);
+        if (err != ESP_OK) {
+            flash_errors++;
+        }
+        s->len = 0;
+        pending = -1;
+        portEXIT_CRITICAL(&lock);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Sector %lu write failed: %s", (unsigned long)s->sector, esp_err_to_name(err));
+        }
+    }// end while
+}
+
+esp_err_t recorder_init() {
+    const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, RECORDER_PARTITION_LABEL);
+    if (p == NULL) {
+        ESP_LOGE(TAG, "No \"%s\" partition", RECORDER_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    num_sectors = p->size / RECORDER_SECTOR_SIZE;
+    if (num_sectors < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // The newest sector is the one with the highest sequence number, compared with wrap-around.
+    bool found = false;
+    uint32_t newest = 0, newest_seq = 0;
+    for (uint32_t i = 0; i < num_sectors; i++) {
+        uint8_t hdr[RECORDER_SECTOR_HEADER_LEN];
+        if (esp_partition_read(p, i * RECORDER_SECTOR_SIZE, hdr, sizeof(hdr)) != ESP_OK || get_u32le(hdr) != RECORDER_MAGIC) {
+            continue;
+        }
+        uint32_t seq = get_u32le(hdr + 4);
+        if (!found || (int32_t)(seq - newest_seq) > 0) {
+            found = true;
+            newest = i;
+            newest_seq = seq;
+        }
+    }
+
+    portENTER_CRITICAL(&lock);
+    if (found) {
+        open_sector_locked((newest + 1) % num_sectors, newest_seq + 1, false);
+    } else {
+        open_sector_locked(0, 0, false);
+    }
+    erased_ahead = 0;
+    portEXIT_CRITICAL(&lock);
+
+    part = p;
+    if (xTaskCreatePinnedToCore(recorder_task, "recorder", RECORDER_TASK_STACK, NULL, RECORDER_TASK_PRIORITY, &writer, RECORDER_TASK_CORE) != pdPASS) {
+        part = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "%lu sectors, resuming at sector %lu (seq %lu)", (unsigned long)num_sectors, (unsigned long)head_sector, (unsigned long)head_seq);
+    RECORD(REC_BOOT, NULL, 0);
+    return ESP_OK;
+}
+
+void recorder_hold_erase(bool h) {
+    atomic_store(&hold, h);
+}
+
+void recorder_get_info(recorder_info_t *out) {
+    portENTER_CRITICAL(&lock);
+    out->partition_size = part ? part->size : 0;
+    out->head_sector = head_sector;
+    out->head_seq = head_seq;
+    out->records = records;
+    out->dropped = dropped;
+    out->flash_errors = flash_errors;
+    portEXIT_CRITICAL(&lock);
+}
+
+esp_err_t recorder_read(uint32_t offset, void *dst, size_t len) {
+    if (part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (offset > part->size || len > part->size - offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return esp_partition_read(part, offset, dst, len);
+}
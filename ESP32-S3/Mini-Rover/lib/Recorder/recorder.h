@@ -0,0 +1,111 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+** Append-only flight recorder in the "recorder" flash partition.
+**
+** RECORD() copies a small timestamped record into a RAM staging buffer under
+** a short critical section and returns; it never touches flash. A writer
+** task hands full buffers (or, every RECORDER_FLUSH_MS, partly filled ones)
+** to flash while appends go to the other buffer. If both buffers are busy
+** the record is dropped and counted rather than waiting for the writer.
+**
+** A sector erase takes tens of milliseconds and, without
+** CONFIG_SPI_FLASH_AUTO_SUSPEND, disables the flash cache on both cores for
+** all of it: esp_timer callbacks and every task running from flash stall.
+** So the writer erases ahead of the head, up to RECORDER_ERASE_AHEAD
+** sectors, only while recorder_hold_erase() is off (the rover is standing
+** still). While it is on, new sectors come from that pool; once the pool
+** runs out, records are dropped until the hold is released.
+**
+** The partition is a ring of RECORDER_SECTOR_SIZE sectors. Each sector
+** starts with an 8-byte header, u32 RECORDER_MAGIC and u32 sequence number
+** (one higher for every sector written, never reused), followed by packed
+** records:
+**
+**   offset  size
+**   0       4     ts_us, esp_timer time (wraps every ~71 minutes)
+**   4       1     type (recorder_type_t)
+**   5       1     payload length n
+**   6       n     payload
+**
+** Records never span sectors; a type byte of 0xFF marks the erased tail of
+** a sector. On boot the newest sector is found from the headers and logging
+** resumes in the sector after it, so the oldest sector is erased each time
+** the log wraps. A REC_BOOT record starts every boot.
+**
+** Build with -DRECORDER_ENABLE=0 to compile every RECORD() call out.
+*/
+
+#ifndef RECORDER_ENABLE
+#define RECORDER_ENABLE 1
+#endif
+
+#ifndef RECORDER_FLUSH_MS
+#define RECORDER_FLUSH_MS 1000
+#endif
+
+// Pre-erased sectors kept ahead of the head: ~1 s of driving each at the 200 Hz output rate.
+#ifndef RECORDER_ERASE_AHEAD
+#define RECORDER_ERASE_AHEAD 32
+#endif
+
+// Gap between pool refill erases, so one refill does not stall the loops back to back.
+#ifndef RECORDER_ERASE_PACE_MS
+#define RECORDER_ERASE_PACE_MS 50
+#endif
+
+#define RECORDER_PARTITION_LABEL "recorder"
+#define RECORDER_SECTOR_SIZE 4096
+#define RECORDER_MAGIC 0x474F4C52     // "RLOG"
+#define RECORDER_SECTOR_HEADER_LEN 8
+#define RECORDER_REC_HEADER_LEN 6
+#define RECORDER_MAX_PAYLOAD 255
+
+#define RECORDER_TASK_STACK 3072
+#define RECORDER_TASK_PRIORITY 2
+#define RECORDER_TASK_CORE 0
+
+// Record types. python/log_download.py and host/log_replay.c decode them.
+typedef enum {
+    REC_BOOT = 1,       // empty
+    REC_CMD,            // u32 ip, u16 port (network order as received), raw datagram
+    REC_SERVO,          // u16 angle_dd[ROVER_NUM_SERVOS] written to the PCA9685
+    REC_MOTOR,          // i16 speed[ROVER_NUM_MOTORS] written to the L298N boards
+} recorder_type_t;
+
+typedef struct {
+    uint32_t partition_size;
+    uint32_t head_sector;       // sector being filled
+    uint32_t head_seq;          // its sequence number
+    uint32_t records;           // records staged since boot
+    uint32_t dropped;           // records lost: both buffers busy, or no erased sector under hold
+    uint32_t flash_errors;      // failed erases or writes
+} recorder_info_t;
+
+#if RECORDER_ENABLE
+#define RECORD(type, data, len) recorder_write((type), (data), (len))
+#else
+#define RECORD(type, data, len) do { } while (0)
+#endif
+
+// Find the partition, locate the newest sector and start the writer task.
+esp_err_t recorder_init();
+
+// Stage one record. Safe from any task; len is clipped to RECORDER_MAX_PAYLOAD.
+void recorder_write(uint8_t type, const void *data, size_t len);
+
+// While hold is true no sector is erased. Safe from any task.
+void recorder_hold_erase(bool hold);
+
+void recorder_get_info(recorder_info_t *out);
+
+// Raw read of the partition, for download. Records still staged in RAM are not visible.
+esp_err_t recorder_read(uint32_t offset, void *dst, size_t len);
+
+#endif
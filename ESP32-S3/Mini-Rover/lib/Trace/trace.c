@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "trace.h"
+
+#define TRACE_RING_MASK (TRACE_RING_LEN - 1)
+
+_Static_assert((TRACE_RING_LEN & TRACE_RING_MASK) == 0, "TRACE_RING_LEN must be a power of two");
+
+/* One ring per core. Any task on the core may write, so a slot is reserved
+** with an atomic increment of head and published by storing its sequence
+** number (index + 1) once the record is complete. The reader only trusts a
+** slot whose sequence matches the index it expects, which also detects
+** records that were overwritten while being copied out.
+*/
+typedef struct {
+    atomic_uint_fast32_t seq;
+    trace_rec_t rec;
+} trace_slot_t;
+
+typedef struct {
+    atomic_uint_fast32_t head;
+    uint32_t tail;          // reader only
+    uint32_t dropped;       // reader only
+    trace_slot_t slots[TRACE_RING_LEN];
+} trace_ring_t;
+
+static trace_ring_t rings[portNUM_PROCESSORS];
+static atomic_flag reader_busy = ATOMIC_FLAG_INIT;
+
+void trace_record(uint16_t event, uint16_t a0, int32_t a1, int32_t a2) {
+    trace_ring_t *ring = &rings[xPortGetCoreID()];
+    uint32_t idx = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    trace_slot_t *slot = &ring->slots[idx & TRACE_RING_MASK];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->rec.ts_us = (uint32_t)esp_timer_get_time();
+    slot->rec.event = event;
+    slot->rec.a0 = a0;
+    slot->rec.a1 = a1;
+    slot->rec.a2 = a2;
+    atomic_store_explicit(&slot->seq, idx + 1, memory_order_release);
+}
+
+static void emit_record(int core, const trace_rec_t *rec) {
+    static const char hex[] = "0123456789abcdef";
+    char line[8 + 2 * sizeof(trace_rec_t) + 2];
+    const uint8_t *bytes = (const uint8_t *)rec;
+    int n = snprintf(line, sizeof(line), "TRC %d ", core);
+    for (size_t i = 0; i < sizeof(trace_rec_t); i++) {
+        line[n++] = hex[bytes[i] >> 4];
+        line[n++] = hex[bytes[i] & 0xF];
+    }
+    line[n++] = '\n';
+    fwrite(line, 1, n, stdout);
+}
+
+static int drain_ring(int core) {
+    trace_ring_t *ring = &rings[core];
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    int written = 0;
+
+    // Writers lapped the reader: skip what has already been overwritten.
+    if (head - ring->tail > TRACE_RING_LEN) {
+        ring->dropped += head - ring->tail - TRACE_RING_LEN;
+        ring->tail = head - TRACE_RING_LEN;
+    }
+
+    while (ring->tail != head) {
+        trace_slot_t *slot = &ring->slots[ring->tail & TRACE_RING_MASK];
+        uint32_t expect = ring->tail + 1;
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != expect) {
+            if (seq == 0) {
+                break;  // reserved but not yet committed, pick it up next time
+            }
+            ring->dropped++;
+            ring->tail++;
+            continue;
+        }
+
+        trace_rec_t rec = slot->rec;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != expect) {
+            ring->dropped++;
+        } else {
+            emit_record(core, &rec);
+            written++;
+        }
+        ring->tail++;
+    }
+
+    if (ring->dropped) {
+        printf("TRC %d DROP %u\n", core, (unsigned)ring->dropped);
+        ring->dropped = 0;
+    }
+    return written;
+}
+
+int trace_dump() {
+    if (atomic_flag_test_and_set(&reader_busy)) {
+        return 0;
+    }
+    int written = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        written += drain_ring(core);
+    }
+    if (written) {
+        fflush(stdout);
+    }
+    atomic_flag_clear(&reader_busy);
+    return written;
+}
+
+#if TRACE_ENABLE
+static const char *TAG = "TRACE";
+
+static void trace_drain_task(void *arg) {
+    while (1) {
+        trace_dump();
+        vTaskDelay(pdMS_TO_TICKS(TRACE_DRAIN_PERIOD_MS));
+    }
+}
+#endif
+
+esp_err_t trace_start_drain_task() {
+#if TRACE_ENABLE
+    if (xTaskCreate(trace_drain_task, "trace_drain", 3072, NULL, TRACE_DRAIN_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start trace drain task");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
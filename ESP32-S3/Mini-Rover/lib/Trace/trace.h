@@ -0,0 +1,68 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+** Binary in-RAM trace. Hot paths record fixed-size events into a per-core
+** ring instead of formatting log lines; a low-priority task (or an explicit
+** trace_dump()) writes the records out as hex lines that
+** python/trace_decode.py turns back into readable logs.
+**
+** Off by default: at run rates the hot paths record well over a thousand
+** events a second, far more than a 115200 baud console can print, so the
+** drain would flood the console and the rings would overflow. Build with
+** -DTRACE_ENABLE=1 for a debugging session; otherwise every TRACE() call is
+** compiled out and no drain task is started.
+*/
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 0
+#endif
+
+// Records per core, must be a power of two.
+#ifndef TRACE_RING_LEN
+#define TRACE_RING_LEN 256
+#endif
+
+#define TRACE_DRAIN_PERIOD_MS 200
+#define TRACE_DRAIN_TASK_PRIORITY 1
+
+// Event ids. python/trace_decode.py has the matching name table.
+typedef enum {
+    TRACE_EV_RX = 1,            // a0 = datagram length, a1 = message type
+    TRACE_EV_REJECT,            // a0 = datagram length, a1 = rover_proto_err_t
+    TRACE_EV_SERVO_PULSE,       // a0 = channel, a1 = pulse (12-bit count)
+    TRACE_EV_SERVO_FLUSH,       // a0 = first channel, a1 = channel count
+    TRACE_EV_I2C_ERROR,         // a0 = register, a1 = esp_err_t
+    TRACE_EV_MOTOR_DIR,         // a0 = LEDC channel, a1 = motorDirection_t
+    TRACE_EV_MOTOR_DUTY,        // a0 = LEDC channel, a1 = duty
+    TRACE_EV_LEDC_ERROR,        // a0 = LEDC channel, a1 = esp_err_t
+    TRACE_EV_SEQ_DROP,          // a0 = message type, a1 = sequence number, a2 = seq_verdict_t
+} trace_event_t;
+
+// 16 bytes on the wire, little-endian.
+typedef struct {
+    uint32_t ts_us;     // esp_timer time, wraps every ~71 minutes
+    uint16_t event;     // trace_event_t
+    uint16_t a0;
+    int32_t a1;
+    int32_t a2;
+} trace_rec_t;
+
+#if TRACE_ENABLE
+#define TRACE(ev, a0, a1, a2) trace_record((ev), (a0), (a1), (a2))
+#else
+#define TRACE(ev, a0, a1, a2) do { } while (0)
+#endif
+
+void trace_record(uint16_t event, uint16_t a0, int32_t a1, int32_t a2);
+
+// Write all pending records to the console. Returns the number written.
+int trace_dump();
+
+// Start the background task that periodically calls trace_dump().
+esp_err_t trace_start_drain_task();
+
+#endif
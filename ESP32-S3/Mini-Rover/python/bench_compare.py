@@ -0,0 +1,85 @@
+"""Compare a hot-path benchmark run against a stored baseline.
+
+    python bench_compare.py result.json --baseline ../host/bench/baseline_host.json
+    python bench_compare.py monitor.log --baseline baseline_esp32s3.json
+    python bench_compare.py result.json --baseline baseline.json --update
+
+The input is the JSON document printed by bench_run() (src/bench.h), either
+on its own or inside a serial monitor log of a ROVER_BENCH build; "-" reads
+stdin. A benchmark regresses when both its min and its median are more than
+--tolerance above the baseline and --slack counts beyond it: one noisy
+percentile does not fail a run, a function that got slower moves both. p99
+is shown but not judged, it belongs to interrupts and the host's scheduler.
+
+Exit status: 0 if nothing regressed, 1 if something did, 2 if the run and
+the baseline cannot be compared (different platform or counter). --update
+writes the run as the new baseline instead.
+"""
+
+import argparse
+import json
+import sys
+
+MARKER = '{"bench"'
+
+
+def load_run(path):
+    """Return the benchmark document in path and its text as printed."""
+    text = sys.stdin.read() if path == "-" else open(path).read()
+    start = text.find(MARKER)
+    if start < 0:
+        raise ValueError(f"no benchmark output in {path}")
+    doc, end = json.JSONDecoder().raw_decode(text[start:])
+    return doc, text[start:start + end]
+
+
+def change(now, base):
+    return (now - base) / base * 100 if base else 0.0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("run", help="benchmark output, or a log containing it")
+    ap.add_argument("--baseline", required=True)
+    ap.add_argument("--tolerance", type=float, default=0.25, help="allowed slowdown as a fraction (default 0.25)")
+    ap.add_argument("--slack", type=int, default=20, help="allowed slowdown in counts on top (default 20)")
+    ap.add_argument("--update", action="store_true", help="store the run as the baseline")
+    args = ap.parse_args()
+
+    try:
+        run, text = load_run(args.run)
+        if args.update:
+            with open(args.baseline, "w") as f:
+                f.write(text + "\n")
+            print(f"baseline written to {args.baseline}")
+            return 0
+        base, _ = load_run(args.baseline)
+    except (OSError, ValueError) as e:
+        print(e)
+        return 2
+
+    for key in ("platform", "unit"):
+        if run[key] != base[key]:
+            print(f"{key} differs: run {run[key]}, baseline {base[key]}")
+            return 2
+
+    base_results = {r["name"]: r for r in base["results"]}
+    print(f"{run['platform']}, {run['unit']} at {run['counter_mhz']} MHz (baseline {base['counter_mhz']} MHz)")
+    print(f"{'benchmark':<16} {'min':>13} {'median':>13} {'p99':>13}  change  verdict")
+    regressed = False
+    for r in run["results"]:
+        b = base_results.get(r["name"])
+        if b is None:
+            print(f"{r['name']:<16} {r['min']:>13} {r['median']:>13} {r['p99']:>13}          new")
+            continue
+        slower = all(r[k] > b[k] * (1 + args.tolerance) + args.slack for k in ("min", "median"))
+        regressed |= slower
+        cols = " ".join(f"{b[k]:>6}>{r[k]:<6}" for k in ("min", "median", "p99"))
+        print(f"{r['name']:<16} {cols} {change(r['median'], b['median']):+6.0f}%  {'SLOWER' if slower else 'ok'}")
+    for name in base_results.keys() - {r["name"] for r in run["results"]}:
+        print(f"{name:<16} missing from the run")
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
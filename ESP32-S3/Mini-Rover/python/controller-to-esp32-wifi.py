@@ -2,7 +2,7 @@ import pygame
 import socket
 import time
 import math
-import threading
+import rover_protocol
 
 # Configuration variables
 WHEELBASE = 16.0  # in cm
@@ -12,9 +12,27 @@ R_MAX = 200.0  # Largest turn radius (cm)
 THRESHOLD = 0.1  # Small threshold to avoid accidental trigger activation
 ESP32_IP = "192.168.1.73"  # Update to the ESP32's actual IP
 ESP32_PORT = 8080           # Port the ESP32 server listens on
+USE_BINARY = True           # False falls back to the legacy "S,..." / "M,..." text commands
+ONBOARD_ACKERMANN = True    # Send the raw steering input and let the rover compute wheel angles
+RECORD_PATH = None          # e.g. "session.txt": log every datagram sent, for replay with udp_load.py
+
+# Sender pacing. Commands go out only when the (deadbanded) input changes,
+# no closer together than the current minimum interval, plus a keepalive
+# while nothing changes. The minimum interval follows the measured round-trip
+# time: on a congested channel changes are coalesced instead of queued.
+STICK_DEADBAND = 0.08       # steering stick dead zone around centre
+STEER_STEP = 1.0 / 64       # steering changes smaller than this are not sent
+SPEED_STEP = 4              # motor speed changes smaller than this are not sent
+KEEPALIVE_S = 0.25          # resend the current command this often when idle
+MIN_INTERVAL_S = 0.01       # fastest change-driven send rate (100 Hz)
+MAX_INTERVAL_S = 0.1        # slowest, however bad the round-trip time gets
+RTT_FACTOR = 0.5            # minimum interval as a fraction of the smoothed RTT
+ECHO_INTERVAL_S = 0.25      # how often a command asks the rover for an echo
+STATUS_INTERVAL_S = 2.0     # how often to print link statistics
 
 # Initialize UDP socket
 sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.setblocking(False)
 
 # Initialize Pygame and the Xbox controller
 pygame.init()
@@ -29,10 +47,16 @@ controller.init()
 
 print(f"Xbox Controller Connected: {controller.get_name()}")
 
+record_file = open(RECORD_PATH, "w") if RECORD_PATH else None
+record_start = time.monotonic()
+
 # Functions
 def send_command(command):
-    print(f"Sending: {command}")
-    sock.sendto(command.encode(), (ESP32_IP, ESP32_PORT))
+    if isinstance(command, str):
+        command = command.encode()
+    sock.sendto(command, (ESP32_IP, ESP32_PORT))
+    if record_file:
+        record_file.write(f"{time.monotonic() - record_start:.6f} {command.hex()}\n")
 
 def clamp(angle, min_angle=45, max_angle=135):  # 45 < theta < 135
     return max(min_angle, min(max_angle, angle))
@@ -73,46 +97,100 @@ def normalize_triggers(rtRaw, ltRaw):
     lt = (ltRaw + 1) / 2.0
     return [rt, lt]
 
-# Thread for Motor Commands
-def motor_thread():
-    while running:
-        rtRaw = controller.get_axis(5)
-        ltRaw = controller.get_axis(4)
-
-        rt, lt = normalize_triggers(rtRaw, ltRaw)
-
-        if rt < THRESHOLD and lt < THRESHOLD:
-            motorSpeed = 0
+def read_inputs():
+    """Current (steering, motorSpeed), with dead zones applied and quantized to the send steps."""
+    steeringInput = controller.get_axis(0)  # Left thumbstick
+    if abs(steeringInput) < STICK_DEADBAND:
+        steeringInput = 0.0
+    steeringInput = round(steeringInput / STEER_STEP) * STEER_STEP
+
+    rt, lt = normalize_triggers(controller.get_axis(5), controller.get_axis(4))
+    if rt < THRESHOLD and lt < THRESHOLD:
+        motorSpeed = 0
+    else:
+        motorSpeed = int(round((rt - lt) * 255 / SPEED_STEP)) * SPEED_STEP
+        motorSpeed = max(-255, min(255, motorSpeed))
+    return steeringInput, motorSpeed
+
+def now_us():
+    return int(time.monotonic() * 1e6)
+
+class Sender:
+    """Sends the current command on change and as a keepalive, paced by the measured RTT."""
+
+    def __init__(self):
+        self.seq = 0
+        self.sent = None            # last (steering, speed) put on the wire
+        self.last_send = 0.0
+        self.last_echo_req = 0.0
+        self.srtt = None            # smoothed round-trip time, seconds
+        self.sent_count = 0
+        self.bytes_sent = 0
+
+    def min_interval(self):
+        if self.srtt is None:
+            return MIN_INTERVAL_S
+        return max(MIN_INTERVAL_S, min(MAX_INTERVAL_S, self.srtt * RTT_FACTOR))
+
+    def next_deadline(self, command):
+        """Monotonic time at which the loop must next wake up to send."""
+        if command != self.sent:
+            return self.last_send + self.min_interval()
+        return self.last_send + KEEPALIVE_S
+
+    def send(self, command, now):
+        steeringInput, motorSpeed = command
+        if USE_BINARY and ONBOARD_ACKERMANN:
+            echo = now - self.last_echo_req >= ECHO_INTERVAL_S
+            if echo:
+                self.last_echo_req = now
+            datagrams = [rover_protocol.encode_drive(self.seq, rover_protocol.steer_q15(steeringInput), motorSpeed, now_us(), echo)]
+        elif USE_BINARY:
+            datagrams = [rover_protocol.encode_servo(ackerman_angles(steeringInput), self.seq, now_us()),
+                         rover_protocol.encode_motor(motorSpeed, self.seq, now_us())]
         else:
-            motorSpeed = int((rt - lt) * 255)
-
-        driveCommand = f"M,{int(round(motorSpeed))}"
-        send_command(driveCommand)
-        time.sleep(0.01)  # 10ms delay for smoother updates
-
-# Thread for Servo Commands
-def servo_thread():
-    while running:
-        steeringInput = controller.get_axis(0)  # Left thumbstick
-        steeringAngles = ackerman_angles(steeringInput)
-
-        steerCommand = f"S,{int(round(steeringAngles[0]))},{int(round(steeringAngles[1]))},{int(round(steeringAngles[2]))},{int(round(steeringAngles[3]))},{int(round(steeringAngles[4]))},{int(round(steeringAngles[5]))}"
-        send_command(steerCommand)
-        time.sleep(0.05)  # 50ms delay for smoother updates
+            steeringAngles = ackerman_angles(steeringInput)
+            datagrams = ["S," + ",".join(str(int(round(a))) for a in steeringAngles), f"M,{motorSpeed}"]
+        self.seq = (self.seq + 1) & 0xFFFF
+        for d in datagrams:
+            send_command(d)
+            self.sent_count += 1
+            self.bytes_sent += len(d)
+        self.sent = command
+        self.last_send = now
+
+    def poll_echoes(self):
+        """Fold any drive echoes waiting on the socket into the RTT estimate."""
+        while True:
+            try:
+                datagram = sock.recv(512)
+            except OSError:  # nothing waiting (BlockingIOError) or ICMP unreachable
+                return
+            try:
+                for msg_type, payload in rover_protocol.iter_frames(datagram):
+                    if msg_type != rover_protocol.MSG_DRIVE_ECHO:
+                        continue
+                    _, t_us = rover_protocol.decode_drive_echo(payload)
+                    rtt = ((now_us() - t_us) & 0xFFFFFFFF) / 1e6
+                    self.srtt = rtt if self.srtt is None else self.srtt + (rtt - self.srtt) / 8
+            except rover_protocol.ProtocolError:
+                pass
 
 # Main Program (Event Handling)
 running = True
+sender = Sender()
+last_status = time.monotonic()
+last_status_count = 0
 
-# Start threads for motor and servo commands
-motor_thread_obj = threading.Thread(target=motor_thread)
-servo_thread_obj = threading.Thread(target=servo_thread)
-
-motor_thread_obj.start()
-servo_thread_obj.start()
-
-# Event Handling in Main Thread
+# One loop: wake on controller events or when the next send is due.
 while running:
-    for event in pygame.event.get():
+    command = read_inputs()
+    now = time.monotonic()
+    timeout_ms = max(1, int((sender.next_deadline(command) - now) * 1000))  # 0 would wait forever
+    event = pygame.event.wait(timeout_ms)
+
+    events = [event] + pygame.event.get() if event.type != pygame.NOEVENT else []
+    for event in events:
         if event.type == pygame.QUIT:
             running = False
         if event.type == pygame.JOYBUTTONDOWN:
@@ -121,10 +199,23 @@ while running:
                 print("B button pressed. Exiting.")
                 running = False
 
-# Wait for threads to finish
-motor_thread_obj.join()
-servo_thread_obj.join()
+    command = read_inputs()
+    now = time.monotonic()
+    if now >= sender.next_deadline(command):
+        sender.send(command, now)
+    sender.poll_echoes()
+
+    if now - last_status >= STATUS_INTERVAL_S:
+        rate = (sender.sent_count - last_status_count) / (now - last_status)
+        rtt = f"{sender.srtt * 1000:.1f} ms" if sender.srtt is not None else "n/a"
+        print(f"steer {command[0]:+.2f} speed {command[1]:+4d} | {rate:5.1f} pkt/s, {sender.bytes_sent} B total, rtt {rtt}")
+        last_status, last_status_count = now, sender.sent_count
+
+# Stop the rover before leaving
+sender.send((0.0, 0), time.monotonic())
 
 pygame.quit()
 sock.close()
-print("Program exited successfully.")
\ No newline at end of file
+if record_file:
+    record_file.close()
+print("Program exited successfully.")
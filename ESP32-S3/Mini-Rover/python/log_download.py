@@ -0,0 +1,203 @@
+"""Download the rover's flight recorder and decode it.
+
+    python log_download.py [--ip 192.168.1.73] [--out rover_log.bin]
+    python log_download.py --file rover_log.bin --dump
+    python log_download.py --file rover_log.bin --session session.txt
+
+Downloading saves the whole recorder partition as an image; sectors that
+hold no log are skipped on the wire and saved as erased (0xFF). The image
+is what host/log_replay.c (rover_log_replay) replays through the firmware
+logic, and what --dump and --session read back.
+
+--dump prints every record of the chosen boot (default: the last) in time
+order. --session writes its command datagrams in the replay format of
+udp_load.py, so a field session can be replayed live against a rover or
+rover_host.
+
+The layout is described in lib/Recorder/recorder.h. Records still staged
+in the rover's RAM (at most RECORDER_FLUSH_MS old) are not on flash yet and
+are not downloaded.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+
+import rover_protocol
+
+SECTOR_SIZE = 4096
+SECTOR_MAGIC = 0x474F4C52
+SECTOR_HEADER = struct.Struct("<II")
+REC_HEADER = struct.Struct("<IBB")
+
+REC_BOOT, REC_CMD, REC_SERVO, REC_MOTOR = 1, 2, 3, 4
+REC_NAMES = {REC_BOOT: "boot", REC_CMD: "cmd", REC_SERVO: "servo", REC_MOTOR: "motor"}
+
+
+class Link:
+    """LOG_READ requests with retries on a private socket."""
+
+    def __init__(self, addr, timeout, retries):
+        self.addr = addr
+        self.retries = retries
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+
+    def read(self, offset, length):
+        """Return (info, bytes) for [offset, offset + length), length <= LOG_READ_MAX."""
+        request = rover_protocol.encode_log_read(offset, length)
+        for _ in range(self.retries):
+            self.sock.sendto(request, self.addr)
+            try:
+                while True:
+                    reply = self.parse(self.sock.recv(2048), offset, length)
+                    if reply:
+                        return reply
+            except socket.timeout:
+                continue
+        raise TimeoutError(f"no reply for offset {offset:#x}")
+
+    @staticmethod
+    def parse(datagram, offset, length):
+        info, chunks = None, []
+        try:
+            for msg_type, payload in rover_protocol.iter_frames(datagram):
+                if msg_type == rover_protocol.MSG_LOG_INFO:
+                    info = rover_protocol.decode_log_info(payload)
+                elif msg_type == rover_protocol.MSG_LOG_DATA:
+                    (at,) = struct.unpack_from("<I", payload)
+                    chunks.append((at, payload[4:]))
+        except rover_protocol.ProtocolError:
+            return None
+        data = b"".join(d for _, d in sorted(chunks))
+        # A late reply to an earlier request starts somewhere else; keep waiting.
+        if info is None or (length and (not chunks or min(chunks)[0] != offset)):
+            return None
+        return info, data
+
+
+def download(link, out_path):
+    info, _ = link.read(0, 0)
+    size = info["partition_size"]
+    print(f"recorder: {size // SECTOR_SIZE} sectors, head sector {info['head_sector']} seq {info['head_seq']}, "
+          f"{info['records']} records this boot, {info['dropped']} dropped, {info['flash_errors']} flash errors",
+          file=sys.stderr)
+    image = bytearray(b"\xff" * size)
+    used = 0
+    for sector in range(size // SECTOR_SIZE):
+        base = sector * SECTOR_SIZE
+        offset = base
+        while offset < base + SECTOR_SIZE:
+            n = min(rover_protocol.LOG_READ_MAX, base + SECTOR_SIZE - offset)
+            _, data = link.read(offset, n)
+            if len(data) != n:
+                raise IOError(f"short read at {offset:#x}")
+            image[offset:offset + n] = data
+            if offset == base and SECTOR_HEADER.unpack_from(data)[0] != SECTOR_MAGIC:
+                break  # no log in this sector
+            offset += n
+        else:
+            used += 1
+        print(f"\rsector {sector + 1}/{size // SECTOR_SIZE}, {used} with log", end="", file=sys.stderr)
+    print(file=sys.stderr)
+    with open(out_path, "wb") as f:
+        f.write(image)
+    print(f"saved {out_path}", file=sys.stderr)
+    return bytes(image)
+
+
+def parse_image(image):
+    """Split the log into boots: a list of lists of (t_us, type, payload), oldest first."""
+    sectors = []
+    for i in range(len(image) // SECTOR_SIZE):
+        magic, seq = SECTOR_HEADER.unpack_from(image, i * SECTOR_SIZE)
+        if magic == SECTOR_MAGIC:
+            sectors.append((seq, i))
+    if not sectors:
+        return []
+    # Oldest first with wrap-around: start after the biggest gap in sequence numbers.
+    sectors.sort()
+    gaps = [((sectors[(k + 1) % len(sectors)][0] - sectors[k][0]) & 0xFFFFFFFF, k) for k in range(len(sectors))]
+    start = (max(gaps)[1] + 1) % len(sectors)
+    sectors = sectors[start:] + sectors[:start]
+
+    boots = []
+    epoch, last_ts = 0, 0
+    for _, index in sectors:
+        off = index * SECTOR_SIZE + SECTOR_HEADER.size
+        end = (index + 1) * SECTOR_SIZE
+        while off + REC_HEADER.size <= end:
+            ts, rtype, length = REC_HEADER.unpack_from(image, off)
+            if rtype == 0xFF or off + REC_HEADER.size + length > end:
+                break
+            payload = image[off + REC_HEADER.size:off + REC_HEADER.size + length]
+            off += REC_HEADER.size + length
+            if rtype == REC_BOOT:
+                boots.append([])
+                epoch, last_ts = 0, ts
+            elif last_ts - ts > 0x80000000:  # esp_timer wrapped
+                epoch += 1 << 32
+            last_ts = ts
+            if boots:
+                boots[-1].append((epoch + ts, rtype, payload))
+    return boots
+
+
+def describe(rtype, payload):
+    if rtype == REC_CMD and len(payload) >= 6:
+        ip = socket.inet_ntoa(payload[:4])
+        (port,) = struct.unpack_from(">H", payload, 4)
+        raw = payload[6:]
+        try:
+            msg_type, values = rover_protocol.decode(raw)
+            return f"{ip}:{port} type {msg_type} {values}"
+        except rover_protocol.ProtocolError:
+            return f"{ip}:{port} {raw!r}"
+    if rtype == REC_SERVO:
+        return " ".join(f"{v / rover_protocol.ANGLE_SCALE:.1f}" for v in struct.unpack(f"<{len(payload) // 2}H", payload))
+    if rtype == REC_MOTOR:
+        return " ".join(f"{v:+d}" for v in struct.unpack(f"<{len(payload) // 2}h", payload))
+    return payload.hex()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--ip", default="192.168.1.73")
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--out", default="rover_log.bin", help="image file to save the download to")
+    ap.add_argument("--file", help="read this image instead of downloading")
+    ap.add_argument("--offset", type=lambda s: int(s, 0), default=0,
+                    help="recorder offset inside --file (0x210000 for a host flash file)")
+    ap.add_argument("--boot", type=int, default=-1, help="boot to dump, counted from 0 (negative from the end)")
+    ap.add_argument("--dump", action="store_true", help="print the records of the boot")
+    ap.add_argument("--session", help="write the boot's commands in udp_load.py replay format")
+    ap.add_argument("--timeout", type=float, default=0.5)
+    ap.add_argument("--retries", type=int, default=5)
+    args = ap.parse_args()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            f.seek(args.offset)
+            image = f.read()
+    else:
+        image = download(Link((args.ip, args.port), args.timeout, args.retries), args.out)
+
+    boots = parse_image(image)
+    print(f"{len(boots)} boots: " + ", ".join(f"{len(b)} records" for b in boots), file=sys.stderr)
+    if not boots or not (args.dump or args.session):
+        return
+    records = boots[args.boot]
+    t0 = records[0][0]
+    if args.dump:
+        for t, rtype, payload in records:
+            print(f"{(t - t0) / 1e6:12.6f} {REC_NAMES.get(rtype, rtype):<5} {describe(rtype, payload)}")
+    if args.session:
+        with open(args.session, "w") as f:
+            for t, rtype, payload in records:
+                if rtype == REC_CMD and len(payload) > 6:
+                    f.write(f"{(t - t0) / 1e6:.6f} {payload[6:].hex()}\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,114 @@
+"""Query the rover's run-time profile: CPU and stack per task, idle per core,
+and wake-up lateness of the periodic loops.
+
+    python prof_query.py [--ip 192.168.1.73] [--port 8080] [--watch 2] [--csv prof.csv]
+
+The firmware answers a MSG_PROF_QUERY with the last complete profiling
+window (PROFILER_PERIOD_MS, see src/profiler.h). CPU load is per task as a
+share of one core, so on two cores the column can add up to 200 %; stack is
+the least free stack the task has ever had, in bytes. A build without the
+profiler does not answer. With --csv every window is appended as rows of
+(t_ms, kind, name, values...) for plotting over a drive.
+"""
+
+import argparse
+import csv
+import socket
+import time
+
+import rover_protocol
+
+
+def parse_report(datagram):
+    summary, tasks, loops = None, [], []
+    for msg_type, payload in rover_protocol.iter_frames(datagram):
+        if msg_type == rover_protocol.MSG_PROF_SUMMARY:
+            summary = rover_protocol.decode_prof_summary(payload)
+        elif msg_type == rover_protocol.MSG_PROF_TASK:
+            tasks.append(rover_protocol.decode_prof_task(payload))
+        elif msg_type == rover_protocol.MSG_PROF_LOOP:
+            loops.append(rover_protocol.decode_prof_loop(payload))
+    return summary, tasks, loops
+
+
+def loop_name(i):
+    return rover_protocol.PROF_LOOPS[i] if i < len(rover_protocol.PROF_LOOPS) else str(i)
+
+
+def fmt_idle(v):
+    return "-" if v is None else f"{v:.1f}%"
+
+
+def print_report(summary, tasks, loops):
+    print(f"t {summary['t_ms'] / 1000:.1f}s  window {summary['window_us'] / 1000:.0f}ms  "
+          f"idle core0 {fmt_idle(summary['idle'][0])} core1 {fmt_idle(summary['idle'][1])}  "
+          f"heap {summary['free_heap']} (min {summary['min_free_heap']})  tick {summary['tick_hz']} Hz")
+    if summary["tasks"] == 0:
+        print("task list unavailable (more tasks than PROFILER_MAX_TASKS)")
+    print(f"{'task':<16} {'core':>4} {'prio':>4} {'cpu':>7} {'stack free':>10}")
+    for t in sorted(tasks, key=lambda t: -t["cpu"]):
+        core = "any" if t["core"] is None else str(t["core"])
+        print(f"{t['name']:<16} {core:>4} {t['priority']:>4} {t['cpu']:>6.2f}% {t['stack_free']:>10}")
+    print(f"{'loop':<10} {'period':>8} {'wakes':>6} {'missed':>6} {'late mean':>10} {'late max':>9}")
+    for lp in loops:
+        if lp["period_us"] == 0:
+            continue  # never ran
+        print(f"{loop_name(lp['loop']):<10} {lp['period_us']:>6}us {lp['wakes']:>6} {lp['missed']:>6} "
+              f"{lp['late_mean_us']:>8}us {lp['late_max_us']:>7}us")
+
+
+def write_rows(writer, summary, tasks, loops):
+    t = summary["t_ms"]
+    for core, idle in enumerate(summary["idle"]):
+        writer.writerow([t, "idle", f"core{core}", "" if idle is None else idle])
+    for task in tasks:
+        writer.writerow([t, "task", task["name"], task["cpu"], task["stack_free"], task["priority"],
+                         "any" if task["core"] is None else task["core"]])
+    for lp in loops:
+        writer.writerow([t, "loop", loop_name(lp["loop"]), lp["period_us"], lp["wakes"], lp["missed"],
+                         lp["late_mean_us"], lp["late_max_us"]])
+
+
+def query(sock, addr, timeout):
+    sock.settimeout(timeout)
+    sock.sendto(rover_protocol.encode_prof_query(), addr)
+    datagram, _ = sock.recvfrom(4096)
+    return parse_report(datagram)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--ip", default="192.168.1.73")
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--timeout", type=float, default=1.0)
+    ap.add_argument("--watch", type=float, help="repeat every N seconds")
+    ap.add_argument("--csv", help="append every window to this file")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    out = open(args.csv, "a", newline="") if args.csv else None
+    writer = csv.writer(out) if out else None
+    last_t = None
+    while True:
+        try:
+            summary, tasks, loops = query(sock, (args.ip, args.port), args.timeout)
+            if summary is None:
+                print("no profile yet")
+            else:
+                print_report(summary, tasks, loops)
+                if writer and summary["t_ms"] != last_t:
+                    write_rows(writer, summary, tasks, loops)
+                    out.flush()
+                last_t = summary["t_ms"]
+        except socket.timeout:
+            print("no reply (profiler disabled?)")
+        if not args.watch:
+            break
+        print()
+        time.sleep(args.watch)
+    if out:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,250 @@
+"""Rover command protocol (PC side).
+
+Mirrors lib/Protocol/protocol.h. Frames are:
+
+    magic(1) version(1) type(1) payload_len(1) payload(n) fletcher16(2)
+
+or, for sequenced commands (version 2),
+
+    magic(1) version(1) type(1) payload_len(1) seq(2) t_us(4) payload(n) fletcher16(2)
+
+with all multi-byte fields little-endian. Keep this file in sync with the
+firmware header.
+"""
+
+import struct
+
+PROTO_MAGIC = 0xA5
+PROTO_VERSION = 1
+PROTO_VERSION_SEQ = 2
+
+NUM_SERVOS = 6
+NUM_MOTORS = 6
+ANGLE_SCALE = 10  # servo angles travel in tenths of a degree
+
+MSG_SERVO = 0x01
+MSG_MOTOR = 0x02
+MSG_STEER = 0x03
+MSG_DRIVE = 0x04
+MSG_STATS_QUERY = 0x10
+MSG_STATS_COUNTERS = 0x11
+MSG_STATS_HIST = 0x12
+MSG_DRIVE_ECHO = 0x13
+MSG_TELEMETRY_SUB = 0x14
+MSG_TELEMETRY = 0x15
+MSG_LOG_READ = 0x16
+MSG_LOG_INFO = 0x17
+MSG_LOG_DATA = 0x18
+MSG_PROF_QUERY = 0x19
+MSG_PROF_SUMMARY = 0x1A
+MSG_PROF_TASK = 0x1B
+MSG_PROF_LOOP = 0x1C
+
+LOG_READ_MAX = 4 * 232  # partition bytes the rover returns per LOG_READ
+
+DRIVE_FLAG_ECHO = 0x01
+
+_HEADER = struct.Struct("<BBBB")
+_SEQ = struct.Struct("<HI")
+_DRIVE_ECHO = struct.Struct("<HHI")
+# t_us, seq, loop busy, loop late, dir[6], pulse[6], duty[6], rx_packets, rx_dropped, free_heap,
+# target speed[6], measured speed[6]
+_TELEMETRY = struct.Struct(f"<IHHH{NUM_MOTORS}B{NUM_SERVOS}H{NUM_MOTORS}HIII{NUM_MOTORS}h{NUM_MOTORS}h")
+SPEED_UNMEASURED = -32768
+_LOG_INFO = struct.Struct("<6I")
+# See src/profiler.h.
+_PROF_SUMMARY = struct.Struct("<IIIIHHHBB")
+_PROF_TASK = struct.Struct("<16sHHBBH")
+_PROF_LOOP = struct.Struct("<B3xIIIII")
+PROF_IDLE_UNKNOWN = 0xFFFF
+PROF_CORE_ANY = 0xFF
+PROF_LOOPS = ["control", "speed", "telemetry"]
+_CRC = struct.Struct("<H")
+_PAYLOADS = {
+    MSG_SERVO: struct.Struct(f"<{NUM_SERVOS}H"),
+    MSG_MOTOR: struct.Struct(f"<{NUM_MOTORS}h"),
+    MSG_STEER: struct.Struct("<h"),
+    MSG_DRIVE: struct.Struct("<HBBIhh"),
+    MSG_STATS_QUERY: struct.Struct("<"),
+    MSG_TELEMETRY_SUB: struct.Struct("<"),
+    MSG_PROF_QUERY: struct.Struct("<"),
+    MSG_LOG_READ: struct.Struct("<IH"),
+}
+
+
+class ProtocolError(ValueError):
+    pass
+
+
+def checksum(data):
+    """Fletcher-16, identical to rover_checksum() in the firmware."""
+    sum1 = sum2 = 0
+    for b in data:
+        sum1 = (sum1 + b) % 255
+        sum2 = (sum2 + sum1) % 255
+    return (sum2 << 8) | sum1
+
+
+def encode_frame(msg_type, payload, seq=None, t_us=None):
+    """Frame a payload; with seq it becomes a version 2 frame carrying seq and t_us."""
+    if seq is None:
+        frame = _HEADER.pack(PROTO_MAGIC, PROTO_VERSION, msg_type, len(payload)) + payload
+    else:
+        frame = (_HEADER.pack(PROTO_MAGIC, PROTO_VERSION_SEQ, msg_type, len(payload)) +
+                 _SEQ.pack(seq & 0xFFFF, (t_us or 0) & 0xFFFFFFFF) + payload)
+    return frame + _CRC.pack(checksum(frame))
+
+
+def encode(msg_type, values, seq=None, t_us=None):
+    return encode_frame(msg_type, _PAYLOADS[msg_type].pack(*values), seq, t_us)
+
+
+def encode_stats_query():
+    return encode_frame(MSG_STATS_QUERY, b"")
+
+
+def encode_telemetry_sub():
+    """Ask the rover to stream telemetry to this socket for the next few seconds."""
+    return encode_frame(MSG_TELEMETRY_SUB, b"")
+
+
+def encode_log_read(offset, length):
+    """Ask for recorder info and up to LOG_READ_MAX partition bytes from offset (0 for info only)."""
+    return encode(MSG_LOG_READ, [offset, length])
+
+
+def encode_prof_query():
+    return encode_frame(MSG_PROF_QUERY, b"")
+
+
+def decode_prof_summary(payload):
+    """Return a MSG_PROF_SUMMARY payload as a dict; idle is in percent, None if unknown."""
+    if len(payload) != _PROF_SUMMARY.size:
+        raise ProtocolError("bad length")
+    t_ms, window_us, free_heap, min_free_heap, idle0, idle1, tick_hz, tasks, loops = _PROF_SUMMARY.unpack(payload)
+    return {"t_ms": t_ms, "window_us": window_us, "free_heap": free_heap, "min_free_heap": min_free_heap,
+            "idle": [None if v == PROF_IDLE_UNKNOWN else v / 100.0 for v in (idle0, idle1)],
+            "tick_hz": tick_hz, "tasks": tasks, "loops": loops}
+
+
+def decode_prof_task(payload):
+    """Return a MSG_PROF_TASK payload as a dict; cpu is in percent of one core, core None if unpinned."""
+    if len(payload) != _PROF_TASK.size:
+        raise ProtocolError("bad length")
+    name, cpu, stack_free, priority, core, _ = _PROF_TASK.unpack(payload)
+    return {"name": name.split(b"\0", 1)[0].decode(errors="replace"), "cpu": cpu / 100.0,
+            "stack_free": stack_free, "priority": priority, "core": None if core == PROF_CORE_ANY else core}
+
+
+def decode_prof_loop(payload):
+    """Return a MSG_PROF_LOOP payload as a dict."""
+    if len(payload) != _PROF_LOOP.size:
+        raise ProtocolError("bad length")
+    keys = ["loop", "period_us", "wakes", "missed", "late_mean_us", "late_max_us"]
+    return dict(zip(keys, _PROF_LOOP.unpack(payload)))
+
+
+def decode_log_info(payload):
+    """Return a MSG_LOG_INFO payload as a dict."""
+    if len(payload) != _LOG_INFO.size:
+        raise ProtocolError("bad length")
+    keys = ["partition_size", "head_sector", "head_seq", "records", "dropped", "flash_errors"]
+    return dict(zip(keys, _LOG_INFO.unpack(payload)))
+
+
+def encode_servo(angles_deg, seq=None, t_us=None):
+    """Encode six servo angles given in degrees (floats allowed)."""
+    return encode(MSG_SERVO, [int(round(a * ANGLE_SCALE)) for a in angles_deg], seq, t_us)
+
+
+def encode_motor(speeds, seq=None, t_us=None):
+    """Encode per-wheel motor speeds (-255..255). A single int drives all wheels."""
+    if isinstance(speeds, int):
+        speeds = [speeds] * NUM_MOTORS
+    return encode(MSG_MOTOR, [int(s) for s in speeds], seq, t_us)
+
+
+def encode_steer(steering, seq=None, t_us=None):
+    """Encode a steering scalar in [-1, 1]; the rover computes the Ackermann angles."""
+    return encode(MSG_STEER, [steer_q15(steering)], seq, t_us)
+
+
+def steer_q15(steering):
+    steering = max(-1.0, min(1.0, steering))
+    return int(round(steering * 32767))
+
+
+def encode_drive(seq, steer, speed, t_us, echo=False):
+    """Encode a combined drive frame.
+
+    steer is already in Q15 (see steer_q15), speed applies to every wheel and
+    t_us is the sender's clock in microseconds. With echo the rover answers
+    with a MSG_DRIVE_ECHO carrying seq and t_us back.
+    """
+    flags = DRIVE_FLAG_ECHO if echo else 0
+    return encode(MSG_DRIVE, [seq & 0xFFFF, flags, 0, t_us & 0xFFFFFFFF, steer, max(-255, min(255, int(speed)))])
+
+
+def decode_drive_echo(payload):
+    """Return (seq, t_us) from a MSG_DRIVE_ECHO payload."""
+    if len(payload) != _DRIVE_ECHO.size:
+        raise ProtocolError("bad length")
+    seq, _, t_us = _DRIVE_ECHO.unpack(payload)
+    return seq, t_us
+
+
+def decode_telemetry(payload):
+    """Return one MSG_TELEMETRY sample as a dict (see src/telemetry.h)."""
+    if len(payload) != _TELEMETRY.size:
+        raise ProtocolError("bad length")
+    v = _TELEMETRY.unpack(payload)
+    i = 4
+    direction = list(v[i:i + NUM_MOTORS]); i += NUM_MOTORS
+    pulse = list(v[i:i + NUM_SERVOS]); i += NUM_SERVOS
+    duty = list(v[i:i + NUM_MOTORS]); i += NUM_MOTORS
+    counters = v[i:i + 3]; i += 3
+    target = list(v[i:i + NUM_MOTORS]); i += NUM_MOTORS
+    measured = [None if s == SPEED_UNMEASURED else s for s in v[i:i + NUM_MOTORS]]
+    return {
+        "t_us": v[0], "seq": v[1], "loop_busy_us": v[2], "loop_late_us": v[3],
+        "dir": direction, "pulse": pulse, "duty": duty,
+        "rx_packets": counters[0], "rx_dropped": counters[1], "free_heap": counters[2],
+        "target_cps": target, "speed_cps": measured,
+    }
+
+
+def decode_frame(buf, offset=0):
+    """Check one frame starting at offset. Returns (msg_type, payload, next_offset)."""
+    if len(buf) - offset < _HEADER.size + _CRC.size:
+        raise ProtocolError("short frame")
+    magic, version, msg_type, plen = _HEADER.unpack_from(buf, offset)
+    if magic != PROTO_MAGIC:
+        raise ProtocolError("bad magic")
+    if version not in (PROTO_VERSION, PROTO_VERSION_SEQ):
+        raise ProtocolError("bad version")
+    start = offset + _HEADER.size + (_SEQ.size if version == PROTO_VERSION_SEQ else 0)
+    end = start + plen
+    if len(buf) < end + _CRC.size:
+        raise ProtocolError("short frame")
+    (crc,) = _CRC.unpack_from(buf, end)
+    if crc != checksum(buf[offset:end]):
+        raise ProtocolError("bad checksum")
+    return msg_type, bytes(buf[start:end]), end + _CRC.size
+
+
+def iter_frames(datagram):
+    """Yield (msg_type, payload) for every frame packed into one datagram."""
+    offset = 0
+    while offset < len(datagram):
+        msg_type, payload, offset = decode_frame(datagram, offset)
+        yield msg_type, payload
+
+
+def decode(frame):
+    """Return (msg_type, values) for a command frame, raising ProtocolError on bad input."""
+    msg_type, payload, _ = decode_frame(frame)
+    if msg_type not in _PAYLOADS:
+        raise ProtocolError("unknown type")
+    if len(payload) != _PAYLOADS[msg_type].size:
+        raise ProtocolError("bad length")
+    return msg_type, list(_PAYLOADS[msg_type].unpack(payload))
@@ -0,0 +1,104 @@
+"""Query the rover's latency statistics and print percentiles.
+
+    python stats_query.py [--ip 192.168.1.73] [--port 8080] [--watch 2]
+
+The firmware answers a MSG_STATS_QUERY with one datagram holding a counters
+frame and one log2 histogram frame per command type and stage (see
+src/stats.h). Percentiles are reported as the upper edge of the bucket they
+fall in, so they are conservative to within a factor of two.
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+import rover_protocol
+
+CMDS = ["servo", "motor"]
+STAGES = ["parse", "queue", "actuate", "total"]
+COUNTERS = ["rx_packets", "rx_rejected", "superseded", "i2c_errors", "ledc_errors",
+            "seq_stale", "seq_duplicate", "seq_resync", "jitter_us"]
+GAUGES = {"jitter_us"}  # current values rather than running totals
+PERCENTILES = [50, 90, 99]
+
+
+def bucket_upper_us(i):
+    return 0 if i == 0 else (1 << i)
+
+
+def percentile(buckets, pct):
+    total = sum(buckets)
+    if total == 0:
+        return None
+    target = total * pct / 100.0
+    seen = 0
+    for i, n in enumerate(buckets):
+        seen += n
+        if seen >= target:
+            return bucket_upper_us(i)
+    return bucket_upper_us(len(buckets) - 1)
+
+
+def parse_snapshot(datagram):
+    counters, hists = {}, {}
+    for msg_type, payload in rover_protocol.iter_frames(datagram):
+        if msg_type == rover_protocol.MSG_STATS_COUNTERS:
+            values = struct.unpack(f"<{len(payload) // 4}I", payload)
+            counters["uptime_ms"] = values[0]
+            counters.update(zip(COUNTERS, values[1:]))
+        elif msg_type == rover_protocol.MSG_STATS_HIST:
+            cmd, stage, nbuckets, _ = struct.unpack_from("<BBBB", payload)
+            hists[(cmd, stage)] = list(struct.unpack_from(f"<{nbuckets}I", payload, 4))
+    return counters, hists
+
+
+def fmt_us(us):
+    if us is None:
+        return "-"
+    return f"{us / 1000:.1f}ms" if us >= 1000 else f"{us}us"
+
+
+def print_snapshot(counters, hists):
+    print(f"uptime {counters.get('uptime_ms', 0) / 1000:.1f}s  " +
+          "  ".join(f"{k}={counters.get(k, 0)}" for k in COUNTERS))
+    header = f"{'cmd':<6} {'stage':<8} {'count':>8} " + " ".join(f"{'p' + str(p):>8}" for p in PERCENTILES) + f" {'max':>8}"
+    print(header)
+    for (cmd, stage), buckets in sorted(hists.items()):
+        nonzero = [i for i, n in enumerate(buckets) if n]
+        worst = bucket_upper_us(nonzero[-1]) if nonzero else None
+        cols = " ".join(f"{fmt_us(percentile(buckets, p)):>8}" for p in PERCENTILES)
+        name = CMDS[cmd] if cmd < len(CMDS) else str(cmd)
+        stage_name = STAGES[stage] if stage < len(STAGES) else str(stage)
+        print(f"{name:<6} {stage_name:<8} {sum(buckets):>8} {cols} {fmt_us(worst):>8}")
+
+
+def query(sock, addr, timeout):
+    sock.settimeout(timeout)
+    sock.sendto(rover_protocol.encode_stats_query(), addr)
+    datagram, _ = sock.recvfrom(4096)
+    return parse_snapshot(datagram)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--ip", default="192.168.1.73")
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--timeout", type=float, default=1.0)
+    ap.add_argument("--watch", type=float, help="repeat every N seconds")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    while True:
+        try:
+            print_snapshot(*query(sock, (args.ip, args.port), args.timeout))
+        except socket.timeout:
+            print("no reply")
+        if not args.watch:
+            break
+        print()
+        time.sleep(args.watch)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,196 @@
+"""Receive the rover's telemetry stream, print it, log it or plot it live.
+
+    python telemetry.py [--ip 192.168.1.73] [--csv out.csv] [--duration 10]
+    python telemetry.py --plot [--window 10]
+
+The tool subscribes with MSG_TELEMETRY_SUB about once a second, so the rover
+streams to this socket even while the controller script is driving it.
+Each datagram carries several fixed-size MSG_TELEMETRY samples (see
+src/telemetry.h); gaps in the sample counter are reported as lost samples.
+
+--plot needs matplotlib and shows servo pulses, signed motor duty, measured
+wheel speeds and the control loop timings over the last --window seconds.
+"""
+
+import argparse
+import collections
+import socket
+import sys
+import time
+
+import rover_protocol
+
+SUBSCRIBE_INTERVAL_S = 1.0  # well inside the rover's TELEMETRY_SUB_TIMEOUT_MS
+MOTOR_FORWARD, MOTOR_REVERSE = 1, 2
+
+CSV_COLUMNS = (["t_us", "seq", "loop_busy_us", "loop_late_us"] +
+               [f"pulse{i}" for i in range(rover_protocol.NUM_SERVOS)] +
+               [f"speed{i}" for i in range(rover_protocol.NUM_MOTORS)] +
+               ["rx_packets", "rx_dropped", "free_heap"] +
+               [f"target_cps{i}" for i in range(rover_protocol.NUM_MOTORS)] +
+               [f"speed_cps{i}" for i in range(rover_protocol.NUM_MOTORS)])
+
+
+def signed_speeds(sample):
+    """Motor duty with the direction folded into the sign (brake and stop read 0)."""
+    out = []
+    for d, duty in zip(sample["dir"], sample["duty"]):
+        out.append(duty if d == MOTOR_FORWARD else -duty if d == MOTOR_REVERSE else 0)
+    return out
+
+
+def csv_row(sample):
+    values = ([sample["t_us"], sample["seq"], sample["loop_busy_us"], sample["loop_late_us"]] +
+              sample["pulse"] + signed_speeds(sample) +
+              [sample["rx_packets"], sample["rx_dropped"], sample["free_heap"]] +
+              sample["target_cps"] + ["" if v is None else v for v in sample["speed_cps"]])
+    return ",".join(str(v) for v in values)
+
+
+class Receiver:
+    """Subscribes, receives and decodes samples, and counts the ones lost on the way."""
+
+    def __init__(self, addr):
+        self.addr = addr
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(("", 0))
+        self.sock.settimeout(0.1)
+        self.last_sub = 0.0
+        self.last_seq = None
+        self.received = 0
+        self.lost = 0
+
+    def poll(self):
+        """Samples that arrived since the last call (waits up to 0.1 s for one datagram)."""
+        now = time.monotonic()
+        if now - self.last_sub >= SUBSCRIBE_INTERVAL_S:
+            self.sock.sendto(rover_protocol.encode_telemetry_sub(), self.addr)
+            self.last_sub = now
+        try:
+            datagram = self.sock.recv(2048)
+        except OSError:  # timeout, or ICMP unreachable while the rover is down
+            return []
+        samples = []
+        try:
+            for msg_type, payload in rover_protocol.iter_frames(datagram):
+                if msg_type == rover_protocol.MSG_TELEMETRY:
+                    samples.append(rover_protocol.decode_telemetry(payload))
+        except rover_protocol.ProtocolError:
+            pass
+        for s in samples:
+            if self.last_seq is not None:
+                self.lost += (s["seq"] - self.last_seq - 1) & 0xFFFF
+            self.last_seq = s["seq"]
+        self.received += len(samples)
+        return samples
+
+
+def print_status(sample, rx):
+    pulses = " ".join(f"{p:4d}" if p != 0xFFFF else "   -" for p in sample["pulse"])
+    speeds = " ".join(f"{v:+4d}" for v in signed_speeds(sample))
+    wheels = " ".join(f"{v:+5d}" if v is not None else "    -" for v in sample["speed_cps"])
+    print(f"t {sample['t_us'] / 1e6:9.3f}s  pulse {pulses} | duty {speeds} | cps {wheels} | "
+          f"loop {sample['loop_busy_us']}us late {sample['loop_late_us']}us | "
+          f"rx {sample['rx_packets']} drop {sample['rx_dropped']} | heap {sample['free_heap']} | "
+          f"samples {rx.received} lost {rx.lost}")
+
+
+def run_text(rx, args, out):
+    deadline = time.monotonic() + args.duration if args.duration else None
+    last_print = 0.0
+    while deadline is None or time.monotonic() < deadline:
+        samples = rx.poll()
+        if out:
+            for s in samples:
+                out.write(csv_row(s) + "\n")
+        now = time.monotonic()
+        if samples and out is not sys.stdout and now - last_print >= args.interval:
+            print_status(samples[-1], rx)
+            last_print = now
+
+
+def run_plot(rx, args, out):
+    import matplotlib.pyplot as plt
+    from matplotlib.animation import FuncAnimation
+
+    history = collections.deque()
+    fig, (ax_servo, ax_motor, ax_wheel, ax_loop) = plt.subplots(4, 1, sharex=True, figsize=(10, 10))
+    servo_lines = [ax_servo.plot([], [], label=f"servo {i}")[0] for i in range(rover_protocol.NUM_SERVOS)]
+    motor_lines = [ax_motor.plot([], [], label=f"motor {i}")[0] for i in range(rover_protocol.NUM_MOTORS)]
+    wheel_lines = [ax_wheel.plot([], [], label=f"wheel {i}")[0] for i in range(rover_protocol.NUM_MOTORS)]
+    busy_line, = ax_loop.plot([], [], label="busy")
+    late_line, = ax_loop.plot([], [], label="late")
+    ax_servo.set_ylabel("pulse (counts)")
+    ax_motor.set_ylabel("duty")
+    ax_motor.set_ylim(-260, 260)
+    ax_wheel.set_ylabel("wheel speed (counts/s)")
+    ax_loop.set_ylabel("control loop (us)")
+    ax_loop.set_xlabel("rover time (s)")
+    for ax in (ax_servo, ax_motor, ax_wheel, ax_loop):
+        ax.legend(loc="upper left", fontsize="small", ncol=3)
+
+    def update(_):
+        samples = rx.poll()
+        if out:
+            for s in samples:
+                out.write(csv_row(s) + "\n")
+        history.extend(samples)
+        if not history:
+            return []
+        newest = history[-1]["t_us"]
+        while ((newest - history[0]["t_us"]) & 0xFFFFFFFF) > args.window * 1e6:
+            history.popleft()
+        t = [(newest - ((newest - s["t_us"]) & 0xFFFFFFFF)) / 1e6 for s in history]
+        for i, line in enumerate(servo_lines):
+            line.set_data(t, [s["pulse"][i] if s["pulse"][i] != 0xFFFF else float("nan") for s in history])
+        speeds = [signed_speeds(s) for s in history]
+        for i, line in enumerate(motor_lines):
+            line.set_data(t, [v[i] for v in speeds])
+        for i, line in enumerate(wheel_lines):
+            line.set_data(t, [s["speed_cps"][i] if s["speed_cps"][i] is not None else float("nan") for s in history])
+        busy_line.set_data(t, [s["loop_busy_us"] for s in history])
+        late_line.set_data(t, [s["loop_late_us"] for s in history])
+        for ax in (ax_servo, ax_wheel, ax_loop):
+            ax.relim()
+            ax.autoscale_view()
+        ax_motor.set_xlim(t[0], max(t[-1], t[0] + 1e-3))
+        fig.suptitle(f"rx {history[-1]['rx_packets']}  drop {history[-1]['rx_dropped']}  "
+                     f"heap {history[-1]['free_heap']}  lost samples {rx.lost}")
+        return servo_lines + motor_lines + wheel_lines + [busy_line, late_line]
+
+    anim = FuncAnimation(fig, update, interval=50, cache_frame_data=False)
+    plt.show()
+    return anim
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--ip", default="192.168.1.73")
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--csv", help="write every sample to this file ('-' for stdout)")
+    ap.add_argument("--plot", action="store_true", help="live plot (needs matplotlib)")
+    ap.add_argument("--window", type=float, default=10.0, help="seconds of history in the plot")
+    ap.add_argument("--interval", type=float, default=1.0, help="seconds between status lines")
+    ap.add_argument("--duration", type=float, help="stop after this many seconds")
+    args = ap.parse_args()
+
+    rx = Receiver((args.ip, args.port))
+    out = None
+    if args.csv:
+        out = sys.stdout if args.csv == "-" else open(args.csv, "w")
+        out.write(",".join(CSV_COLUMNS) + "\n")
+    try:
+        if args.plot:
+            run_plot(rx, args, out)
+        else:
+            run_text(rx, args, out)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if out and out is not sys.stdout:
+            out.close()
+        print(f"{rx.received} samples, {rx.lost} lost", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+"""Decode binary trace records written by lib/Trace/trace.c.
+
+The firmware prints each record as a line "TRC <core> <32 hex chars>". Feed
+this script a captured log file, or a serial port to decode live:
+
+    python trace_decode.py capture.log
+    python trace_decode.py --port COM3
+
+Non-trace lines are passed through unchanged.
+"""
+
+import argparse
+import struct
+import sys
+
+# Must match trace_event_t in lib/Trace/trace.h: (name, a0 label, a1 label)
+EVENTS = {
+    1: ("RX", "len", "type"),
+    2: ("REJECT", "len", "err"),
+    3: ("SERVO_PULSE", "ch", "pulse"),
+    4: ("SERVO_FLUSH", "first", "count"),
+    5: ("I2C_ERROR", "reg", "err"),
+    6: ("MOTOR_DIR", "ledc", "dir"),
+    7: ("MOTOR_DUTY", "ledc", "duty"),
+    8: ("LEDC_ERROR", "ledc", "err"),
+    9: ("SEQ_DROP", "type", "seq"),
+}
+
+RECORD = struct.Struct("<IHHii")
+
+
+def decode_line(line):
+    parts = line.split()
+    if len(parts) != 3 or parts[0] != "TRC":
+        return line
+    core, payload = parts[1], parts[2]
+    if payload == "DROP":
+        return line
+    try:
+        ts_us, event, a0, a1, a2 = RECORD.unpack(bytes.fromhex(payload))
+    except ValueError:
+        return line
+    name, l0, l1 = EVENTS.get(event, (f"EV{event}", "a0", "a1"))
+    return f"[{ts_us / 1e6:12.6f}] core{core} {name:<12} {l0}={a0} {l1}={a1} a2={a2}"
+
+
+def lines_from_port(port, baud):
+    import serial  # pyserial, only needed for live decoding
+
+    with serial.Serial(port=port, baudrate=baud, timeout=1) as ser:
+        while True:
+            raw = ser.readline()
+            if raw:
+                yield raw.decode(errors="replace").rstrip("\r\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("file", nargs="?", help="captured console log (default: stdin)")
+    ap.add_argument("--port", help="serial port to read live instead of a file")
+    ap.add_argument("--baud", type=int, default=115200)
+    args = ap.parse_args()
+
+    if args.port:
+        source = lines_from_port(args.port, args.baud)
+    else:
+        stream = open(args.file) if args.file else sys.stdin
+        source = (l.rstrip("\r\n") for l in stream)
+
+    for line in source:
+        print(decode_line(line))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,303 @@
+"""Load generator and session replayer for the rover's UDP command path.
+
+    python udp_load.py [--ip 192.168.1.73] --rates 50,100,200,500 [--duration 5]
+    python udp_load.py --ip 127.0.0.1 --rate 1000 --burst 10 --json out.json
+    python udp_load.py --replay session.txt [--speed 2]
+
+Works against the real rover or the host build (rover_host, 127.0.0.1).
+Synthetic streams send DRIVE frames (or --kind motor/servo/steer) at a
+fixed rate; --burst N sends them in back-to-back groups of N at rate/N.
+--rates runs one stream per rate in turn, which finds the point where the
+receive path starts losing datagrams.
+
+A replay file is what controller-to-esp32-wifi.py writes with RECORD_PATH
+set: one datagram per line as "<seconds since start> <hex bytes>". Binary
+commands in it are re-stamped with fresh sequence numbers and timestamps.
+
+Each run reports:
+  sent         datagrams put on the socket
+  delivered    datagrams the firmware received (rx_packets delta from the
+               stats query before and after the run; excludes the queries)
+  echoed       DRIVE echoes that came back, with round-trip percentiles
+  reordered    echoes that arrived after a later sequence number
+  duplicates   sequence numbers echoed more than once
+  rover        per-stage latency percentiles from the firmware histograms,
+               for the commands of this run only
+"""
+
+import argparse
+import json
+import math
+import socket
+import sys
+import threading
+import time
+
+import rover_protocol
+import stats_query
+
+
+def now_us():
+    return int(time.monotonic() * 1e6)
+
+
+def synthetic_frame(kind, i, seq, echo):
+    """Frame number i of a synthetic stream: a slow sweep, so consecutive values differ."""
+    phase = math.sin(i * 0.05)
+    if kind == "drive":
+        return rover_protocol.encode_drive(seq, rover_protocol.steer_q15(phase), int(200 * phase), now_us(), echo)
+    if kind == "motor":
+        return rover_protocol.encode_motor(int(200 * phase), seq, now_us())
+    if kind == "servo":
+        return rover_protocol.encode_servo([90 + 45 * phase] * rover_protocol.NUM_SERVOS, seq, now_us())
+    return rover_protocol.encode_steer(phase, seq, now_us())
+
+
+def load_session(path):
+    """Read a recorded session: list of (offset_s, datagram)."""
+    session = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            t, data = line.split(None, 1)
+            session.append((float(t), bytes.fromhex(data)))
+    return session
+
+
+def restamp(datagram, seq, echo):
+    """Give a recorded command this run's sequence number and clock (and DRIVE its echo flag).
+
+    Without this a second replay would repeat the first one's sequence
+    numbers and the rover would drop it as stale.
+    """
+    try:
+        msg_type, values = rover_protocol.decode(datagram)
+    except rover_protocol.ProtocolError:
+        return datagram, False  # text commands and queries go out as recorded
+    if msg_type == rover_protocol.MSG_DRIVE:
+        _, _, _, _, steer, speed = values
+        return rover_protocol.encode_drive(seq, steer, speed, now_us(), echo), True
+    if msg_type in (rover_protocol.MSG_SERVO, rover_protocol.MSG_MOTOR, rover_protocol.MSG_STEER):
+        return rover_protocol.encode(msg_type, values, seq, now_us()), False
+    return datagram, False
+
+
+class EchoCollector(threading.Thread):
+    """Receives DRIVE echoes and tracks round-trip time, reordering and duplicates."""
+
+    def __init__(self, sock):
+        super().__init__(daemon=True)
+        self.sock = sock
+        self.rtt_us = []
+        self.seen = set()
+        self.highest = None
+        self.reordered = 0
+        self.duplicates = 0
+        self.stop = False
+
+    def run(self):
+        self.sock.settimeout(0.1)
+        while not self.stop:
+            try:
+                datagram = self.sock.recv(2048)
+            except OSError:  # includes the timeout that lets stop be noticed
+                continue
+            t = now_us()
+            try:
+                frames = list(rover_protocol.iter_frames(datagram))
+            except rover_protocol.ProtocolError:
+                continue
+            for msg_type, payload in frames:
+                if msg_type == rover_protocol.MSG_DRIVE_ECHO:
+                    self.on_echo(*rover_protocol.decode_drive_echo(payload), t)
+
+    def on_echo(self, seq, t_sent, t_rx):
+        if seq in self.seen:
+            self.duplicates += 1
+            return
+        self.seen.add(seq)
+        self.rtt_us.append((t_rx - t_sent) & 0xFFFFFFFF)
+        if self.highest is not None and (seq - self.highest) & 0xFFFF >= 0x8000:
+            self.reordered += 1
+        else:
+            self.highest = seq
+
+
+def percentiles(values, pcts=(50, 90, 99)):
+    if not values:
+        return None
+    s = sorted(values)
+    out = {"min": s[0], "max": s[-1]}
+    for p in pcts:
+        out[f"p{p}"] = s[min(len(s) - 1, int(math.ceil(p / 100.0 * len(s))) - 1)]
+    return out
+
+
+def snapshot(addr, timeout):
+    """Stats snapshot on its own socket, so the reply never mixes with echoes."""
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        return stats_query.query(s, addr, timeout)
+    except socket.timeout:
+        return None
+    finally:
+        s.close()
+
+
+def rover_delta(before, after):
+    """Counters and per-stage percentiles accumulated between two snapshots."""
+    if before is None or after is None:
+        return None
+    counters = {k: after[0].get(k, 0) - (0 if k in stats_query.GAUGES else before[0].get(k, 0))
+                for k in stats_query.COUNTERS}
+    stages = {}
+    for key, buckets in after[1].items():
+        prev = before[1].get(key, [0] * len(buckets))
+        delta = [a - b for a, b in zip(buckets, prev)]
+        if not sum(delta):
+            continue
+        cmd, stage = key
+        name = f"{stats_query.CMDS[cmd]}.{stats_query.STAGES[stage]}"
+        stages[name] = {"count": sum(delta)}
+        stages[name].update({f"p{p}_us": stats_query.percentile(delta, p) for p in stats_query.PERCENTILES})
+    return {"counters": counters, "latency": stages}
+
+
+def sleep_until(deadline):
+    # Sleep most of the way, then spin: time.sleep alone overshoots by up to a scheduler tick.
+    while True:
+        left = deadline - time.perf_counter()
+        if left <= 0:
+            return
+        if left > 0.002:
+            time.sleep(left - 0.001)
+
+
+def run_stream(args, addr, schedule, label):
+    """Send (offset_s, make_datagram) pairs on schedule and measure the result."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", 0))
+    collector = EchoCollector(sock)
+    collector.start()
+
+    before = snapshot(addr, args.timeout)
+    sent = 0
+    send_errors = 0
+    seq = 0
+    start = time.perf_counter()
+    for offset, make in schedule:
+        sleep_until(start + offset)
+        datagram, tracked = make(seq, not args.no_echo)
+        seq = (seq + 1) & 0xFFFF
+        try:
+            sock.sendto(datagram, addr)
+            sent += 1
+        except OSError:
+            send_errors += 1  # e.g. ENOBUFS when the local queue is full
+    elapsed = time.perf_counter() - start
+
+    time.sleep(args.drain)
+    collector.stop = True
+    collector.join()
+    after = snapshot(addr, args.timeout)
+    sock.close()
+
+    rover = rover_delta(before, after)
+    result = {
+        "run": label,
+        "duration_s": round(elapsed, 3),
+        "sent": sent,
+        "send_errors": send_errors,
+        "offered_pps": round(sent / elapsed, 1) if elapsed > 0 else None,
+        # Each snapshot counts its own query, so the delta holds one extra packet.
+        "delivered": rover["counters"]["rx_packets"] - 1 if rover else None,
+        "echoed": len(collector.rtt_us) if not args.no_echo else None,
+        "reordered": collector.reordered,
+        "duplicates": collector.duplicates,
+        "rtt_us": percentiles(collector.rtt_us),
+        "rover": rover,
+    }
+    if result["delivered"] is not None and sent:
+        result["loss_pct"] = round(100.0 * (sent - result["delivered"]) / sent, 2)
+    return result
+
+
+def synthetic_schedule(kind, rate, burst, duration):
+    groups = max(1, int(round(rate * duration / burst)))
+    period = burst / float(rate)
+    schedule = []
+    i = 0
+    for g in range(groups):
+        for _ in range(burst):
+            n = i
+            schedule.append((g * period, lambda seq, echo, n=n: (synthetic_frame(kind, n, seq, echo), kind == "drive")))
+            i += 1
+    return schedule
+
+
+def replay_schedule(session, speed):
+    return [(t / speed, lambda seq, echo, d=d: restamp(d, seq, echo)) for t, d in session]
+
+
+def print_result(r):
+    rtt = r["rtt_us"]
+    rtt_s = f"rtt p50 {rtt['p50']}us p99 {rtt['p99']}us max {rtt['max']}us" if rtt else "rtt -"
+    delivered = "?" if r["delivered"] is None else r["delivered"]
+    loss = f" ({r['loss_pct']}% lost)" if "loss_pct" in r else ""
+    print(f"{r['run']:<22} sent {r['sent']:>6} @ {r['offered_pps']} pps  delivered {delivered}{loss}  "
+          f"echoed {r['echoed']}  reordered {r['reordered']}  dup {r['duplicates']}  {rtt_s}")
+    if r["rover"]:
+        for name, st in sorted(r["rover"]["latency"].items()):
+            cols = "  ".join(f"p{p} {stats_query.fmt_us(st[f'p{p}_us'])}" for p in stats_query.PERCENTILES)
+            print(f"    {name:<16} n={st['count']:<6} {cols}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--ip", default="192.168.1.73")
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--kind", choices=["drive", "motor", "servo", "steer"], default="drive")
+    ap.add_argument("--rate", type=float, default=100.0, help="datagrams per second")
+    ap.add_argument("--rates", help="comma-separated rates to sweep, one run each")
+    ap.add_argument("--burst", type=int, default=1, help="datagrams sent back to back per tick")
+    ap.add_argument("--duration", type=float, default=5.0, help="seconds per run")
+    ap.add_argument("--replay", help="recorded session to replay instead of a synthetic stream")
+    ap.add_argument("--speed", type=float, default=1.0, help="replay time scale (2 = twice as fast)")
+    ap.add_argument("--no-echo", action="store_true", help="do not ask for DRIVE echoes (no return traffic)")
+    ap.add_argument("--drain", type=float, default=0.5, help="seconds to wait for late echoes")
+    ap.add_argument("--timeout", type=float, default=1.0, help="stats query timeout")
+    ap.add_argument("--json", help="write results as JSON to this file ('-' for stdout)")
+    args = ap.parse_args()
+
+    addr = (args.ip, args.port)
+    runs = []
+    if args.replay:
+        session = load_session(args.replay)
+        runs.append(("replay x%g" % args.speed, replay_schedule(session, args.speed)))
+    else:
+        rates = [float(r) for r in args.rates.split(",")] if args.rates else [args.rate]
+        for rate in rates:
+            label = f"{args.kind} {rate:g}pps" + (f" b{args.burst}" if args.burst > 1 else "")
+            runs.append((label, synthetic_schedule(args.kind, rate, args.burst, args.duration)))
+
+    results = []
+    for label, schedule in runs:
+        r = run_stream(args, addr, schedule, label)
+        results.append(r)
+        if args.json != "-":
+            print_result(r)
+
+    if args.json:
+        doc = {"target": f"{args.ip}:{args.port}", "time": time.time(), "runs": results}
+        if args.json == "-":
+            json.dump(doc, sys.stdout, indent=2)
+            print()
+        else:
+            with open(args.json, "w") as f:
+                json.dump(doc, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+#include <math.h>
+#include "ackermann.h"
+
+#define ACK_TABLE_SIZE  (1 << ACK_TABLE_BITS)
+#define ACK_FRAC_BITS   (15 - ACK_TABLE_BITS)
+
+// Inner and outer front wheel deflection from straight ahead, 0.1 degree units.
+static int16_t inner_dd[ACK_TABLE_SIZE + 1];
+static int16_t outer_dd[ACK_TABLE_SIZE + 1];
+
+void ackermann_init() {
+    for (int i = 0; i <= ACK_TABLE_SIZE; i++) {
+        float mag = (float)i / ACK_TABLE_SIZE;
+        float r = ACK_R_MIN + (ACK_R_MAX - ACK_R_MIN) * (1.0f - mag);
+        float inner = atanf(ACK_WHEELBASE / (r - ACK_TRACK_WIDTH / 2)) * (180.0f / (float)M_PI);
+        float outer = atanf(ACK_WHEELBASE / (r + ACK_TRACK_WIDTH / 2)) * (180.0f / (float)M_PI);
+        inner_dd[i] = (int16_t)lroundf(inner * ROVER_ANGLE_SCALE);
+        outer_dd[i] = (int16_t)lroundf(outer * ROVER_ANGLE_SCALE);
+    }
+}
+
+static inline int32_t lookup(const int16_t *table, uint32_t mag) {
+    uint32_t idx = mag >> ACK_FRAC_BITS;
+    int32_t frac = mag & ((1 << ACK_FRAC_BITS) - 1);
+    if (idx >= ACK_TABLE_SIZE) {
+        return table[ACK_TABLE_SIZE];
+    }
+    int32_t a = table[idx];
+    int32_t b = table[idx + 1];
+    return a + (((b - a) * frac + (1 << (ACK_FRAC_BITS - 1))) >> ACK_FRAC_BITS);
+}
+
+static inline uint16_t clamp_dd(int32_t dd) {
+    if (dd < ACK_ANGLE_MIN_DD) {
+        return ACK_ANGLE_MIN_DD;
+    }
+    if (dd > ACK_ANGLE_MAX_DD) {
+        return ACK_ANGLE_MAX_DD;
+    }
+    return (uint16_t)dd;
+}
+
+void ackermann_angles(int16_t steer, uint16_t angle_dd[ROVER_NUM_SERVOS]) {
+    if (steer == 0) {
+        for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+            angle_dd[i] = ACK_CENTER_DD;
+        }
+        return;
+    }
+
+    uint32_t mag = steer < 0 ? -(int32_t)steer : steer;
+    if (mag > 32767) {
+        mag = 32767;
+    }
+    // Scale Q15 magnitude so that 32767 lands on the last table entry.
+    mag = (mag * 32768 + 16383) / 32767;
+    int32_t inner = lookup(inner_dd, mag);
+    int32_t outer = lookup(outer_dd, mag);
+
+    // Rear wheels countersteer; the middle pair always stays neutral.
+    if (steer > 0) {  // turning right
+        angle_dd[0] = clamp_dd(ACK_CENTER_DD + inner);
+        angle_dd[1] = clamp_dd(ACK_CENTER_DD + outer);
+        angle_dd[4] = clamp_dd(ACK_CENTER_DD - inner);
+        angle_dd[5] = clamp_dd(ACK_CENTER_DD - outer);
+    } else {          // turning left
+        angle_dd[0] = clamp_dd(ACK_CENTER_DD - outer);
+        angle_dd[1] = clamp_dd(ACK_CENTER_DD - inner);
+        angle_dd[4] = clamp_dd(ACK_CENTER_DD + outer);
+        angle_dd[5] = clamp_dd(ACK_CENTER_DD + inner);
+    }
+    angle_dd[2] = ACK_CENTER_DD;
+    angle_dd[3] = ACK_CENTER_DD;
+}
@@ -0,0 +1,41 @@
+#ifndef ACKERMANN_H
+#define ACKERMANN_H
+
+#include <stdint.h>
+#include "protocol.h"
+
+/*
+** On-board Ackermann steering. A single steering scalar (Q15, -32767 = full
+** left, 32767 = full right) is turned into the six wheel angles with the same
+** geometry python/controller-to-esp32-wifi.py uses. The atan() work is done
+** once at init into fixed-point tables indexed by |steer|; per call it is two
+** table lookups with linear interpolation and no floating point.
+*/
+
+// Geometry, in cm. Must match the PC client if it still computes angles itself.
+#ifndef ACK_WHEELBASE
+#define ACK_WHEELBASE   16.0f
+#endif
+#ifndef ACK_TRACK_WIDTH
+#define ACK_TRACK_WIDTH 2.4f
+#endif
+#ifndef ACK_R_MIN
+#define ACK_R_MIN       20.0f   // tightest turn radius
+#endif
+#ifndef ACK_R_MAX
+#define ACK_R_MAX       200.0f  // largest turn radius
+#endif
+
+// Servo limits in 0.1 degree units (45 - 135 degrees).
+#define ACK_ANGLE_MIN_DD (45 * ROVER_ANGLE_SCALE)
+#define ACK_ANGLE_MAX_DD (135 * ROVER_ANGLE_SCALE)
+#define ACK_CENTER_DD    (90 * ROVER_ANGLE_SCALE)
+
+#define ACK_TABLE_BITS 8
+
+void ackermann_init();
+
+// Wheel order: front-left, front-right, middle-left, middle-right, rear-left, rear-right.
+void ackermann_angles(int16_t steer, uint16_t angle_dd[ROVER_NUM_SERVOS]);
+
+#endif
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "bench.h"
+#include "protocol.h"
+#include "pca9685.h"
+
+#ifdef HOST_CYCLE_UNIT
+#define BENCH_PLATFORM "host"
+#define BENCH_UNIT HOST_CYCLE_UNIT
+#else
+#define BENCH_PLATFORM CONFIG_IDF_TARGET
+#define BENCH_UNIT "cycles"
+#endif
+
+#define NUM_INPUTS 16   // distinct inputs per benchmark, cycled through
+
+typedef struct {
+    const char *name;
+    void (*fn)(uint32_t i);     // one call of the function under test, on input i
+} bench_t;
+
+static uint32_t samples[BENCH_SAMPLES];
+
+// Inputs, built once by setup().
+static uint8_t drive_frames[NUM_INPUTS][ROVER_PROTO_MAX_FRAME];
+static size_t drive_lens[NUM_INPUTS];
+static char servo_texts[NUM_INPUTS][40];
+static size_t servo_text_lens[NUM_INPUTS];
+static uint16_t angles_dd[NUM_INPUTS];
+static l298n_t *motor;
+
+// Results land here so the compiler cannot drop the calls.
+static volatile uint32_t sink;
+
+static void run_empty(uint32_t i) {
+}
+
+static void run_parse_binary(uint32_t i) {
+    rover_cmd_t cmd;
+    sink = rover_decode(drive_frames[i % NUM_INPUTS], drive_lens[i % NUM_INPUTS], &cmd);
+}
+
+static void run_parse_text(uint32_t i) {
+    rover_cmd_t cmd;
+    sink = rover_decode((const uint8_t *)servo_texts[i % NUM_INPUTS], servo_text_lens[i % NUM_INPUTS], &cmd);
+}
+
+static void run_pulse_math(uint32_t i) {
+    sink = pca9685_angle_to_pulse(i % NUM_SERVOS, angles_dd[i % NUM_INPUTS]);
+}
+
+static void run_sine(uint32_t i) {
+    uint16_t angles[NUM_SERVOS];
+    pca9685_sine_angles((uint8_t)i, angles, NUM_SERVOS);
+    sink = angles[0];
+}
+
+static void run_set_motor(uint32_t i) {
+    sink = l298n_set_motor(motor, 0, MOTOR_FORWARD, (int16_t)(i & 1));
+}
+
+static const bench_t benches[] = {
+    {"parse_binary", run_parse_binary},
+    {"parse_text", run_parse_text},
+    {"pulse_math", run_pulse_math},
+    {"sine", run_sine},
+    {"l298n_set_motor", run_set_motor},
+};
+
+static void setup(l298n_t *motor_board) {
+    motor = motor_board;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        rover_cmd_t cmd = {
+            .type = ROVER_MSG_DRIVE,
+            .drive = {.seq = i, .t_us = 1000u * i, .steer = (int16_t)(i * 4000 - 32000), .speed = (int16_t)(i * 32 - 255)},
+        };
+        drive_lens[i] = rover_encode(&cmd, drive_frames[i], sizeof(drive_frames[i]));
+        int a = 45 + (i * 37) % 91;
+        servo_text_lens[i] = snprintf(servo_texts[i], sizeof(servo_texts[i]), "S,%d,%d,%d,%d,%d,%d", a, 180 - a, a, 180 - a, a, 180 - a);
+        angles_dd[i] = (uint16_t)((i * 1129) % (PCA9685_ANGLE_MAX_DD + 1));
+    }
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Time BENCH_SAMPLES single calls of fn, overhead taken off each; sorts samples[].
+static void measure(void (*fn)(uint32_t), uint32_t overhead) {
+    for (uint32_t i = 0; i < BENCH_WARMUP; i++) {
+        fn(i);
+    }
+    for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+        esp_cpu_cycle_count_t t0 = esp_cpu_get_cycle_count();
+        fn(i);
+        uint32_t d = esp_cpu_get_cycle_count() - t0;
+        samples[i] = d > overhead ? d - overhead : 0;
+    }
+    qsort(samples, BENCH_SAMPLES, sizeof(samples[0]), cmp_u32);
+}
+
+// Counter ticks per microsecond, against esp_timer over 100 ms.
+static double counter_mhz(void) {
+    int64_t t0 = esp_timer_get_time();
+    esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+    while (esp_timer_get_time() - t0 < 100000) {
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    return cycles / (double)(esp_timer_get_time() - t0);
+}
+
+void bench_run(l298n_t *motor_board, FILE *out) {
+    setup(motor_board);
+    double mhz = counter_mhz();
+    measure(run_empty, 0);
+    uint32_t overhead = samples[0];
+
+    fprintf(out, "{\"bench\": \"rover-hot\", \"platform\": \"%s\", \"unit\": \"%s\", \"counter_mhz\": %.1f,\n",
+            BENCH_PLATFORM, BENCH_UNIT, mhz);
+    fprintf(out, " \"samples\": %d, \"overhead\": %u,\n \"results\": [\n", BENCH_SAMPLES, (unsigned)overhead);
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        measure(benches[b].fn, overhead);
+        fprintf(out, "  {\"name\": \"%s\", \"min\": %u, \"median\": %u, \"p99\": %u}%s\n", benches[b].name,
+                (unsigned)samples[0], (unsigned)samples[BENCH_SAMPLES / 2], (unsigned)samples[BENCH_SAMPLES * 99 / 100],
+                b + 1 < sizeof(benches) / sizeof(benches[0]) ? "," : "");
+    }
+    fprintf(out, "]}\n");
+    fflush(out);
+    l298n_set_motor(motor, 0, MOTOR_STOP, 0);
+}
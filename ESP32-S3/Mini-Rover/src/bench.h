@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "l298n.h"
+
+/*
+** Micro-benchmarks of the firmware's hot functions, the same code on the
+** rover and on the host.
+**
+** Every call is timed on its own with esp_cpu_get_cycle_count(): CCOUNT on
+** the ESP32-S3, the time-stamp counter on an x86 host (host/shim/esp_cpu.h).
+** The cost of reading the counter around an empty call is measured first and
+** taken off every sample. Inputs vary from call to call so the driver
+** shadows and branch predictors see what they see in flight.
+**
+**   parse_binary     rover_decode() of a DRIVE frame
+**   parse_text       rover_decode() of a legacy "S,..." servo command
+**   pulse_math       pca9685_angle_to_pulse()
+**   sine             pca9685_sine_angles() for all servos
+**   l298n_set_motor  one wheel, alternating between duty 0 and 1 so every
+**                    call writes the LEDC channel (1/255 does not turn it)
+**
+** bench_run() prints one JSON document:
+**
+**   {"bench": "rover-hot", "platform": "esp32s3" or "host",
+**    "unit": "cycles" ("tsc" or "ns" on the host), "counter_mhz": ...,
+**    "samples": N, "overhead": ...,
+**    "results": [{"name": ..., "min": ..., "median": ..., "p99": ...}, ...]}
+**
+** python/bench_compare.py checks it against a stored baseline. On the host
+** run host/bench/bench_hot; on the rover, build with -DROVER_BENCH=1 and the
+** firmware prints the document on the console at boot instead of starting.
+*/
+
+#ifndef ROVER_BENCH
+#define ROVER_BENCH 0
+#endif
+
+#define BENCH_SAMPLES 2000
+#define BENCH_WARMUP 100
+
+// Run every benchmark, using motor A of motor_board, and print the results to out.
+void bench_run(l298n_t *motor_board, FILE *out);
+
+#endif
@@ -0,0 +1,64 @@
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "boot.h"
+
+static const char *TAG = "BOOT";
+
+static const char *const phase_names[BOOT_NUM_PHASES] = {
+    [BOOT_APP_MAIN] = "app_main",
+    [BOOT_NVS] = "nvs",
+    [BOOT_PCA9685] = "pca9685",
+    [BOOT_MOTORS] = "motors",
+    [BOOT_RECORDER] = "recorder",
+    [BOOT_CONTROL] = "control",
+    [BOOT_WIFI] = "wifi",
+    [BOOT_UDP] = "udp",
+    [BOOT_FIRST_CMD] = "first_cmd",
+};
+
+// 0 until marked; esp_timer is well past 0 by the time app_main() runs.
+static _Atomic int64_t marks[BOOT_NUM_PHASES];
+
+bool boot_mark(boot_phase_t phase) {
+    if (phase >= BOOT_NUM_PHASES || atomic_load_explicit(&marks[phase], memory_order_relaxed) != 0) {
+        return false;
+    }
+    int64_t expected = 0;
+    return atomic_compare_exchange_strong(&marks[phase], &expected, esp_timer_get_time());
+}
+
+int64_t boot_get(boot_phase_t phase) {
+    if (phase >= BOOT_NUM_PHASES) {
+        return -1;
+    }
+    int64_t t = atomic_load_explicit(&marks[phase], memory_order_relaxed);
+    return t ? t : -1;
+}
+
+void boot_report() {
+    // Phases overlap with FAST_BOOT, so list them by time rather than by enum order.
+    int order[BOOT_NUM_PHASES];
+    int64_t when[BOOT_NUM_PHASES];
+    int n = 0;
+    for (int p = 0; p < BOOT_NUM_PHASES; p++) {
+        int64_t t = boot_get(p);
+        if (t < 0) {
+            continue;
+        }
+        int i = n++;
+        while (i > 0 && when[i - 1] > t) {
+            order[i] = order[i - 1];
+            when[i] = when[i - 1];
+            i--;
+        }
+        order[i] = p;
+        when[i] = t;
+    }
+
+    ESP_LOGI(TAG, "Boot phases (FAST_BOOT=%d), ms since startup:", FAST_BOOT);
+    for (int i = 0; i < n; i++) {
+        int64_t step = i ? when[i] - when[i - 1] : when[i];
+        ESP_LOGI(TAG, "  %-10s %9.1f  (+%.1f)", phase_names[order[i]], when[i] / 1000.0, step / 1000.0);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+** Boot sequencing and boot-time instrumentation.
+**
+** With FAST_BOOT=1 app_main() skips the 5 s wait for the serial monitor and
+** runs wifi_init() in its own task while the I2C bus, PCA9685, motor boards,
+** recorder and control loop come up, so association overlaps peripheral
+** setup instead of following it. The UDP server starts once both are done.
+** FAST_BOOT=0 keeps the sequential boot with time to attach a monitor.
+**
+** boot_mark() stamps each phase with esp_timer time (microseconds since
+** startup). The table is logged when the first command is accepted, which
+** closes the power-on to first-command measurement.
+*/
+
+#ifndef FAST_BOOT
+#define FAST_BOOT 0
+#endif
+
+typedef enum {
+    BOOT_APP_MAIN = 0,  // app_main() entered
+    BOOT_NVS,           // NVS ready
+    BOOT_PCA9685,       // I2C bus up and PCA9685 configured
+    BOOT_MOTORS,        // L298N boards initialized
+    BOOT_RECORDER,      // flight recorder resumed
+    BOOT_CONTROL,       // control loop running
+    BOOT_WIFI,          // wifi_init() returned
+    BOOT_UDP,           // UDP socket bound
+    BOOT_FIRST_CMD,     // first command accepted
+    BOOT_NUM_PHASES
+} boot_phase_t;
+
+// Stamp a phase. Only the first mark of each phase counts; returns true for it.
+bool boot_mark(boot_phase_t phase);
+
+// Time a phase was reached, or -1 if it has not been yet.
+int64_t boot_get(boot_phase_t phase);
+
+// Log the phases reached so far in time order, with the step from the previous one.
+void boot_report();
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "control.h"
+#include "setpoint.h"
+#include "pca9685.h"
+#include "stats.h"
+#include "ackermann.h"
+#include "recorder.h"
+#include "speed.h"
+#include "profiler.h"
+
+static const char *TAG = "CONTROL";
+
+_Static_assert(CONTROL_RATE_HZ % CONTROL_SERVO_RATE_HZ == 0, "servo rate must divide the control rate");
+
+static l298n_t *boards;
+static control_shaper_t shaper;
+
+// Outputs last written to the recorder; only changes are logged.
+static int16_t last_speed[ROVER_NUM_MOTORS];
+static uint16_t last_angle_dd[ROVER_NUM_SERVOS];
+
+// Worst iteration time and wake-up lateness since the last control_take_timing().
+static atomic_uint busy_us_max, late_us_max;
+
+static inline void note_max(atomic_uint *max, uint32_t v) {
+    if (v > atomic_load_explicit(max, memory_order_relaxed)) {
+        atomic_store_explicit(max, v, memory_order_relaxed);
+    }
+}
+
+static esp_err_t apply_servos(const uint16_t angle_dd[ROVER_NUM_SERVOS]) {
+    // Set all servo angles in one I2C burst. Both sides use tenths of a degree.
+    _Static_assert(ROVER_ANGLE_SCALE == PCA9685_ANGLE_SCALE, "servo angle units differ");
+    return pca9685_set_servos_dd(angle_dd, NUM_SERVOS);
+}
+
+// Wheel order matches the servo order: board 1 A/B, board 2 A/B, board 3 A/B.
+static esp_err_t apply_motors(const int16_t speed[ROVER_NUM_MOTORS]) {
+    _Static_assert(ROVER_NUM_MOTORS == L298N_NUM_MOTORS, "wheel count differs from the motor board table");
+#if SPEED_CONTROL
+    // Speed targets; the speed task owns the motor outputs and writes them on its own period.
+    speed_set_targets(speed);
+    return ESP_OK;
+#else
+    // All wheels change together; only outputs whose direction or duty changed reach the hardware.
+    return l298n_set_all(boards, L298N_NUM_BOARDS, speed);
+#endif
+}
+
+/* Servo writes complete in the I2C bus engine, after the control task has
+** moved on. Each write with a new command gets a slot here and a bus marker
+** behind it; the marker's callback records the latency from the slot. The
+** bus is drained long before the ring comes round again.
+*/
+#define SERVO_STAMPS 4
+
+typedef struct {
+    int64_t rx_us;
+    int64_t issue_us;
+} servo_stamp_t;
+
+static servo_stamp_t servo_stamps[SERVO_STAMPS];
+static uint32_t servo_stamp_next;
+
+// Account a setpoint that is being applied: parse and queue latency, and how many updates it superseded.
+static void record_issue(stats_cmd_t cmd, uint32_t gen_delta, int64_t rx_us, int64_t parsed_us, int64_t issue_us) {
+    if (gen_delta > 1) {
+        stats_count(STATS_SUPERSEDED, gen_delta - 1);
+    }
+    stats_record(cmd, STATS_STAGE_PARSE, parsed_us - rx_us);
+    stats_record(cmd, STATS_STAGE_QUEUE, issue_us - parsed_us);
+}
+
+// Bus engine callback: the servo writes for the command in slot arg are out.
+static void servo_written(esp_err_t err, void *arg) {
+    const servo_stamp_t *st = &servo_stamps[(uintptr_t)arg];
+    int64_t done_us = esp_timer_get_time();
+    stats_record(STATS_CMD_SERVO, STATS_STAGE_ACTUATE, done_us - st->issue_us);
+    stats_record(STATS_CMD_SERVO, STATS_STAGE_TOTAL, done_us - st->rx_us);
+}
+
+// Log an output vector to the flight recorder if it differs from the last one logged.
+static void record_outputs(uint8_t type, void *last, const void *now, size_t len) {
+    if (memcmp(last, now, len) != 0) {
+        memcpy(last, now, len);
+        RECORD(type, now, len);
+    }
+}
+
+static bool motors_moving(const int16_t speed[ROVER_NUM_MOTORS]) {
+    for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+        if (speed[i] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// esp_timer callback: wake the control task for the next period.
+static void control_tick(void *arg) {
+    xTaskNotifyGive((TaskHandle_t)arg);
+}
+
+void control_shaper_init(control_shaper_t *sh, int64_t now_us) {
+    *sh = (control_shaper_t){.last_us = now_us, .last_servo_us = now_us};
+    for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+        interp_init(&sh->servo_ch[i], CONTROL_SERVO_MAX_RATE, CONTROL_SERVO_MAX_ACCEL, 0, ROVER_ANGLE_MAX_DD);
+    }
+    for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+        interp_init(&sh->motor_ch[i], CONTROL_MOTOR_MAX_RATE, CONTROL_MOTOR_MAX_ACCEL, -255, 255);
+        interp_reset(&sh->motor_ch[i], 0);
+    }
+}
+
+void control_shaper_step(control_shaper_t *sh, const setpoint_t *sp, int64_t now_us, control_out_t *out) {
+    const int32_t period_us = 1000000 / CONTROL_RATE_HZ;
+    const int servo_divider = CONTROL_RATE_HZ / CONTROL_SERVO_RATE_HZ;
+
+    if (sp->servo_gen != sh->servo_gen) {
+        uint16_t angle_dd[ROVER_NUM_SERVOS];
+        const uint16_t *target = sp->angle_dd;
+        if (sp->steer_mode) {
+            ackermann_angles(sp->steer, angle_dd);
+            target = angle_dd;
+        }
+        for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+            interp_set_target(&sh->servo_ch[i], target[i], sp->servo_rx_us);
+        }
+        sh->servo_pending += sp->servo_gen - sh->servo_gen;
+        sh->servo_gen = sp->servo_gen;
+    }
+
+    out->motor_updates = sp->motor_gen - sh->motor_gen;
+    sh->motor_gen = sp->motor_gen;
+#if L298N_RAMP_MS > 0
+    // The LEDC fade engine ramps the motors, so only a new command reaches the driver.
+    for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+        out->speed[i] = sp->speed[i];
+    }
+    out->motor_write = out->motor_updates != 0;
+#else
+    // After a stall, move as if one period passed rather than jumping.
+    int32_t dt_us = (now_us - sh->last_us > 4 * period_us) ? period_us : (int32_t)(now_us - sh->last_us);
+    sh->last_us = now_us;
+
+    if (out->motor_updates) {
+        for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+            interp_set_target(&sh->motor_ch[i], sp->speed[i], sp->motor_rx_us);
+        }
+    }
+    for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+        out->speed[i] = interp_step(&sh->motor_ch[i], now_us, dt_us);
+    }
+    out->motor_write = true;
+#endif
+
+    out->servo_write = false;
+    out->servo_updates = 0;
+    if (++sh->tick % servo_divider == 0) {
+        int32_t servo_dt = (int32_t)(now_us - sh->last_servo_us);
+        if (servo_dt > 4 * servo_divider * period_us) {
+            servo_dt = servo_divider * period_us;
+        }
+        sh->last_servo_us = now_us;
+
+        // Servos are not written until the first servo command arrives.
+        if (sh->servo_gen != 0) {
+            for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+                out->angle_dd[i] = interp_step(&sh->servo_ch[i], now_us, servo_dt);
+            }
+            out->servo_write = true;
+            out->servo_updates = sh->servo_pending;
+            sh->servo_pending = 0;
+        }
+    }
+}
+
+/* Fixed-rate actuation loop. Each period it takes whatever setpoint the
+** receive task published last, feeds new targets to the interpolators and
+** writes the shaped outputs, so a slow I2C write only delays this task and
+** never the network receive path. The driver shadows drop writes whose
+** output did not change, so once a channel settles it costs no bus traffic.
+*/
+static void control_task(void *arg) {
+    const int32_t period_us = 1000000 / CONTROL_RATE_HZ;
+    uint32_t servo_bus_errors = 0;  // PCA9685 write errors already counted
+    setpoint_t sp;
+    control_out_t out;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = control_tick,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "control",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_handle_t timer;
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(timer, period_us));
+
+    ESP_LOGI(TAG, "Control loop running at %d Hz (servos %d Hz) on core %d", CONTROL_RATE_HZ, CONTROL_SERVO_RATE_HZ, CONTROL_TASK_CORE);
+
+    int64_t last_wake_us = esp_timer_get_time();
+    control_shaper_init(&shaper, last_wake_us);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now_us = esp_timer_get_time();
+        if (now_us - last_wake_us > period_us) {
+            note_max(&late_us_max, (uint32_t)(now_us - last_wake_us - period_us));
+        }
+        last_wake_us = now_us;
+        PROFILE_WAKE(PROFILER_LOOP_CONTROL, now_us, period_us);
+
+        setpoint_read(&sp);
+        control_shaper_step(&shaper, &sp, now_us, &out);
+
+        int64_t issue_us = esp_timer_get_time();
+        if (out.motor_write) {
+            if (apply_motors(out.speed) != ESP_OK) {
+                stats_count(STATS_LEDC_ERRORS, 1);
+            }
+            record_outputs(REC_MOTOR, last_speed, out.speed, sizeof(out.speed));
+            // A sector erase stalls this loop along with everything else running from flash; keep them to standstill.
+            recorder_hold_erase(motors_moving(out.speed));
+        }
+        if (out.motor_updates) {
+            record_issue(STATS_CMD_MOTOR, out.motor_updates, sp.motor_rx_us, sp.motor_parsed_us, issue_us);
+#if SPEED_CONTROL
+            // The speed task writes the duties on its next period and records the rest there.
+            speed_note_command(sp.motor_rx_us, issue_us);
+#else
+            int64_t done_us = esp_timer_get_time();
+            stats_record(STATS_CMD_MOTOR, STATS_STAGE_ACTUATE, done_us - issue_us);
+            stats_record(STATS_CMD_MOTOR, STATS_STAGE_TOTAL, done_us - sp.motor_rx_us);
+#endif
+        }
+
+        if (out.servo_write) {
+            // Servo writes are queued on the I2C engine; bus failures surface later through the driver's error count.
+            issue_us = esp_timer_get_time();
+            if (apply_servos(out.angle_dd) != ESP_OK) {
+                stats_count(STATS_I2C_ERRORS, 1);
+            }
+            record_outputs(REC_SERVO, last_angle_dd, out.angle_dd, sizeof(out.angle_dd));
+            pca9685_stats_t pst;
+            pca9685_get_stats(&pst);
+            if (pst.write_errors != servo_bus_errors) {
+                stats_count(STATS_I2C_ERRORS, pst.write_errors - servo_bus_errors);
+                servo_bus_errors = pst.write_errors;
+            }
+            if (out.servo_updates) {
+                record_issue(STATS_CMD_SERVO, out.servo_updates, sp.servo_rx_us, sp.servo_parsed_us, issue_us);
+                uint32_t slot = servo_stamp_next++ % SERVO_STAMPS;
+                servo_stamps[slot] = (servo_stamp_t){.rx_us = sp.servo_rx_us, .issue_us = issue_us};
+                pca9685_when_done(servo_written, (void *)(uintptr_t)slot);
+            }
+        }
+        note_max(&busy_us_max, (uint32_t)(esp_timer_get_time() - now_us));
+    }
+}
+
+void control_start(l298n_t *motor_boards) {
+    boards = motor_boards;
+    ackermann_init();
+    xTaskCreatePinnedToCore(control_task, "control_task", CONTROL_TASK_STACK, NULL, CONTROL_TASK_PRIORITY, NULL, CONTROL_TASK_CORE);
+}
+
+void control_take_timing(control_timing_t *out) {
+    out->busy_us_max = atomic_exchange_explicit(&busy_us_max, 0, memory_order_relaxed);
+    out->late_us_max = atomic_exchange_explicit(&late_us_max, 0, memory_order_relaxed);
+}
@@ -0,0 +1,86 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "l298n.h"
+#include "interp.h"
+#include "setpoint.h"
+
+// Rate at which the control task steps the interpolators and updates the motors.
+// Paced by an esp_timer, so it is not limited to the FreeRTOS tick rate.
+#ifndef CONTROL_RATE_HZ
+#define CONTROL_RATE_HZ 200
+#endif
+
+// Servo update rate. The PCA9685 only latches a new pulse once per 50 Hz
+// frame, so there is nothing to gain above that. Must divide CONTROL_RATE_HZ.
+#ifndef CONTROL_SERVO_RATE_HZ
+#define CONTROL_SERVO_RATE_HZ 50
+#endif
+
+// Slew-rate and acceleration limits (see interp.h). Servos in tenths of a
+// degree, motors in speed units (-255..255: speed targets with SPEED_CONTROL,
+// duty without). The motor limits are unused when L298N_RAMP_MS hands motor
+// ramping to the LEDC fade engine.
+#ifndef CONTROL_SERVO_MAX_RATE
+#define CONTROL_SERVO_MAX_RATE 6000     // 600 deg/s, about a standard servo's no-load speed
+#endif
+#ifndef CONTROL_SERVO_MAX_ACCEL
+#define CONTROL_SERVO_MAX_ACCEL 60000
+#endif
+#ifndef CONTROL_MOTOR_MAX_RATE
+#define CONTROL_MOTOR_MAX_RATE 1000     // stop to full duty in about 0.25 s
+#endif
+#ifndef CONTROL_MOTOR_MAX_ACCEL
+#define CONTROL_MOTOR_MAX_ACCEL 10000
+#endif
+
+// The UDP task and Wi-Fi stack live on core 0; actuation gets core 1 to itself.
+#ifndef CONTROL_TASK_CORE
+#define CONTROL_TASK_CORE 1
+#endif
+
+#define CONTROL_TASK_STACK 4096
+#define CONTROL_TASK_PRIORITY 6
+
+typedef struct {
+    uint32_t busy_us_max;   // longest loop iteration, wake-up to last write issued
+    uint32_t late_us_max;   // longest gap between wake-ups beyond one period
+} control_timing_t;
+
+/* Output shaping state of the control loop, kept apart from the hardware so
+** host tools (host/log_replay.c) can run recorded commands through exactly
+** the logic the rover uses.
+*/
+typedef struct {
+    interp_chan_t servo_ch[ROVER_NUM_SERVOS];
+    interp_chan_t motor_ch[ROVER_NUM_MOTORS];
+    uint32_t servo_gen, motor_gen;  // setpoint generations already taken in
+    uint32_t servo_pending;         // servo updates taken in since the last servo write
+    int64_t last_us, last_servo_us;
+    uint32_t tick;
+} control_shaper_t;
+
+// What one control period wants written.
+typedef struct {
+    bool motor_write;
+    uint32_t motor_updates;         // motor setpoints taken in this period
+    int16_t speed[ROVER_NUM_MOTORS];
+    bool servo_write;
+    uint32_t servo_updates;         // servo setpoints folded into this write
+    uint16_t angle_dd[ROVER_NUM_SERVOS];
+} control_out_t;
+
+void control_shaper_init(control_shaper_t *sh, int64_t now_us);
+
+// One control period at now_us: take in sp and compute the outputs. Needs ackermann_init().
+void control_shaper_step(control_shaper_t *sh, const setpoint_t *sp, int64_t now_us, control_out_t *out);
+
+// motor_boards holds L298N_NUM_BOARDS boards set up by init_motor_controllers().
+void control_start(l298n_t *motor_boards);
+
+// Worst-case loop timing since the previous call; both maxima restart from zero.
+void control_take_timing(control_timing_t *out);
+
+#endif
@@ -0,0 +1,125 @@
+#include "interp.h"
+
+#define ONE         (1 << INTERP_FRAC_BITS)
+#define US_PER_S    1000000
+
+static int32_t clamp32(int64_t v, int32_t lo, int32_t hi) {
+    return v < lo ? lo : (v > hi ? hi : (int32_t)v);
+}
+
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t res = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+void interp_init(interp_chan_t *ch, int32_t max_rate, int32_t max_accel, int32_t min_out, int32_t max_out) {
+    *ch = (interp_chan_t){
+        .max_rate = max_rate,
+        .max_accel = max_accel,
+        .min_out = min_out,
+        .max_out = max_out,
+    };
+}
+
+void interp_reset(interp_chan_t *ch, int32_t value) {
+    value = clamp32(value, ch->min_out, ch->max_out);
+    ch->target = ch->prev_target = value;
+    ch->target_us = ch->prev_target_us = 0;
+    ch->pos = value * ONE;
+    ch->vel = 0;
+    ch->primed = true;
+}
+
+void interp_set_target(interp_chan_t *ch, int32_t target, int64_t rx_us) {
+    target = clamp32(target, ch->min_out, ch->max_out);
+    if (!ch->primed) {
+        interp_reset(ch, target);
+        ch->target_us = ch->prev_target_us = rx_us;
+        return;
+    }
+    ch->prev_target = ch->target;
+    ch->prev_target_us = ch->target_us;
+    ch->target = target;
+    ch->target_us = rx_us;
+}
+
+/* Reference the output chases at now_us: the latest target, continued along
+** the slope of the last two targets until the next packet is due. A packet
+** later than that means the stream stopped or changed, so the reference goes
+** back to the last value actually received.
+*/
+static int32_t reference(const interp_chan_t *ch, int64_t now_us) {
+    int64_t interval = ch->target_us - ch->prev_target_us;
+    int64_t late = now_us - ch->target_us;
+    if (interval <= 0 || interval > INTERP_EXTRAP_MAX_US || late <= 0 || late > interval) {
+        return ch->target;
+    }
+    int64_t ref = ch->target + (int64_t)(ch->target - ch->prev_target) * late / interval;
+    return clamp32(ref, ch->min_out, ch->max_out);
+}
+
+int32_t interp_step(interp_chan_t *ch, int64_t now_us, int32_t dt_us) {
+    if (!ch->primed || dt_us <= 0) {
+        return interp_output(ch);
+    }
+
+    int32_t ref = reference(ch, now_us) * ONE;
+    int32_t err = ref - ch->pos;
+    int64_t mag = err < 0 ? -(int64_t)err : err;
+
+    // Fastest velocity that still stops on the reference: v^2 <= 2 * a * distance.
+    int64_t v_max = (int64_t)ch->max_rate * ONE;
+    int64_t v_brake = isqrt64(2 * (uint64_t)ch->max_accel * (uint64_t)mag * ONE);
+    int64_t v_reach = mag * US_PER_S / dt_us;
+    int64_t v_want = v_max;
+    if (v_brake < v_want) {
+        v_want = v_brake;
+    }
+    if (v_reach < v_want) {
+        v_want = v_reach;
+    }
+    if (err < 0) {
+        v_want = -v_want;
+    }
+
+    // Acceleration limit on the change in velocity this step.
+    int64_t dv_max = (int64_t)ch->max_accel * ONE * dt_us / US_PER_S;
+    if (dv_max < 1) {
+        dv_max = 1;
+    }
+    int64_t dv = v_want - ch->vel;
+    if (dv > dv_max) {
+        dv = dv_max;
+    } else if (dv < -dv_max) {
+        dv = -dv_max;
+    }
+    ch->vel += (int32_t)dv;
+
+    int64_t pos = ch->pos + (int64_t)ch->vel * dt_us / US_PER_S;
+
+    // Crossing the reference means it was reached this step.
+    if ((err > 0 && pos > ref) || (err < 0 && pos < ref)) {
+        pos = ref;
+    }
+    ch->pos = clamp32(pos, ch->min_out * ONE, ch->max_out * ONE);
+    return interp_output(ch);
+}
+
+int32_t interp_output(const interp_chan_t *ch) {
+    // Round half away from zero so symmetric motion gives symmetric output.
+    int32_t p = ch->pos;
+    return p >= 0 ? (p + ONE / 2) >> INTERP_FRAC_BITS : -((-p + ONE / 2) >> INTERP_FRAC_BITS);
+}
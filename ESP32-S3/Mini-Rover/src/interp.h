@@ -0,0 +1,57 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Setpoint shaping between sparse network commands and the drivers.
+**
+** Each output channel tracks the latest received target. Between packets the
+** target is extrapolated along the slope of the last two packets for up to
+** one packet interval; streams slower than INTERP_EXTRAP_MAX_US, and packets
+** later than that, fall back to the last received value.
+** The output follows that reference under a per-channel slew-rate and
+** acceleration limit, braking early so it settles on the reference without
+** overshoot. Everything is integer and updated in place; a step costs the
+** same regardless of how many packets arrived.
+*/
+
+// Packet intervals longer than this are not extrapolated.
+#ifndef INTERP_EXTRAP_MAX_US
+#define INTERP_EXTRAP_MAX_US 100000
+#endif
+
+// Fractional bits of the internal position and velocity.
+#define INTERP_FRAC_BITS 8
+
+typedef struct {
+    // Limits, in output units (e.g. deci-degrees or duty) per second and per second^2.
+    int32_t max_rate;
+    int32_t max_accel;
+    int32_t min_out, max_out;
+
+    // Last two targets and the esp_timer time they were received.
+    int32_t target, prev_target;
+    int64_t target_us, prev_target_us;
+
+    int32_t pos;    // output, Q(INTERP_FRAC_BITS) units
+    int32_t vel;    // Q(INTERP_FRAC_BITS) units per second
+    bool primed;    // false until the first target arrives
+} interp_chan_t;
+
+void interp_init(interp_chan_t *ch, int32_t max_rate, int32_t max_accel, int32_t min_out, int32_t max_out);
+
+// Put the channel at rest on value, e.g. motors at 0 on boot.
+void interp_reset(interp_chan_t *ch, int32_t value);
+
+// Record a newly received target. On a channel that was never reset the first target snaps the output to it.
+void interp_set_target(interp_chan_t *ch, int32_t target, int64_t rx_us);
+
+// Advance the output by dt_us to time now_us and return it, rounded to whole units.
+int32_t interp_step(interp_chan_t *ch, int64_t now_us, int32_t dt_us);
+
+// Current output in whole units.
+int32_t interp_output(const interp_chan_t *ch);
+
+#endif
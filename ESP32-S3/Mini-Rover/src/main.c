@@ -7,119 +7,105 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include "esp_wifi.h"
 #include "esp_log.h"
-#include "lwip/sockets.h"
 #include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "pca9685.h"
 #include "esp32wifi.h"
 #include "l298n.h"
+#include "control.h"
+#include "trace.h"
+#include "recorder.h"
+#include "boot.h"
+#include "speed.h"
+#include "plant.h"
+#include "udp_rx.h"
+#include "profiler.h"
+#include "bench.h"
+#include "esp_timer.h"
 
 static const char *TAG = "MAIN";
 
-l298n_t board1, board2, board3;
+// Wheel speeds come from the encoders, or from simulated motors where there are none.
+#if SPEED_SOURCE_SIM
+#define SPEED_SOURCE plant_source
+#else
+#define SPEED_SOURCE speed_source_encoder
+#endif
 
-void udp_server_task(void *arg) {
-    struct sockaddr_in server_addr, client_addr;
-    char rx_buffer[128];
-    int speedVal = 0;
-    int16_t absSpeed = 0;
-    socklen_t addr_len = sizeof(client_addr);
+l298n_t motor_boards[L298N_NUM_BOARDS];
 
-    // Create UDP socket
-    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sock < 0) {
-        ESP_LOGE("UDP", "Failed to create socket: errno %d", errno);
-        speedVal = 0;
-        vTaskDelete(NULL);
-    }
-
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    server_addr.sin_port = htons(SERVER_PORT);
-
-    if (bind(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        ESP_LOGE(TAG, "Socket bind failed: errno %d", errno);
-        speedVal = 0;
-        close(sock);
-        vTaskDelete(NULL);
-    }
-
-    ESP_LOGI(TAG, "UDP server listening on port %d", SERVER_PORT);
+#if FAST_BOOT
+static SemaphoreHandle_t wifi_done;
 
-    while (1) {
-        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0, (struct sockaddr *)&client_addr, &addr_len);
-        if (len > 0) {
-            rx_buffer[len] = 0;  // Null-terminate the received string
-            ESP_LOGI(TAG, "Received: %s", rx_buffer);
-
-            if (rx_buffer[0] == 'S'){
-                // Parse received angles
-                int angles[NUM_SERVOS];
-                if (sscanf(rx_buffer, "S,%d,%d,%d,%d,%d,%d", 
-                        &angles[0], &angles[1], &angles[2], 
-                        &angles[3], &angles[4], &angles[5]) == NUM_SERVOS) {
-                    ESP_LOGI(TAG, "Parsed angles: %d, %d, %d, %d, %d, %d", 
-                        angles[0], angles[1], angles[2],
-                        angles[3], angles[4], angles[5]);
-                } else {
-                    ESP_LOGE(TAG, "Failed to parse UDP command.");
-                }
-
-                // Set servo angles
-                for (int i = 0; i < NUM_SERVOS; i++) {
-                    pca9685_set_servo_angle(i, angles[i]);
-                }// end for
-            }// end if
-            else if (rx_buffer[0] == 'M'){
-                if (sscanf(rx_buffer, "M,%d", &speedVal) == 1){
-                    ESP_LOGI(TAG, "Parsed motor speed: %d", speedVal);
-                    motorDirection_t dir;
-                    absSpeed = 0;
-                    if (speedVal > 0){
-                        dir = MOTOR_FORWARD;
-                        absSpeed = speedVal;
-                    } else if (speedVal < 0){
-                        dir = MOTOR_REVERSE;
-                        absSpeed = -speedVal;
-                    } else{
-                        dir = MOTOR_STOP;
-                        absSpeed = 0;
-                    }
-                    if (absSpeed > 255){
-                        absSpeed = 255;
-                    }
-                    // Apply the same drive command to all motors on the three boards.
-                    l298n_set_motor(&board1, 0, dir, absSpeed);
-                    l298n_set_motor(&board1, 1, dir, absSpeed);
-                    l298n_set_motor(&board2, 0, dir, absSpeed);
-                    l298n_set_motor(&board2, 1, dir, absSpeed);
-                    l298n_set_motor(&board3, 0, dir, absSpeed);
-                    l298n_set_motor(&board3, 1, dir, absSpeed);
-                } else {
-                    ESP_LOGE(TAG, "Failed to parse motor command.");
-                } 
-            } else {
-                ESP_LOGE(TAG, "Unknown command received.");
-            }
-        }// end if
-    }// end while
-
-    close(sock);
+// Association runs here while app_main() sets up the peripherals.
+static void wifi_task(void *arg) {
+    wifi_init();
+    boot_mark(BOOT_WIFI);
+    print_ip_address();
+    xSemaphoreGive(wifi_done);
     vTaskDelete(NULL);
 }
+#endif
 
 void app_main() {
+    boot_mark(BOOT_APP_MAIN);
+#if !FAST_BOOT
     vTaskDelay(pdMS_TO_TICKS(5000)); // This delay allows time for the monitor to launch
+#endif
     printf("\n\nStarting application...\n");
+
+    // NVS holds the servo calibration, so it has to be up before pca9685_init().
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    boot_mark(BOOT_NVS);
+
+#if FAST_BOOT
+    // The Wi-Fi driver needs NVS too, but nothing else below.
+    wifi_done = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(wifi_task, "wifi_init", 4096, NULL, 5, NULL, 0);
+#endif
+
     i2c_master_init();
     printf("i2c master initialized\n");
     pca9685_init();
-    init_motor_controllers(&board1, &board2, &board3);
+    boot_mark(BOOT_PCA9685);
+    init_motor_controllers(motor_boards);
+    boot_mark(BOOT_MOTORS);
+#if ROVER_BENCH
+    // Bench build: time the hot paths on the drivers just brought up, print the results and stop.
+    bench_run(&motor_boards[0], stdout);
+    return;
+#endif
+    profiler_start();
+    // Started before the network so every command received is on the log.
+    if (recorder_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Flight recorder unavailable");
+    }
+    boot_mark(BOOT_RECORDER);
+
+    trace_start_drain_task();
+#if SPEED_CONTROL
+    speed_start(motor_boards, &SPEED_SOURCE);
+#endif
+    control_start(motor_boards);
+    boot_mark(BOOT_CONTROL);
+
+#if FAST_BOOT
+    xSemaphoreTake(wifi_done, portMAX_DELAY);
+    vSemaphoreDelete(wifi_done);
+#else
     wifi_init();
+    boot_mark(BOOT_WIFI);
     print_ip_address();
-
-    xTaskCreate(udp_server_task, "udp_server_task", 4096, NULL, 5, NULL);
+#endif
+    udp_rx_start(UDP_RX_RAW ? UDP_RX_LWIP_RAW : UDP_RX_SOCKET, SERVER_PORT, motor_boards);
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include <math.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "plant.h"
+
+// Integration step; the model is stiff enough that a whole speed period at once overshoots.
+#define PLANT_STEP_US 500
+
+static const float default_load[ROVER_NUM_MOTORS] = {0.04f, 0.10f, 0.06f, 0.02f, 0.12f, 0.05f};
+
+void plant_init(plant_t *p, int64_t now_us) {
+    memset(p, 0, sizeof(*p));
+    p->tau_s = 0.08f;
+    p->no_load_cps = SPEED_NO_LOAD_CPS;
+    p->stiction = 0.04f;
+    memcpy(p->load, default_load, sizeof(p->load));
+    p->last_us = now_us;
+}
+
+static void step_wheel(plant_t *p, int w, float dt) {
+    float u = p->duty[w] / (float)L298N_MAX_DUTY;
+    float v = p->cps[w];
+    float load = p->load[w];
+
+    if (v == 0.0f && fabsf(u) <= load + p->stiction) {
+        return;
+    }
+    // The load opposes the motion, or the drive when at rest.
+    float dir = v != 0.0f ? (v > 0.0f ? 1.0f : -1.0f) : (u > 0.0f ? 1.0f : -1.0f);
+    float drive = (u - dir * load) * p->no_load_cps;
+    float next = v + (drive - v) * dt / p->tau_s;
+    // Friction stops the wheel rather than pushing it backwards.
+    if (v != 0.0f && (next > 0.0f) != (v > 0.0f)) {
+        next = 0.0f;
+    }
+    p->cps[w] = next;
+
+    float travel = next * dt + p->frac[w];
+    float whole = truncf(travel);
+    p->counts[w] += (int32_t)whole;
+    p->frac[w] = travel - whole;
+}
+
+void plant_advance(plant_t *p, int64_t now_us) {
+    while (now_us - p->last_us >= PLANT_STEP_US) {
+        for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+            step_wheel(p, w, PLANT_STEP_US / 1e6f);
+        }
+        p->last_us += PLANT_STEP_US;
+    }
+}
+
+static plant_t sim;
+
+static esp_err_t sim_init(void *ctx, uint8_t *mask) {
+    plant_init(ctx, esp_timer_get_time());
+    *mask = (1u << ROVER_NUM_MOTORS) - 1;
+    return ESP_OK;
+}
+
+static void sim_read(void *ctx, int32_t counts[ROVER_NUM_MOTORS]) {
+    plant_t *p = ctx;
+    plant_advance(p, esp_timer_get_time());
+    memcpy(counts, p->counts, sizeof(p->counts));
+}
+
+static void sim_applied(void *ctx, const int16_t duty[ROVER_NUM_MOTORS]) {
+    plant_t *p = ctx;
+    memcpy(p->duty, duty, sizeof(p->duty));
+}
+
+const speed_source_t plant_source = {
+    .name = "plant",
+    .init = sim_init,
+    .read = sim_read,
+    .applied = sim_applied,
+    .ctx = &sim,
+};
@@ -0,0 +1,40 @@
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdint.h>
+#include "speed.h"
+
+/*
+** Simulated drive motors, a speed source for builds without encoders.
+**
+** Each wheel is a first-order DC motor: at duty u (-1..1) it heads for
+** u * no_load_cps minus its load, with time constant tau_s. A wheel at
+** rest stays put until the duty overcomes its load plus the stiction.
+** Position is integrated into encoder counts, so the speed loop measures
+** it exactly the way it measures a real encoder.
+**
+** The loads differ per wheel (plant_init() sets a fixed, uneven table), so
+** an open-loop rover would not drive straight.
+*/
+
+typedef struct {
+    float tau_s;
+    float no_load_cps;
+    float stiction;                 // duty fraction needed to break away, on top of the load
+    float load[ROVER_NUM_MOTORS];   // steady-state slowdown as a fraction of no_load_cps
+    float cps[ROVER_NUM_MOTORS];
+    float frac[ROVER_NUM_MOTORS];   // count fraction not yet reported
+    int32_t counts[ROVER_NUM_MOTORS];
+    int16_t duty[ROVER_NUM_MOTORS];
+    int64_t last_us;
+} plant_t;
+
+void plant_init(plant_t *p, int64_t now_us);
+
+// Run the model to now_us under the duty last applied.
+void plant_advance(plant_t *p, int64_t now_us);
+
+// Speed source on a plant_t running in esp_timer time.
+extern const speed_source_t plant_source;
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "profiler.h"
+#include "protocol.h"
+
+_Static_assert(PROFILER_REPORT_MAX == (ROVER_PROTO_HEADER_LEN + ROVER_PROTO_CRC_LEN) * (1 + PROFILER_MAX_TASKS + PROFILER_NUM_LOOPS) +
+               PROFILER_SUMMARY_LEN + PROFILER_TASK_LEN * PROFILER_MAX_TASKS + PROFILER_LOOP_LEN * PROFILER_NUM_LOOPS,
+               "PROFILER_REPORT_MAX does not match the frame layout");
+
+#if PROFILER_ENABLE
+
+#if !(CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+#error "PROFILER_ENABLE needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS"
+#endif
+
+static const char *TAG = "PROFILER";
+
+/* Wake-up accounting of one loop. next_us belongs to the loop's task; the
+** counters are taken and cleared by the profiler task once per window.
+*/
+typedef struct {
+    int64_t next_us;        // next deadline, 0 before the first wake-up
+    atomic_uint period_us;
+    atomic_uint wakes, missed, late_sum_us, late_max_us;
+} loop_state_t;
+
+static loop_state_t loops[PROFILER_NUM_LOOPS];
+
+// Run-time counters at the start of the window, by task. Profiler task only.
+static struct {
+    TaskHandle_t handle;
+    uint32_t run_time;
+} prev[PROFILER_MAX_TASKS];
+static int num_prev;
+static TaskStatus_t status[PROFILER_MAX_TASKS];
+
+/* The encoded report of the last window, double buffered: the profiler
+** task fills the buffer that is not published, then switches report_cur to
+** it. Readers copy the published buffer without retrying, so a reader that
+** preempts the writer (both UDP tasks outrank it on core 0) never waits on
+** it. The writer only comes back to a buffer one PROFILER_PERIOD_MS after
+** publishing the other, far longer than any copy.
+*/
+static struct {
+    uint8_t data[PROFILER_REPORT_MAX];
+    size_t len;
+} report[2];
+static atomic_int report_cur = -1;     // published buffer, -1 before the first window
+
+static inline uint16_t sat_u16(uint32_t v) {
+    return v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+}
+
+// Share of window_us that delta_us is, in 0.01 %.
+static inline uint16_t load_of(uint32_t delta_us, uint32_t window_us) {
+    uint64_t load = (uint64_t)delta_us * 10000 / (window_us ? window_us : 1);
+    return load > 10000 ? 10000 : (uint16_t)load;
+}
+
+void profiler_wake(profiler_loop_t loop, int64_t now_us, int32_t period_us) {
+    loop_state_t *l = &loops[loop];
+    if (l->next_us == 0) {
+        l->next_us = now_us + period_us;
+        atomic_store_explicit(&l->period_us, (uint32_t)period_us, memory_order_relaxed);
+        return;
+    }
+    // An esp_timer wake-up can land a little ahead of the grid; that counts as on time.
+    int64_t late_us = now_us > l->next_us ? now_us - l->next_us : 0;
+    uint32_t skipped = (uint32_t)(late_us / period_us);
+    l->next_us += (int64_t)(skipped + 1) * period_us;
+
+    atomic_fetch_add_explicit(&l->wakes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&l->missed, skipped, memory_order_relaxed);
+    atomic_fetch_add_explicit(&l->late_sum_us, (uint32_t)late_us, memory_order_relaxed);
+    if ((uint32_t)late_us > atomic_load_explicit(&l->late_max_us, memory_order_relaxed)) {
+        atomic_store_explicit(&l->late_max_us, (uint32_t)late_us, memory_order_relaxed);
+    }
+}
+
+// Run-time counter delta of a task since the last sample; a new task counts from 0.
+static uint32_t run_delta(TaskHandle_t handle, uint32_t run_time) {
+    for (int i = 0; i < num_prev; i++) {
+        if (prev[i].handle == handle) {
+            return run_time - prev[i].run_time;
+        }
+    }
+    return run_time;
+}
+
+// Encode one window into buf; the run-time deltas are against prev[].
+static size_t encode_window(const TaskStatus_t *tasks, int num_tasks, uint32_t window_us, uint8_t *buf, size_t cap) {
+    uint8_t payload[PROFILER_SUMMARY_LEN];
+    uint16_t idle[2] = {PROFILER_IDLE_UNKNOWN, PROFILER_IDLE_UNKNOWN};
+    size_t used, n;
+
+    for (int c = 0; c < portNUM_PROCESSORS && c < 2; c++) {
+        TaskHandle_t h = xTaskGetIdleTaskHandleForCore(c);
+        for (int i = 0; h != NULL && i < num_tasks; i++) {
+            if (tasks[i].xHandle == h) {
+                idle[c] = load_of(run_delta(h, tasks[i].ulRunTimeCounter), window_us);
+            }
+        }
+    }
+
+    put_u32le(payload, (uint32_t)(esp_timer_get_time() / 1000));
+    put_u32le(payload + 4, window_us);
+    put_u32le(payload + 8, esp_get_free_heap_size());
+    put_u32le(payload + 12, esp_get_minimum_free_heap_size());
+    put_u16le(payload + 16, idle[0]);
+    put_u16le(payload + 18, idle[1]);
+    put_u16le(payload + 20, configTICK_RATE_HZ);
+    payload[22] = (uint8_t)num_tasks;
+    payload[23] = PROFILER_NUM_LOOPS;
+    used = rover_encode_frame(ROVER_MSG_PROF_SUMMARY, payload, PROFILER_SUMMARY_LEN, buf, cap);
+    if (used == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < num_tasks; i++) {
+        const TaskStatus_t *t = &tasks[i];
+        BaseType_t core = xTaskGetCoreID(t->xHandle);
+        memset(payload, 0, PROFILER_TASK_LEN);
+        strncpy((char *)payload, t->pcTaskName, PROFILER_NAME_LEN);
+        put_u16le(payload + 16, load_of(run_delta(t->xHandle, t->ulRunTimeCounter), window_us));
+        put_u16le(payload + 18, sat_u16(t->usStackHighWaterMark));
+        payload[20] = (uint8_t)t->uxCurrentPriority;
+        payload[21] = core == tskNO_AFFINITY ? PROFILER_CORE_ANY : (uint8_t)core;
+        n = rover_encode_frame(ROVER_MSG_PROF_TASK, payload, PROFILER_TASK_LEN, buf + used, cap - used);
+        if (n == 0) {
+            return used;
+        }
+        used += n;
+    }
+
+    for (int l = 0; l < PROFILER_NUM_LOOPS; l++) {
+        loop_state_t *s = &loops[l];
+        uint32_t wakes = atomic_exchange_explicit(&s->wakes, 0, memory_order_relaxed);
+        uint32_t late_sum = atomic_exchange_explicit(&s->late_sum_us, 0, memory_order_relaxed);
+        memset(payload, 0, PROFILER_LOOP_LEN);
+        payload[0] = l;
+        put_u32le(payload + 4, atomic_load_explicit(&s->period_us, memory_order_relaxed));
+        put_u32le(payload + 8, wakes);
+        put_u32le(payload + 12, atomic_exchange_explicit(&s->missed, 0, memory_order_relaxed));
+        put_u32le(payload + 16, wakes ? late_sum / wakes : 0);
+        put_u32le(payload + 20, atomic_exchange_explicit(&s->late_max_us, 0, memory_order_relaxed));
+        n = rover_encode_frame(ROVER_MSG_PROF_LOOP, payload, PROFILER_LOOP_LEN, buf + used, cap - used);
+        if (n == 0) {
+            return used;
+        }
+        used += n;
+    }
+    return used;
+}
+
+static void profiler_task(void *arg) {
+    bool warned = false;
+    int64_t last_us = 0;
+
+    while (1) {
+        int64_t now_us = esp_timer_get_time();
+        configRUN_TIME_COUNTER_TYPE total;
+        int num_tasks = (int)uxTaskGetSystemState(status, PROFILER_MAX_TASKS, &total);
+        if (num_tasks == 0 && !warned) {
+            ESP_LOGW(TAG, "More than %d tasks, raise PROFILER_MAX_TASKS", PROFILER_MAX_TASKS);
+            warned = true;
+        }
+
+        // The first sample only sets the baseline.
+        if (last_us != 0) {
+            int next = atomic_load_explicit(&report_cur, memory_order_relaxed) == 0 ? 1 : 0;
+            report[next].len = encode_window(status, num_tasks, (uint32_t)(now_us - last_us), report[next].data, sizeof(report[next].data));
+            atomic_store_explicit(&report_cur, next, memory_order_release);
+        }
+
+        for (int i = 0; i < num_tasks; i++) {
+            prev[i].handle = status[i].xHandle;
+            prev[i].run_time = status[i].ulRunTimeCounter;
+        }
+        num_prev = num_tasks;
+        last_us = now_us;
+        vTaskDelay(pdMS_TO_TICKS(PROFILER_PERIOD_MS));
+    }// end while
+}
+
+void profiler_start(void) {
+    if (xTaskCreatePinnedToCore(profiler_task, "profiler", PROFILER_TASK_STACK, NULL, PROFILER_TASK_PRIORITY, NULL, PROFILER_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the profiler task");
+    }
+}
+
+size_t profiler_encode(uint8_t *buf, size_t cap) {
+    int cur = atomic_load_explicit(&report_cur, memory_order_acquire);
+    if (cur < 0 || report[cur].len > cap) {
+        return 0;
+    }
+    memcpy(buf, report[cur].data, report[cur].len);
+    return report[cur].len;
+}
+
+#else
+
+void profiler_start(void) {
+}
+
+size_t profiler_encode(uint8_t *buf, size_t cap) {
+    return 0;
+}
+
+#endif
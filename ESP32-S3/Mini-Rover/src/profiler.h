@@ -0,0 +1,87 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+** Run-time profiler: CPU load and stack use per task, idle time per core,
+** and how late the periodic loops wake up.
+**
+** A low-priority task samples FreeRTOS every PROFILER_PERIOD_MS with
+** uxTaskGetSystemState(): the run-time counter of every task (esp_timer
+** microseconds, CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS) gives its CPU time
+** over the window, the idle tasks' give each core's idle time, and the stack
+** high-water mark is the least free stack the task has ever had. The control,
+** speed and telemetry loops call PROFILE_WAKE() once per wake-up; lateness
+** is measured against the loop's own deadline grid (first wake-up plus whole
+** periods), so it does not drift with the previous wake-up.
+**
+** profiler_encode() packs the last complete window into protocol frames,
+** answered to ROVER_MSG_PROF_QUERY (python/prof_query.py):
+**
+**   ROVER_MSG_PROF_SUMMARY  u32 t_ms, window_us, free_heap, min_free_heap,
+**                           u16 idle[2] (0.01 % of the core, 0xFFFF unknown),
+**                           u16 tick_hz, u8 num_tasks, u8 num_loops
+**   ROVER_MSG_PROF_TASK     char name[16] (NUL padded), u16 cpu (0.01 % of one
+**                           core), u16 stack_free (bytes, lowest ever),
+**                           u8 priority, u8 core (0xFF unpinned), u16 reserved
+**   ROVER_MSG_PROF_LOOP     u8 loop (profiler_loop_t), u8 reserved[3],
+**                           u32 period_us, wakes, missed, late_mean_us,
+**                           late_max_us
+**
+** one SUMMARY, then one TASK frame per task and one LOOP frame per loop.
+** "missed" counts deadlines that passed without a wake-up of their own.
+**
+** Build with -DPROFILER_ENABLE=0 to compile the task and every PROFILE_WAKE()
+** out; queries then go unanswered. The kernel's run-time accounting (one
+** timer read per context switch) stays on with the sdkconfig options.
+*/
+
+#ifndef PROFILER_ENABLE
+#define PROFILER_ENABLE 1
+#endif
+
+#ifndef PROFILER_PERIOD_MS
+#define PROFILER_PERIOD_MS 1000
+#endif
+
+// uxTaskGetSystemState() reports nothing at all when there are more tasks than this.
+#define PROFILER_MAX_TASKS 28
+#define PROFILER_NAME_LEN 16
+
+// Just above idle: sampling can wait for anything else that wants the CPU.
+#define PROFILER_TASK_STACK 3072
+#define PROFILER_TASK_PRIORITY 1
+#define PROFILER_TASK_CORE 0
+
+#define PROFILER_SUMMARY_LEN 24
+#define PROFILER_TASK_LEN 24
+#define PROFILER_LOOP_LEN 24
+#define PROFILER_REPORT_MAX 960     // a full reply: every frame of PROFILER_MAX_TASKS tasks
+#define PROFILER_IDLE_UNKNOWN 0xFFFF
+#define PROFILER_CORE_ANY 0xFF
+
+typedef enum {
+    PROFILER_LOOP_CONTROL = 0,
+    PROFILER_LOOP_SPEED,
+    PROFILER_LOOP_TELEMETRY,
+    PROFILER_NUM_LOOPS
+} profiler_loop_t;
+
+// Start sampling. Tasks created later are picked up at the next sample.
+void profiler_start(void);
+
+// Note a wake-up of a loop that runs every period_us. One caller per loop.
+void profiler_wake(profiler_loop_t loop, int64_t now_us, int32_t period_us);
+
+// Encode the last complete window. Returns the bytes written, 0 before the first window.
+size_t profiler_encode(uint8_t *buf, size_t cap);
+
+#if PROFILER_ENABLE
+#define PROFILE_WAKE(loop, now_us, period_us) profiler_wake((loop), (now_us), (period_us))
+#else
+#define PROFILE_WAKE(loop, now_us, period_us) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdbool.h>
+#include "seqfilter.h"
+#include "stats.h"
+
+// One stream per sequenced command type: SERVO, MOTOR, STEER, DRIVE.
+#define NUM_STREAMS 4
+
+typedef struct {
+    bool primed;
+    uint16_t highest;       // newest sequence number applied
+    uint32_t transit;       // rx clock - sender clock of that frame, wrapping
+    uint32_t jitter16;      // jitter estimate in 1/16 us
+} seq_stream_t;
+
+typedef struct {
+    bool used;
+    uint32_t ip;
+    uint16_t port;
+    int64_t last_us;        // last frame from this client, for eviction
+    seq_stream_t stream[NUM_STREAMS];
+} seq_client_t;
+
+static seq_client_t clients[SEQ_FILTER_MAX_CLIENTS];
+static uint32_t last_jitter_us = 0;
+
+static int stream_index(rover_msg_type_t type) {
+    switch (type) {
+        case ROVER_MSG_SERVO: return 0;
+        case ROVER_MSG_MOTOR: return 1;
+        case ROVER_MSG_STEER: return 2;
+        case ROVER_MSG_DRIVE: return 3;
+        default:              return -1;
+    }
+}
+
+// Find the client's slot, or take over the one idle longest.
+static seq_client_t *lookup(uint32_t ip, uint16_t port, int64_t rx_us) {
+    seq_client_t *oldest = &clients[0];
+    for (int i = 0; i < SEQ_FILTER_MAX_CLIENTS; i++) {
+        seq_client_t *c = &clients[i];
+        if (c->used && c->ip == ip && c->port == port) {
+            return c;
+        }
+        if (!c->used || (oldest->used && c->last_us < oldest->last_us)) {
+            oldest = c;
+        }
+    }
+    *oldest = (seq_client_t){.used = true, .ip = ip, .port = port, .last_us = rx_us};
+    return oldest;
+}
+
+seq_verdict_t seq_filter_check(uint32_t ip, uint16_t port, const rover_cmd_t *cmd, int64_t rx_us) {
+    int idx = stream_index(cmd->type);
+    if (!cmd->has_seq || idx < 0) {
+        return SEQ_ACCEPT;
+    }
+
+    seq_client_t *client = lookup(ip, port, rx_us);
+    client->last_us = rx_us;
+    seq_stream_t *s = &client->stream[idx];
+    uint32_t transit = (uint32_t)rx_us - cmd->t_us;
+
+    if (s->primed) {
+        // Serial number arithmetic: the sign of the 16-bit difference says which is newer.
+        int16_t ahead = (int16_t)(cmd->seq - s->highest);
+        if (ahead == 0) {
+            stats_count(STATS_SEQ_DUPLICATE, 1);
+            return SEQ_DUPLICATE;
+        }
+        if (ahead < 0 && ahead >= -SEQ_FILTER_WINDOW) {
+            stats_count(STATS_SEQ_STALE, 1);
+            return SEQ_STALE;
+        }
+        if (ahead < 0) {
+            stats_count(STATS_SEQ_RESYNC, 1);
+        } else {
+            // J += (|D| - J) / 16, where D is the change in transit time between consecutive frames.
+            int32_t d = (int32_t)(transit - s->transit);
+            uint32_t mag = d < 0 ? -(uint32_t)d : (uint32_t)d;
+            s->jitter16 += mag - ((s->jitter16 + 8) >> 4);
+            last_jitter_us = s->jitter16 >> 4;
+            stats_set(STATS_JITTER_US, last_jitter_us);
+        }
+    }
+    s->primed = true;
+    s->highest = cmd->seq;
+    s->transit = transit;
+    return SEQ_ACCEPT;
+}
+
+uint32_t seq_filter_jitter_us(void) {
+    return last_jitter_us;
+}
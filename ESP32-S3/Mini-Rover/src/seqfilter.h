@@ -0,0 +1,43 @@
+#ifndef SEQFILTER_H
+#define SEQFILTER_H
+
+#include <stdint.h>
+#include "protocol.h"
+
+/*
+** Reorder and duplicate filter for sequenced commands.
+**
+** UDP may deliver a datagram late, twice or out of order, and applying an old
+** command would overwrite a newer one. Every (client address, port, command
+** type) stream keeps the highest sequence number applied so far; a frame
+** equal to it or up to SEQ_FILTER_WINDOW behind it is dropped before it
+** reaches the setpoint, so no bus time is spent on it. A frame further behind
+** means the sender restarted, and the stream resynchronises to it.
+**
+** Each stream also keeps an RFC 3550 interarrival jitter estimate from the
+** sender timestamps. Only the receive path calls into this module: the UDP
+** receive task, or in raw lwIP mode the tcpip thread (see udp_rx.h), never
+** both.
+*/
+
+#ifndef SEQ_FILTER_MAX_CLIENTS
+#define SEQ_FILTER_MAX_CLIENTS 4
+#endif
+
+#ifndef SEQ_FILTER_WINDOW
+#define SEQ_FILTER_WINDOW 256
+#endif
+
+typedef enum {
+    SEQ_ACCEPT = 0,
+    SEQ_STALE,          // behind a frame already applied
+    SEQ_DUPLICATE,      // same sequence number as the newest applied
+} seq_verdict_t;
+
+// Check a decoded command from ip:port (network byte order as received) at rx_us. Unsequenced commands always pass.
+seq_verdict_t seq_filter_check(uint32_t ip, uint16_t port, const rover_cmd_t *cmd, int64_t rx_us);
+
+// Jitter estimate, in microseconds, of the stream that last accepted a frame.
+uint32_t seq_filter_jitter_us(void);
+
+#endif
@@ -0,0 +1,75 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "setpoint.h"
+
+/* Sequence lock. The writer makes the sequence odd while it copies the new
+** value in and even again once it is done; the reader retries whenever it saw
+** an odd sequence or the sequence moved under it. With a single writer no
+** lock or critical section is needed on either side.
+*/
+static atomic_uint_fast32_t seq = 0;
+static setpoint_t slot = {
+    .angle_dd = {[0 ... ROVER_NUM_SERVOS - 1] = 90 * ROVER_ANGLE_SCALE},
+};
+
+// Writer-private working copy, only touched by the receive task.
+static setpoint_t pending = {
+    .angle_dd = {[0 ... ROVER_NUM_SERVOS - 1] = 90 * ROVER_ANGLE_SCALE},
+};
+
+void setpoint_publish_cmd(const rover_cmd_t *cmd, int64_t rx_us, int64_t parsed_us) {
+    switch (cmd->type) {
+        case ROVER_MSG_SERVO:
+            memcpy(pending.angle_dd, cmd->servo.angle_dd, sizeof(pending.angle_dd));
+            pending.steer_mode = false;
+            pending.servo_gen++;
+            pending.servo_rx_us = rx_us;
+            pending.servo_parsed_us = parsed_us;
+            break;
+        case ROVER_MSG_STEER:
+            pending.steer = cmd->steer.steer;
+            pending.steer_mode = true;
+            pending.servo_gen++;
+            pending.servo_rx_us = rx_us;
+            pending.servo_parsed_us = parsed_us;
+            break;
+        case ROVER_MSG_MOTOR:
+            memcpy(pending.speed, cmd->motor.speed, sizeof(pending.speed));
+            pending.motor_gen++;
+            pending.motor_rx_us = rx_us;
+            pending.motor_parsed_us = parsed_us;
+            break;
+        case ROVER_MSG_DRIVE:
+            // Both halves in one publish, so the control task never sees one without the other.
+            pending.steer = cmd->drive.steer;
+            pending.steer_mode = true;
+            pending.servo_gen++;
+            pending.servo_rx_us = rx_us;
+            pending.servo_parsed_us = parsed_us;
+            for (int i = 0; i < ROVER_NUM_MOTORS; i++) {
+                pending.speed[i] = cmd->drive.speed;
+            }
+            pending.motor_gen++;
+            pending.motor_rx_us = rx_us;
+            pending.motor_parsed_us = parsed_us;
+            break;
+        default:
+            return;
+    }
+
+    uint_fast32_t s = atomic_load_explicit(&seq, memory_order_relaxed);
+    atomic_store_explicit(&seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&slot, &pending, sizeof(slot));
+    atomic_store_explicit(&seq, s + 2, memory_order_release);
+}
+
+void setpoint_read(setpoint_t *out) {
+    uint_fast32_t s1, s2;
+    do {
+        s1 = atomic_load_explicit(&seq, memory_order_acquire);
+        memcpy(out, &slot, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&seq, memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+}
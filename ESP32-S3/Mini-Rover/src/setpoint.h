@@ -0,0 +1,34 @@
+#ifndef SETPOINT_H
+#define SETPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "protocol.h"
+
+/*
+** Latest-value mailbox between the UDP receive task (single writer) and the
+** control task (single reader). The writer never blocks and the reader always
+** sees the newest complete setpoint; intermediate values are simply
+** overwritten, so a burst of packets never turns into a backlog.
+*/
+
+typedef struct {
+    uint16_t angle_dd[ROVER_NUM_SERVOS];   // servo angles, 0.1 degree units
+    int16_t steer;                         // Ackermann steering scalar, Q15
+    bool steer_mode;                       // true: derive angles from steer, false: use angle_dd
+    int16_t speed[ROVER_NUM_MOTORS];       // signed wheel speed targets, -255..255 (src/speed.h)
+    uint32_t servo_gen;                    // bumped on every servo update
+    uint32_t motor_gen;                    // bumped on every motor update
+
+    // esp_timer timestamps of the latest update: datagram received / decoded.
+    int64_t servo_rx_us, servo_parsed_us;
+    int64_t motor_rx_us, motor_parsed_us;
+} setpoint_t;
+
+// Writer side: merge a decoded command into the setpoint and publish it.
+void setpoint_publish_cmd(const rover_cmd_t *cmd, int64_t rx_us, int64_t parsed_us);
+
+// Reader side: copy out the latest published setpoint.
+void setpoint_read(setpoint_t *out);
+
+#endif
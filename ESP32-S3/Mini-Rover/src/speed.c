@@ -0,0 +1,239 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "speed.h"
+#include "encoder.h"
+#include "stats.h"
+#include "profiler.h"
+
+static const char *TAG = "SPEED";
+
+_Static_assert(ROVER_NUM_MOTORS == L298N_NUM_MOTORS, "wheel count differs from the motor board table");
+_Static_assert(ROVER_NUM_MOTORS == ENCODER_NUM_WHEELS, "wheel count differs from the encoder table");
+
+#define DUTY_MAX_Q12 ((int64_t)L298N_MAX_DUTY << 12)
+
+static l298n_t *boards;
+static const speed_source_t *source;
+static speed_loop_t loop;
+
+// Written by the control task, read by the speed task; per-wheel stores are enough.
+static atomic_int target_cps[ROVER_NUM_MOTORS];
+// Command stamp handed over by speed_note_command(); the fields belong to whoever ready says.
+static atomic_int stamp_ready;
+static int64_t stamp_rx_us, stamp_issue_us;
+
+// Written by the speed task for telemetry.
+static atomic_int published_cps[ROVER_NUM_MOTORS] = {[0 ... ROVER_NUM_MOTORS - 1] = SPEED_UNMEASURED};
+
+static esp_err_t encoder_source_init(void *ctx, uint8_t *mask) {
+    return encoder_init(mask);
+}
+
+static void encoder_source_read(void *ctx, int32_t counts[ROVER_NUM_MOTORS]) {
+    encoder_read(counts);
+}
+
+const speed_source_t speed_source_encoder = {
+    .name = "pcnt",
+    .init = encoder_source_init,
+    .read = encoder_source_read,
+};
+
+static inline int16_t q12_to_duty(int64_t v) {
+    if (v > DUTY_MAX_Q12) {
+        v = DUTY_MAX_Q12;
+    } else if (v < -DUTY_MAX_Q12) {
+        v = -DUTY_MAX_Q12;
+    }
+    return (int16_t)(v >= 0 ? (v + 2048) >> 12 : -((-v + 2048) >> 12));
+}
+
+void speed_pid_init(speed_pid_t *pid, int32_t kp, int32_t ki, int32_t kd, int32_t kff) {
+    *pid = (speed_pid_t){.kp = kp, .ki = ki, .kd = kd, .kff = kff};
+}
+
+int16_t speed_pid_step(speed_pid_t *pid, int32_t target_cps, int32_t meas_cps, int32_t dt_us) {
+    int32_t last = pid->last_meas;
+    pid->last_meas = meas_cps;
+    if (target_cps == 0) {
+        pid->integ = 0;
+        return 0;
+    }
+
+    int32_t err = target_cps - meas_cps;
+    int64_t out = (int64_t)pid->kff * target_cps + (int64_t)pid->kp * err + pid->integ;
+    if (dt_us > 0) {
+        out -= (int64_t)pid->kd * (meas_cps - last) * 1000000 / dt_us;
+        int64_t step = (int64_t)pid->ki * err * dt_us / 1000000;
+        // Conditional integration: hold the integral while the output is pinned and the error pushes it further.
+        if (!((out >= DUTY_MAX_Q12 && err > 0) || (out <= -DUTY_MAX_Q12 && err < 0))) {
+            int64_t integ = pid->integ + step;
+            integ = integ > DUTY_MAX_Q12 ? DUTY_MAX_Q12 : integ < -DUTY_MAX_Q12 ? -DUTY_MAX_Q12 : integ;
+            out += integ - pid->integ;
+            pid->integ = (int32_t)integ;
+        }
+    }
+    return q12_to_duty(out);
+}
+
+void speed_loop_init(speed_loop_t *l, uint8_t measured) {
+    memset(l, 0, sizeof(*l));
+    l->measured = measured;
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        speed_pid_init(&l->pid[w], SPEED_KP_Q12, SPEED_KI_Q12, SPEED_KD_Q12, SPEED_KFF_Q12);
+        l->meas_cps[w] = SPEED_UNMEASURED;
+    }
+}
+
+void speed_loop_step(speed_loop_t *l, const int32_t target[ROVER_NUM_MOTORS], const int32_t counts[ROVER_NUM_MOTORS], int64_t now_us, int16_t duty[ROVER_NUM_MOTORS]) {
+    const uint32_t slots = SPEED_WINDOW + 1;
+    uint32_t slot = l->n % slots;
+    int32_t dt_us = l->n ? (int32_t)(now_us - l->t_us[(l->n - 1) % slots]) : 0;
+    // The oldest sample in the ring, or the first one until the window has filled.
+    uint32_t old = l->n >= SPEED_WINDOW ? (l->n - SPEED_WINDOW) % slots : 0;
+    memcpy(l->counts[slot], counts, sizeof(l->counts[slot]));
+    l->t_us[slot] = now_us;
+    int64_t span_us = now_us - l->t_us[old];
+    uint32_t prev = l->n ? (l->n - 1) % slots : slot;
+    l->n++;
+
+    // Measured wheels first; their correction over feed-forward is shared with the others on their side.
+    int32_t corr_sum[2] = {0, 0}, corr_num[2] = {0, 0};
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        if (!(l->measured & (1u << w))) {
+            continue;
+        }
+        int16_t last = l->last_duty[w];
+        if ((last >= SPEED_STALL_DUTY || last <= -SPEED_STALL_DUTY) && counts[w] == l->counts[prev][w]) {
+            l->still[w]++;
+        } else {
+            l->still[w] = 0;
+        }
+        if (l->still[w] >= SPEED_STALL_PERIODS) {
+            // Driven but not turning as far as the counter knows: stop trusting it.
+            l->measured &= ~(1u << w);
+            l->stalled |= 1u << w;
+            l->pid[w].integ = 0;
+            l->meas_cps[w] = SPEED_UNMEASURED;
+            continue;
+        }
+        int32_t meas = 0;
+        if (span_us > 0) {
+            int32_t delta = (int32_t)((uint32_t)counts[w] - (uint32_t)l->counts[old][w]);
+            int64_t cps = (int64_t)delta * 1000000 / span_us;
+            meas = cps > INT16_MAX ? INT16_MAX : cps < -INT16_MAX ? -INT16_MAX : (int32_t)cps;
+        }
+        l->meas_cps[w] = (int16_t)meas;
+        duty[w] = speed_pid_step(&l->pid[w], target[w], meas, dt_us);
+        if (target[w] != 0) {
+            corr_sum[w % 2] += duty[w] - q12_to_duty((int64_t)l->pid[w].kff * target[w]);
+            corr_num[w % 2]++;
+        }
+    }
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        if (l->measured & (1u << w)) {
+            continue;
+        }
+        int32_t corr = corr_num[w % 2] ? corr_sum[w % 2] / corr_num[w % 2] : 0;
+        corr = corr > SPEED_SHARED_CORR_MAX ? SPEED_SHARED_CORR_MAX : corr < -SPEED_SHARED_CORR_MAX ? -SPEED_SHARED_CORR_MAX : corr;
+        duty[w] = target[w] == 0 ? 0 : q12_to_duty((int64_t)l->pid[w].kff * target[w] + ((int64_t)corr << 12));
+    }
+    memcpy(l->last_duty, duty, sizeof(l->last_duty));
+}
+
+// esp_timer callback: wake the speed task for the next period.
+static void speed_tick(void *arg) {
+    xTaskNotifyGive((TaskHandle_t)arg);
+}
+
+static void speed_task(void *arg) {
+    int32_t target[ROVER_NUM_MOTORS], counts[ROVER_NUM_MOTORS];
+    int16_t duty[ROVER_NUM_MOTORS];
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = speed_tick,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "speed",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_handle_t timer;
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(timer, 1000000 / SPEED_RATE_HZ));
+
+    ESP_LOGI(TAG, "Speed loop running at %d Hz on core %d, source %s, wheel mask 0x%02x", SPEED_RATE_HZ, SPEED_TASK_CORE, source->name, loop.measured);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now_us = esp_timer_get_time();
+        PROFILE_WAKE(PROFILER_LOOP_SPEED, now_us, 1000000 / SPEED_RATE_HZ);
+
+        // Taken before the targets, so the targets of a stamped command are in this period.
+        int stamped = atomic_load_explicit(&stamp_ready, memory_order_acquire);
+        source->read(source->ctx, counts);
+        for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+            target[w] = atomic_load_explicit(&target_cps[w], memory_order_relaxed);
+        }
+        uint8_t stalled = loop.stalled;
+        speed_loop_step(&loop, target, counts, now_us, duty);
+        if (loop.stalled != stalled) {
+            ESP_LOGW(TAG, "No counts from driven wheel(s) 0x%02x, open loop from now on", loop.stalled & ~stalled);
+        }
+
+        if (l298n_set_all(boards, L298N_NUM_BOARDS, duty) != ESP_OK) {
+            stats_count(STATS_LEDC_ERRORS, 1);
+        }
+        if (stamped) {
+            int64_t done_us = esp_timer_get_time();
+            stats_record(STATS_CMD_MOTOR, STATS_STAGE_ACTUATE, done_us - stamp_issue_us);
+            stats_record(STATS_CMD_MOTOR, STATS_STAGE_TOTAL, done_us - stamp_rx_us);
+            atomic_store_explicit(&stamp_ready, 0, memory_order_release);
+        }
+        if (source->applied) {
+            source->applied(source->ctx, duty);
+        }
+        for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+            atomic_store_explicit(&published_cps[w], loop.meas_cps[w], memory_order_relaxed);
+        }
+    }// end while
+}
+
+void speed_start(l298n_t *motor_boards, const speed_source_t *speed_source) {
+    boards = motor_boards;
+    source = speed_source;
+
+    uint8_t mask = 0;
+    esp_err_t ret = source->init(source->ctx, &mask);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Speed source %s unavailable (%s), feed-forward only", source->name, esp_err_to_name(ret));
+        mask = 0;
+    }
+    speed_loop_init(&loop, mask);
+    xTaskCreatePinnedToCore(speed_task, "speed_task", SPEED_TASK_STACK, NULL, SPEED_TASK_PRIORITY, NULL, SPEED_TASK_CORE);
+}
+
+void speed_set_targets(const int16_t speed[ROVER_NUM_MOTORS]) {
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        atomic_store_explicit(&target_cps[w], speed_target_cps(speed[w]), memory_order_relaxed);
+    }
+}
+
+void speed_note_command(int64_t rx_us, int64_t issue_us) {
+    if (atomic_load_explicit(&stamp_ready, memory_order_acquire)) {
+        return;
+    }
+    stamp_rx_us = rx_us;
+    stamp_issue_us = issue_us;
+    atomic_store_explicit(&stamp_ready, 1, memory_order_release);
+}
+
+void speed_get(int16_t target[ROVER_NUM_MOTORS], int16_t meas[ROVER_NUM_MOTORS]) {
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        target[w] = (int16_t)atomic_load_explicit(&target_cps[w], memory_order_relaxed);
+        meas[w] = (int16_t)atomic_load_explicit(&published_cps[w], memory_order_relaxed);
+    }
+}
@@ -0,0 +1,173 @@
+#ifndef SPEED_H
+#define SPEED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "l298n.h"
+#include "protocol.h"
+
+/*
+** Closed-loop wheel speed control.
+**
+** With SPEED_CONTROL=1 the motor speeds the control task shapes (-255..255,
+** from M and D commands) are speed targets, not PWM duty: 255 means
+** SPEED_MAX_CPS encoder counts per second. A dedicated task on the control
+** core wakes SPEED_RATE_HZ times a second, reads the wheel counters from a
+** speed source, runs one fixed-point PID per wheel and writes the duties to
+** the L298N boards; it is then the only writer of the motor outputs. Nothing
+** in the loop allocates.
+**
+** Speed is the count difference over the last SPEED_WINDOW periods. Wheels
+** the source cannot measure (the middle wheels, with only four PCNT units
+** for encoders) get the feed-forward duty for their own target plus the
+** mean PID correction of the measured wheels on their side, capped at
+** SPEED_SHARED_CORR_MAX so one bad wheel cannot push them into saturation.
+**
+** A measured wheel that is driven with at least SPEED_STALL_DUTY but shows
+** no counts for SPEED_STALL_PERIODS periods in a row (a dead encoder, a
+** loose connector, or a jammed wheel) is dropped from the loop: its
+** integral is cleared and it runs like an unmeasured wheel until reboot.
+**
+** The speed source is pluggable: speed_source_encoder reads the PCNT
+** encoders, the host build uses the simulated motors of plant.h.
+**
+** Off by default until the encoders are wired (lib/Encoder/encoder.c):
+** SPEED_CONTROL=0 is open loop, motor speeds straight to duty.
+*/
+
+#ifndef SPEED_CONTROL
+#define SPEED_CONTROL 0
+#endif
+
+#if SPEED_CONTROL && L298N_RAMP_MS > 0
+#error "SPEED_CONTROL needs direct duty writes; build with L298N_RAMP_MS=0"
+#endif
+
+#ifndef SPEED_RATE_HZ
+#define SPEED_RATE_HZ 250
+#endif
+
+// Measurement window in loop periods: longer is smoother, shorter reacts sooner.
+#ifndef SPEED_WINDOW
+#define SPEED_WINDOW 8
+#endif
+
+// Wheel speed a target of 255 asks for, and the (unloaded) speed at full
+// duty, which sets the feed-forward. Encoder counts per second, x4 decoding.
+#ifndef SPEED_MAX_CPS
+#define SPEED_MAX_CPS 2400
+#endif
+#ifndef SPEED_NO_LOAD_CPS
+#define SPEED_NO_LOAD_CPS 3000
+#endif
+
+/* PID gains in Q12, duty units (-255..255) per count/s; the integral gain
+** is per count/s per second and the derivative gain per count/s^2. Tuned
+** against the simulated plant with host/speed_tune.c.
+*/
+#ifndef SPEED_KP_Q12
+#define SPEED_KP_Q12 600
+#endif
+#ifndef SPEED_KI_Q12
+#define SPEED_KI_Q12 4096
+#endif
+#ifndef SPEED_KD_Q12
+#define SPEED_KD_Q12 2
+#endif
+#define SPEED_KFF_Q12 ((L298N_MAX_DUTY * 4096 + SPEED_NO_LOAD_CPS / 2) / SPEED_NO_LOAD_CPS)
+
+// Largest correction, in duty units, an unmeasured wheel takes from the measured ones.
+#ifndef SPEED_SHARED_CORR_MAX
+#define SPEED_SHARED_CORR_MAX 64
+#endif
+
+// Stall detection: SPEED_STALL_PERIODS periods without a count at |duty| >= SPEED_STALL_DUTY.
+#ifndef SPEED_STALL_PERIODS
+#define SPEED_STALL_PERIODS (SPEED_RATE_HZ / 4)
+#endif
+#ifndef SPEED_STALL_DUTY
+#define SPEED_STALL_DUTY 64
+#endif
+
+// Shares core 1 with the control task, above it so the sampling period holds.
+#define SPEED_TASK_CORE 1
+#define SPEED_TASK_STACK 3072
+#define SPEED_TASK_PRIORITY 7
+
+// Published speed of a wheel the source does not measure.
+#define SPEED_UNMEASURED INT16_MIN
+
+/* Where wheel counts come from. init() reports the wheels it can measure,
+** read() returns their accumulated counts (wrapping), and applied(), if
+** set, is told the duties just written.
+*/
+typedef struct {
+    const char *name;
+    esp_err_t (*init)(void *ctx, uint8_t *mask);
+    void (*read)(void *ctx, int32_t counts[ROVER_NUM_MOTORS]);
+    void (*applied)(void *ctx, const int16_t duty[ROVER_NUM_MOTORS]);
+    void *ctx;
+} speed_source_t;
+
+extern const speed_source_t speed_source_encoder;
+
+typedef struct {
+    int32_t kp, ki, kd, kff;        // Q12
+    int32_t integ;                  // Q12 duty
+    int32_t last_meas;
+} speed_pid_t;
+
+void speed_pid_init(speed_pid_t *pid, int32_t kp, int32_t ki, int32_t kd, int32_t kff);
+
+/* One PID step: duty for target_cps given the measured speed, dt_us after
+** the previous step. Derivative on measurement, so a target step does not
+** kick; the integral stops growing while the output is saturated in the
+** direction of the error. A zero target gives zero duty and clears the
+** integral, so a stopped wheel does not creep.
+*/
+int16_t speed_pid_step(speed_pid_t *pid, int32_t target_cps, int32_t meas_cps, int32_t dt_us);
+
+/* The loop without the hardware, kept apart so host tools (host/speed_tune.c)
+** run exactly the rover's arithmetic.
+*/
+typedef struct {
+    speed_pid_t pid[ROVER_NUM_MOTORS];
+    uint8_t measured;               // wheels with counts
+    uint8_t stalled;                // wheels dropped by stall detection
+    uint32_t n;                     // steps taken
+    int32_t counts[SPEED_WINDOW + 1][ROVER_NUM_MOTORS];
+    int64_t t_us[SPEED_WINDOW + 1];
+    int16_t meas_cps[ROVER_NUM_MOTORS];
+    int16_t last_duty[ROVER_NUM_MOTORS];
+    uint16_t still[ROVER_NUM_MOTORS];  // driven periods in a row without a count
+} speed_loop_t;
+
+void speed_loop_init(speed_loop_t *loop, uint8_t measured);
+
+// One period at now_us: measure from counts and compute the duty for every wheel.
+void speed_loop_step(speed_loop_t *loop, const int32_t target_cps[ROVER_NUM_MOTORS], const int32_t counts[ROVER_NUM_MOTORS], int64_t now_us, int16_t duty[ROVER_NUM_MOTORS]);
+
+// Target for a shaped motor speed, -255..255.
+static inline int32_t speed_target_cps(int16_t speed) {
+    return (int32_t)speed * SPEED_MAX_CPS / L298N_MAX_DUTY;
+}
+
+/* Start the speed task on motor_boards (set up by init_motor_controllers()).
+** If the source fails to come up the loop still runs, feed-forward only.
+*/
+void speed_start(l298n_t *motor_boards, const speed_source_t *source);
+
+// New motor speeds (-255..255) from the control task; the speed task picks them up next period.
+void speed_set_targets(const int16_t speed[ROVER_NUM_MOTORS]);
+
+/* Receive and issue time of the motor command whose targets were just set.
+** The speed task records its actuate and total latency once it has written
+** the duties. One command in flight; a second before that is dropped.
+*/
+void speed_note_command(int64_t rx_us, int64_t issue_us);
+
+// Latest targets and measured speeds in counts/s (SPEED_UNMEASURED where there is no count).
+void speed_get(int16_t target_cps[ROVER_NUM_MOTORS], int16_t meas_cps[ROVER_NUM_MOTORS]);
+
+#endif
@@ -0,0 +1,71 @@
+#include "esp_timer.h"
+#include "stats.h"
+#include "protocol.h"
+
+/* Each histogram has a single writer and 32-bit stores are atomic on the
+** ESP32, so no locking is needed. The control task records the parse and
+** queue stages; actuate and total come from where the write completes: the
+** I2C bus engine for servos, the control task for motors, or the speed task
+** with SPEED_CONTROL. A snapshot may be a few counts out of step between
+** histograms, which is fine for monitoring.
+*/
+static volatile uint32_t hist[STATS_NUM_CMDS][STATS_NUM_STAGES][STATS_NUM_BUCKETS];
+static volatile uint32_t counters[STATS_NUM_COUNTERS];
+
+static inline int bucket_for(int64_t us) {
+    if (us <= 0) {
+        return 0;
+    }
+    if (us >= (1LL << (STATS_NUM_BUCKETS - 2))) {
+        return STATS_NUM_BUCKETS - 1;
+    }
+    return 32 - __builtin_clz((uint32_t)us);
+}
+
+void stats_record(stats_cmd_t cmd, stats_stage_t stage, int64_t us) {
+    hist[cmd][stage][bucket_for(us)]++;
+}
+
+void stats_count(stats_counter_t counter, uint32_t n) {
+    counters[counter] += n;
+}
+
+void stats_set(stats_counter_t counter, uint32_t value) {
+    counters[counter] = value;
+}
+
+uint32_t stats_get(stats_counter_t counter) {
+    return counters[counter];
+}
+
+size_t stats_encode_snapshot(uint8_t *buf, size_t cap) {
+    uint8_t payload[4 + 4 * STATS_NUM_BUCKETS];
+    size_t used, n;
+
+    put_u32le(payload, (uint32_t)(esp_timer_get_time() / 1000));
+    for (int i = 0; i < STATS_NUM_COUNTERS; i++) {
+        put_u32le(payload + 4 + 4 * i, counters[i]);
+    }
+    used = rover_encode_frame(ROVER_MSG_STATS_COUNTERS, payload, 4 + 4 * STATS_NUM_COUNTERS, buf, cap);
+    if (used == 0) {
+        return 0;
+    }
+
+    for (int c = 0; c < STATS_NUM_CMDS; c++) {
+        for (int s = 0; s < STATS_NUM_STAGES; s++) {
+            payload[0] = c;
+            payload[1] = s;
+            payload[2] = STATS_NUM_BUCKETS;
+            payload[3] = 0;
+            for (int b = 0; b < STATS_NUM_BUCKETS; b++) {
+                put_u32le(payload + 4 + 4 * b, hist[c][s][b]);
+            }
+            n = rover_encode_frame(ROVER_MSG_STATS_HIST, payload, sizeof(payload), buf + used, cap - used);
+            if (n == 0) {
+                return used;
+            }
+            used += n;
+        }
+    }
+    return used;
+}
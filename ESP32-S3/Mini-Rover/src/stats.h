@@ -0,0 +1,64 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+** Command-to-actuation latency statistics.
+**
+** Every accepted command is timestamped (esp_timer, microseconds) when it is
+** received, when parsing finishes, when the control task starts the I2C/LEDC
+** writes for it, and when those writes complete. The differences feed fixed
+** log2 histograms per stage and per command type: bucket 0 counts 0 us and
+** bucket i counts [2^(i-1), 2^i) us, with the last bucket open-ended.
+**
+** stats_encode_snapshot() packs everything into one datagram of protocol
+** frames, answered to ROVER_MSG_STATS_QUERY:
+**
+**   ROVER_MSG_STATS_COUNTERS  u32 uptime_ms, rx_packets, rx_rejected,
+**                             superseded, i2c_errors, ledc_errors,
+**                             seq_stale, seq_duplicate, seq_resync,
+**                             jitter_us
+**   ROVER_MSG_STATS_HIST      u8 cmd, u8 stage, u8 num_buckets, u8 reserved,
+**                             u32 bucket[num_buckets]   (one frame per cmd/stage)
+*/
+
+#define STATS_NUM_BUCKETS 20
+
+typedef enum {
+    STATS_CMD_SERVO = 0,
+    STATS_CMD_MOTOR,
+    STATS_NUM_CMDS
+} stats_cmd_t;
+
+typedef enum {
+    STATS_STAGE_PARSE = 0,  // receive -> parse done
+    STATS_STAGE_QUEUE,      // parse done -> control task issues the writes
+    STATS_STAGE_ACTUATE,    // issue -> writes complete
+    STATS_STAGE_TOTAL,      // receive -> writes complete
+    STATS_NUM_STAGES
+} stats_stage_t;
+
+typedef enum {
+    STATS_RX_PACKETS = 0,
+    STATS_RX_REJECTED,
+    STATS_SUPERSEDED,       // setpoints overwritten before the control task applied them
+    STATS_I2C_ERRORS,
+    STATS_LEDC_ERRORS,
+    STATS_SEQ_STALE,        // sequenced commands dropped as older than one already applied
+    STATS_SEQ_DUPLICATE,    // sequenced commands dropped as repeats
+    STATS_SEQ_RESYNC,       // streams that restarted far behind (sender restart)
+    STATS_JITTER_US,        // gauge: latest interarrival jitter estimate, see seqfilter.h
+    STATS_NUM_COUNTERS
+} stats_counter_t;
+
+void stats_record(stats_cmd_t cmd, stats_stage_t stage, int64_t us);
+void stats_count(stats_counter_t counter, uint32_t n);
+void stats_set(stats_counter_t counter, uint32_t value);
+uint32_t stats_get(stats_counter_t counter);
+
+// Encode a snapshot of all counters and histograms. Returns the bytes written.
+size_t stats_encode_snapshot(uint8_t *buf, size_t cap);
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "telemetry.h"
+#include "protocol.h"
+#include "control.h"
+#include "pca9685.h"
+#include "stats.h"
+#include "speed.h"
+#include "udp_rx.h"
+#include "profiler.h"
+
+static const char *TAG = "TELEMETRY";
+
+#define FRAME_LEN (ROVER_PROTO_HEADER_LEN + ROVER_TELEMETRY_LEN + ROVER_PROTO_CRC_LEN)
+
+_Static_assert(TELEMETRY_BATCH >= 1 && TELEMETRY_BATCH * FRAME_LEN <= 1400, "telemetry batch must fit one unfragmented datagram");
+_Static_assert(ROVER_NUM_MOTORS == L298N_NUM_MOTORS, "wheel count differs from the motor board table");
+
+static const l298n_t *boards;
+
+/* Client addresses packed as ip << 16 | port, 0 for none. The UDP task
+** writes them and the telemetry task reads them, so each must change in
+** one store.
+*/
+static _Atomic uint64_t cmd_client, sub_client;
+static atomic_uint sub_until_ms;
+
+static uint8_t dgram[TELEMETRY_BATCH * FRAME_LEN];
+
+static inline uint16_t sat_u16(uint32_t v) {
+    return v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+}
+
+void telemetry_note_client(uint32_t ip, uint16_t port, bool subscribe) {
+    uint64_t packed = ((uint64_t)ip << 16) | port;
+    if (subscribe) {
+        atomic_store_explicit(&sub_client, packed, memory_order_relaxed);
+        atomic_store_explicit(&sub_until_ms, (uint32_t)(esp_timer_get_time() / 1000) + TELEMETRY_SUB_TIMEOUT_MS, memory_order_relaxed);
+    } else {
+        atomic_store_explicit(&cmd_client, packed, memory_order_relaxed);
+    }
+}
+
+// Where the next datagram goes: a live subscriber first, then the last command sender.
+static uint64_t destination(void) {
+    uint64_t sub = atomic_load_explicit(&sub_client, memory_order_relaxed);
+    uint32_t until = atomic_load_explicit(&sub_until_ms, memory_order_relaxed);
+    if (sub != 0 && (int32_t)((uint32_t)(esp_timer_get_time() / 1000) - until) < 0) {
+        return sub;
+    }
+    return atomic_load_explicit(&cmd_client, memory_order_relaxed);
+}
+
+static void take_sample(uint8_t *p, uint16_t seq) {
+    control_timing_t timing;
+    uint16_t pulse[ROVER_NUM_SERVOS];
+    int16_t target_cps[ROVER_NUM_MOTORS], meas_cps[ROVER_NUM_MOTORS];
+
+    control_take_timing(&timing);
+    pca9685_get_pulses(pulse, ROVER_NUM_SERVOS);
+    speed_get(target_cps, meas_cps);
+
+    put_u32le(p, (uint32_t)esp_timer_get_time());
+    put_u16le(p + 4, seq);
+    put_u16le(p + 6, sat_u16(timing.busy_us_max));
+    put_u16le(p + 8, sat_u16(timing.late_us_max));
+    for (int w = 0; w < ROVER_NUM_MOTORS; w++) {
+        const l298n_t *b = &boards[w / 2];
+        p[10 + w] = (uint8_t)b->shadow_dir[w % 2];
+        put_u16le(p + 28 + 2 * w, (uint16_t)b->shadow_duty[w % 2]);
+        put_u16le(p + 52 + 2 * w, (uint16_t)target_cps[w]);
+        put_u16le(p + 64 + 2 * w, (uint16_t)meas_cps[w]);
+    }
+    for (int i = 0; i < ROVER_NUM_SERVOS; i++) {
+        put_u16le(p + 16 + 2 * i, pulse[i]);
+    }
+    put_u32le(p + 40, stats_get(STATS_RX_PACKETS));
+    put_u32le(p + 44, stats_get(STATS_RX_REJECTED) + stats_get(STATS_SEQ_STALE) + stats_get(STATS_SEQ_DUPLICATE));
+    put_u32le(p + 48, esp_get_free_heap_size());
+}
+
+// esp_timer callback: wake the telemetry task for the next sample.
+static void telemetry_tick(void *arg) {
+    xTaskNotifyGive((TaskHandle_t)arg);
+}
+
+static void telemetry_task(void *arg) {
+    uint8_t sample[ROVER_TELEMETRY_LEN];
+    uint16_t seq = 0;
+    size_t used = 0;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = telemetry_tick,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "telemetry",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_handle_t timer;
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(timer, 1000000 / TELEMETRY_RATE_HZ));
+
+    ESP_LOGI(TAG, "Sampling at %d Hz, %d samples per datagram", TELEMETRY_RATE_HZ, TELEMETRY_BATCH);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        PROFILE_WAKE(PROFILER_LOOP_TELEMETRY, esp_timer_get_time(), 1000000 / TELEMETRY_RATE_HZ);
+
+        take_sample(sample, seq++);
+        used += rover_encode_frame(ROVER_MSG_TELEMETRY, sample, sizeof(sample), dgram + used, sizeof(dgram) - used);
+        if (used < sizeof(dgram)) {
+            continue;
+        }
+
+        // Samples taken while nobody is listening are dropped; seq still advances.
+        uint64_t dest = destination();
+        if (dest != 0) {
+            udp_rx_send(dgram, used, (uint32_t)(dest >> 16), (uint16_t)dest);
+        }
+        used = 0;
+    }// end while
+}
+
+void telemetry_start(const l298n_t *motor_boards) {
+    boards = motor_boards;
+    xTaskCreatePinnedToCore(telemetry_task, "telemetry_task", TELEMETRY_TASK_STACK, NULL, TELEMETRY_TASK_PRIORITY, NULL, TELEMETRY_TASK_CORE);
+}
@@ -0,0 +1,68 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "l298n.h"
+
+/*
+** Binary telemetry stream.
+**
+** A low-priority task samples the rover state TELEMETRY_RATE_HZ times a
+** second and sends TELEMETRY_BATCH samples per datagram, one
+** ROVER_MSG_TELEMETRY frame each, from the command port to:
+**
+**   - the address that last sent ROVER_MSG_TELEMETRY_SUB, for
+**     TELEMETRY_SUB_TIMEOUT_MS after its latest subscribe, otherwise
+**   - the address that last sent an accepted command.
+**
+** Nothing is sent until one of them exists. The datagram is built in a
+** static buffer, so streaming allocates nothing.
+**
+** Sample payload (ROVER_TELEMETRY_LEN bytes, little-endian):
+**
+**   offset  size
+**   0       4     t_us, esp_timer time of the sample (wraps)
+**   4       2     seq, sample counter (wraps); gaps mean lost datagrams
+**   6       2     control loop: longest iteration since the last sample, us
+**   8       2     control loop: worst wake-up lateness since the last sample, us
+**   10      6     u8 motor direction[ROVER_NUM_MOTORS] (motorDirection_t)
+**   16      12    u16 servo pulse[ROVER_NUM_SERVOS], PCA9685 counts of 4096
+**                 per frame, 0xFFFF before the first write
+**   28      12    u16 motor duty[ROVER_NUM_MOTORS], 0..L298N_MAX_DUTY
+**   40      4     rx_packets
+**   44      4     rx dropped (rejected + stale + duplicate)
+**   48      4     free heap, bytes
+**   52      12    i16 wheel speed target[ROVER_NUM_MOTORS], counts/s
+**   64      12    i16 measured wheel speed[ROVER_NUM_MOTORS], counts/s,
+**                 SPEED_UNMEASURED (-32768) for a wheel without encoder
+**
+** The loop timings saturate at 65535. Motor state is the driver's shadow,
+** which in L298N_RAMP_MS mode is the duty the fade is heading for; with
+** SPEED_CONTROL it is the duty the speed loop chose.
+*/
+
+#ifndef TELEMETRY_RATE_HZ
+#define TELEMETRY_RATE_HZ 50
+#endif
+
+#ifndef TELEMETRY_BATCH
+#define TELEMETRY_BATCH 5
+#endif
+
+#ifndef TELEMETRY_SUB_TIMEOUT_MS
+#define TELEMETRY_SUB_TIMEOUT_MS 5000
+#endif
+
+// Shares core 0 with the UDP task, below it so sampling never delays a command.
+#define TELEMETRY_TASK_CORE 0
+#define TELEMETRY_TASK_STACK 3072
+#define TELEMETRY_TASK_PRIORITY 3
+
+// Start streaming from the command port (see udp_rx.h) with motor state from boards.
+void telemetry_start(const l298n_t *boards);
+
+// Record a client address (network byte order as received); subscribe marks a ROVER_MSG_TELEMETRY_SUB.
+void telemetry_note_client(uint32_t ip, uint16_t port, bool subscribe);
+
+#endif
@@ -0,0 +1,325 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "lwip/sockets.h"
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "udp_rx.h"
+#include "protocol.h"
+#include "setpoint.h"
+#include "seqfilter.h"
+#include "telemetry.h"
+#include "recorder.h"
+#include "stats.h"
+#include "trace.h"
+#include "boot.h"
+#include "profiler.h"
+
+static const char *TAG = "UDP";
+
+static udp_rx_mode_t rx_mode;
+static uint16_t rx_port;
+static const l298n_t *boards;
+
+// UDP_RX_SOCKET: the bound socket. UDP_RX_LWIP_RAW: the pcb, only touched in the tcpip thread.
+static int sock = -1;
+static struct udp_pcb *pcb;
+
+// Replies are built here; only the receive path (one task or the tcpip thread) uses it.
+static uint8_t tx_buffer[UDP_RX_TX_BUF_LEN];
+_Static_assert(PROFILER_REPORT_MAX <= UDP_RX_TX_BUF_LEN, "a profiler report does not fit one reply");
+
+// UDP_RX_LWIP_RAW: queries waiting for the query task, which builds its answers in its own buffer.
+typedef struct {
+    rover_cmd_t cmd;
+    uint32_t ip;
+    uint16_t port;
+} query_t;
+
+static QueueHandle_t query_queue;
+static uint8_t query_buffer[UDP_RX_TX_BUF_LEN];
+
+// Answer a ROVER_MSG_LOG_READ: recorder info, then the requested partition bytes.
+static size_t encode_log_read(const rover_cmd_t *cmd, uint8_t *buf, size_t cap) {
+    uint8_t payload[4 + ROVER_LOG_DATA_CHUNK];
+    recorder_info_t info;
+
+    recorder_get_info(&info);
+    const uint32_t fields[] = {info.partition_size, info.head_sector, info.head_seq, info.records, info.dropped, info.flash_errors};
+    for (int i = 0; i < 6; i++) {
+        put_u32le(payload + 4 * i, fields[i]);
+    }
+    size_t used = rover_encode_frame(ROVER_MSG_LOG_INFO, payload, ROVER_LOG_INFO_LEN, buf, cap);
+
+    uint32_t offset = cmd->log_read.offset;
+    uint32_t left = cmd->log_read.len > ROVER_LOG_READ_MAX ? ROVER_LOG_READ_MAX : cmd->log_read.len;
+    while (left > 0 && used > 0) {
+        uint32_t n = left > ROVER_LOG_DATA_CHUNK ? ROVER_LOG_DATA_CHUNK : left;
+        put_u32le(payload, offset);
+        if (recorder_read(offset, payload + 4, n) != ESP_OK) {
+            break;
+        }
+        size_t f = rover_encode_frame(ROVER_MSG_LOG_DATA, payload, 4 + n, buf + used, cap - used);
+        if (f == 0) {
+            break;
+        }
+        used += f;
+        offset += n;
+        left -= n;
+    }
+    return used;
+}
+
+// Answer to a stats, profile or log query into buf; 0 for any other command.
+static size_t encode_query(const rover_cmd_t *cmd, uint8_t *buf, size_t cap) {
+    switch (cmd->type) {
+        case ROVER_MSG_STATS_QUERY: return stats_encode_snapshot(buf, cap);
+        case ROVER_MSG_LOG_READ: return encode_log_read(cmd, buf, cap);
+        case ROVER_MSG_PROF_QUERY: return profiler_encode(buf, cap);
+        default: return 0;
+    }
+}
+
+// Raw mode, tcpip thread only: send buf from the pcb through one freshly allocated pbuf.
+static void raw_send(const void *buf, size_t len, uint32_t ip, uint16_t port) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)len, PBUF_RAM);
+    if (p == NULL) {
+        return;
+    }
+    pbuf_take(p, buf, (u16_t)len);
+    ip_addr_t dst;
+    ip_addr_set_ip4_u32(&dst, ip);
+    udp_sendto(pcb, p, &dst, ntohs(port));
+    pbuf_free(p);
+}
+
+// Send an answer to ip:port from the receive path, whichever mode it runs in.
+static void reply(const uint8_t *buf, size_t len, uint32_t ip, uint16_t port) {
+    if (len == 0) {
+        return;
+    }
+    if (rx_mode == UDP_RX_LWIP_RAW) {
+        raw_send(buf, len, ip, port);
+        return;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = port,
+        .sin_addr.s_addr = ip,
+    };
+    sendto(sock, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+/* Everything that happens to a datagram once it is in memory, for both
+** modes. ip and port are in network byte order, as a socket reports them.
+*/
+static void handle_datagram(const uint8_t *buf, size_t len, uint32_t ip, uint16_t port, int64_t rx_us) {
+    stats_count(STATS_RX_PACKETS, 1);
+
+    rover_cmd_t cmd;
+    rover_proto_err_t err = len > UDP_RX_MAX_LEN ? ROVER_PROTO_ERR_LENGTH : rover_decode(buf, len, &cmd);
+    if (err != ROVER_PROTO_OK) {
+        stats_count(STATS_RX_REJECTED, 1);
+        TRACE(TRACE_EV_REJECT, len, err, 0);
+        return;
+    }
+    TRACE(TRACE_EV_RX, len, cmd.type, 0);
+
+    if (cmd.type == ROVER_MSG_TELEMETRY_SUB) {
+        telemetry_note_client(ip, port, true);
+        return;
+    }
+    if (cmd.type == ROVER_MSG_STATS_QUERY || cmd.type == ROVER_MSG_LOG_READ || cmd.type == ROVER_MSG_PROF_QUERY) {
+        if (rx_mode == UDP_RX_LWIP_RAW) {
+            // Not in the tcpip thread; a full queue drops the query and the client asks again.
+            query_t q = {.cmd = cmd, .ip = ip, .port = port};
+            xQueueSend(query_queue, &q, 0);
+        } else {
+            reply(tx_buffer, encode_query(&cmd, tx_buffer, sizeof(tx_buffer)), ip, port);
+        }
+        return;
+    }
+
+#if RECORDER_ENABLE
+    // Logged before the sequence filter, so a replay reproduces its verdicts too.
+    uint8_t rec[6 + UDP_RX_MAX_LEN];
+    memcpy(rec, &ip, 4);
+    memcpy(rec + 4, &port, 2);
+    memcpy(rec + 6, buf, len);
+    RECORD(REC_CMD, rec, 6 + len);
+#endif
+
+    // Late and repeated commands are dropped here, before they can displace a newer setpoint.
+    seq_verdict_t verdict = seq_filter_check(ip, port, &cmd, rx_us);
+    if (verdict != SEQ_ACCEPT) {
+        TRACE(TRACE_EV_SEQ_DROP, cmd.type, cmd.seq, verdict);
+        return;
+    }
+
+    // Hand the setpoint to the control task; actuation never blocks receiving.
+    setpoint_publish_cmd(&cmd, rx_us, esp_timer_get_time());
+    telemetry_note_client(ip, port, false);
+    if (boot_mark(BOOT_FIRST_CMD)) {
+        boot_report();
+    }
+
+    if (cmd.type == ROVER_MSG_DRIVE && (cmd.drive.flags & ROVER_DRIVE_FLAG_ECHO)) {
+        reply(tx_buffer, rover_encode_drive_echo(&cmd, tx_buffer, sizeof(tx_buffer)), ip, port);
+    }
+}
+
+static void udp_server_task(void *arg) {
+    struct sockaddr_in server_addr, client_addr;
+    uint8_t rx_buffer[UDP_RX_MAX_LEN + 1];  // one spare byte, so an oversized datagram shows
+    socklen_t addr_len = sizeof(client_addr);
+
+    // Create UDP socket
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        vTaskDelete(NULL);
+    }
+
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    server_addr.sin_port = htons(rx_port);
+
+    if (bind(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        ESP_LOGE(TAG, "Socket bind failed: errno %d", errno);
+        close(sock);
+        vTaskDelete(NULL);
+    }
+
+    ESP_LOGI(TAG, "UDP server listening on port %d (socket)", rx_port);
+    boot_mark(BOOT_UDP);
+    telemetry_start(boards);
+
+    while (1) {
+        addr_len = sizeof(client_addr);
+        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0, (struct sockaddr *)&client_addr, &addr_len);
+        if (len > 0) {
+            handle_datagram(rx_buffer, len, client_addr.sin_addr.s_addr, client_addr.sin_port, esp_timer_get_time());
+        }// end if
+    }// end while
+
+    close(sock);
+    vTaskDelete(NULL);
+}
+
+// Raw mode: answers the queries raw_recv() hands over, away from the tcpip thread.
+static void udp_query_task(void *arg) {
+    query_t q;
+    while (1) {
+        xQueueReceive(query_queue, &q, portMAX_DELAY);
+        size_t len = encode_query(&q.cmd, query_buffer, sizeof(query_buffer));
+        if (len > 0) {
+            udp_rx_send(query_buffer, len, q.ip, q.port);
+        }
+    }// end while
+}
+
+/* Raw mode receive callback, in the tcpip thread. A datagram that arrived
+** in one pbuf (any command does) is decoded in place; only a chained one is
+** gathered into a buffer first. The pbuf is ours to free either way.
+*/
+static void raw_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    int64_t rx_us = esp_timer_get_time();
+    uint8_t gathered[UDP_RX_MAX_LEN];
+    const uint8_t *data = p->payload;
+
+    if (!IP_IS_V4(addr)) {
+        pbuf_free(p);
+        return;
+    }
+    if (p->next != NULL && p->tot_len <= sizeof(gathered)) {
+        pbuf_copy_partial(p, gathered, p->tot_len, 0);
+        data = gathered;
+    }
+    handle_datagram(data, p->tot_len, ip4_addr_get_u32(ip_2_ip4(addr)), htons(port), rx_us);
+    pbuf_free(p);
+}
+
+// tcpip_api_call() argument blocks.
+typedef struct {
+    struct tcpip_api_call_data call;
+    uint16_t port;
+} raw_bind_call_t;
+
+typedef struct {
+    struct tcpip_api_call_data call;
+    const void *buf;
+    size_t len;
+    uint32_t ip;
+    uint16_t port;
+} raw_send_call_t;
+
+static err_t raw_bind_fn(struct tcpip_api_call_data *call) {
+    raw_bind_call_t *c = (raw_bind_call_t *)call;
+    pcb = udp_new();
+    if (pcb == NULL) {
+        return ERR_MEM;
+    }
+    err_t err = udp_bind(pcb, IP_ANY_TYPE, c->port);
+    if (err != ERR_OK) {
+        udp_remove(pcb);
+        pcb = NULL;
+        return err;
+    }
+    udp_recv(pcb, raw_recv, NULL);
+    return ERR_OK;
+}
+
+static err_t raw_send_fn(struct tcpip_api_call_data *call) {
+    raw_send_call_t *c = (raw_send_call_t *)call;
+    raw_send(c->buf, c->len, c->ip, c->port);
+    return ERR_OK;
+}
+
+void udp_rx_start(udp_rx_mode_t mode, uint16_t port, const l298n_t *motor_boards) {
+    rx_mode = mode;
+    rx_port = port;
+    boards = motor_boards;
+
+    if (mode == UDP_RX_SOCKET) {
+        xTaskCreatePinnedToCore(udp_server_task, "udp_server_task", UDP_RX_TASK_STACK, NULL, UDP_RX_TASK_PRIORITY, NULL, UDP_RX_TASK_CORE);
+        return;
+    }
+
+    query_queue = xQueueCreate(UDP_RX_QUERY_QUEUE_LEN, sizeof(query_t));
+    xTaskCreatePinnedToCore(udp_query_task, "udp_query_task", UDP_RX_QUERY_TASK_STACK, NULL, UDP_RX_QUERY_TASK_PRIORITY, NULL, UDP_RX_TASK_CORE);
+
+    raw_bind_call_t c = {.port = port};
+    err_t err = tcpip_api_call(raw_bind_fn, &c.call);
+    if (err != ERR_OK) {
+        ESP_LOGE(TAG, "Raw UDP bind failed: err %d", err);
+        return;
+    }
+    ESP_LOGI(TAG, "UDP server listening on port %d (raw lwIP)", port);
+    boot_mark(BOOT_UDP);
+    telemetry_start(boards);
+}
+
+void udp_rx_send(const void *buf, size_t len, uint32_t ip, uint16_t port) {
+    if (rx_mode == UDP_RX_SOCKET) {
+        if (sock < 0) {
+            return;
+        }
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = port,
+            .sin_addr.s_addr = ip,
+        };
+        sendto(sock, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+        return;
+    }
+    if (pcb == NULL) {
+        return;
+    }
+    // Blocks until the tcpip thread has sent it, so buf stays valid throughout.
+    raw_send_call_t c = {.buf = buf, .len = len, .ip = ip, .port = port};
+    tcpip_api_call(raw_send_fn, &c.call);
+}
@@ -0,0 +1,56 @@
+#ifndef UDP_RX_H
+#define UDP_RX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "l298n.h"
+
+/*
+** Command receive path.
+**
+** UDP_RX_SOCKET: a task on core 0 blocks in recvfrom() on a BSD socket.
+** lwIP queues each datagram to the socket's mailbox in the tcpip thread,
+** the receive task wakes up and copies it into its own buffer.
+**
+** UDP_RX_LWIP_RAW: a raw lwIP UDP pcb. The receive callback runs in the
+** tcpip thread and decodes the frame straight out of the pbuf payload,
+** publishes the setpoint and frees the pbuf, so there is no copy and no
+** second task to wake. Nothing slow may run there, since it holds up all of
+** lwIP: stats, profile and log queries (a log read is a flash read) are
+** queued to a query task that answers them through tcpip_api_call(), like
+** telemetry does from its own task. Only the drive echo, a copy of the
+** command, is sent straight from the callback.
+**
+** Both modes hand every datagram to the same handler, so decoding, the
+** sequence filter, the recorder and the statistics behave identically.
+** UDP_RX_RAW selects the mode app_main() starts.
+*/
+
+#ifndef UDP_RX_RAW
+#define UDP_RX_RAW 0
+#endif
+
+#define UDP_RX_MAX_LEN 128          // longer datagrams are rejected
+#define UDP_RX_TX_BUF_LEN 1024      // largest reply (a full LOG_READ answer)
+
+#define UDP_RX_TASK_CORE 0
+#define UDP_RX_TASK_STACK 4096
+#define UDP_RX_TASK_PRIORITY 5
+
+// Raw mode query task; queries beyond a full queue are dropped and the client asks again.
+#define UDP_RX_QUERY_QUEUE_LEN 4
+#define UDP_RX_QUERY_TASK_STACK 4096
+#define UDP_RX_QUERY_TASK_PRIORITY 3
+
+typedef enum {
+    UDP_RX_SOCKET = 0,
+    UDP_RX_LWIP_RAW,
+} udp_rx_mode_t;
+
+// Receive commands on port and start telemetry on it, with motor state from motor_boards.
+void udp_rx_start(udp_rx_mode_t mode, uint16_t port, const l298n_t *motor_boards);
+
+// Send a datagram from the command port to ip:port (network byte order). Not from the receive path itself.
+void udp_rx_send(const void *buf, size_t len, uint32_t ip, uint16_t port);
+
+#endif